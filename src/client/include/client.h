@@ -232,6 +232,7 @@ typedef struct {
 //
 extern cvar_t cl_name;
 extern cvar_t cl_color;
+extern cvar_t cl_rate;
 
 extern cvar_t cl_upspeed;
 extern cvar_t cl_forwardspeed;
@@ -318,6 +319,17 @@ void CL_SendMove(usercmd_t* cmd);
 void CL_ParseTEnt(void);
 void CL_UpdateTEnts(void);
 
+//
+// cl_pred
+//
+extern cvar_t cl_predict;
+
+void CL_InitPredict(void);
+void CL_PredictClear(void);
+void CL_PredictRecordMove(usercmd_t* cmd, qboolean jump);
+void CL_PredictSampleRTT(void);
+void CL_PredictMove(void);
+
 void CL_ClearState(void);
 
 
@@ -115,6 +115,7 @@ i32 CL_GetMessage(void) {
         }
 
         // get the next message
+        NET_ReclaimMessage();
         fread(&net_message.cursize, 4, 1, cls.demofile);
         VectorCopy(cl.mviewangles[0], cl.mviewangles[1]);
         for (i = 0; i < 3; i++) {
@@ -123,8 +124,8 @@ i32 CL_GetMessage(void) {
         }
 
         net_message.cursize = LittleLong(net_message.cursize);
-        if (net_message.cursize > MAX_MSGLEN)
-            Sys_Error("Demo message > MAX_MSGLEN");
+        if (net_message.cursize > net_message.maxsize)
+            Sys_Error("Demo message > NET_MAXMESSAGE");
         r = fread(net_message.data, net_message.cursize, 1, cls.demofile);
         if (r != 1) {
             CL_StopPlayback();
@@ -423,6 +423,7 @@ void CL_SendMove(usercmd_t* cmd) {
     in_jump.state &= ~2;
 
     MSG_WriteByte(&buf, bits);
+    CL_PredictRecordMove(cmd, (bits & 2) != 0);
 
     MSG_WriteByte(&buf, in_impulse);
     in_impulse = 0;
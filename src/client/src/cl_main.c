@@ -39,6 +39,7 @@
 // these two are not intended to be set directly
 cvar_t cl_name = {"_cl_name", "player", true};
 cvar_t cl_color = {"_cl_color", "0", true};
+cvar_t cl_rate = {"_cl_rate", "0", true};
 
 cvar_t cl_shownet = {"cl_shownet", "0"}; // can be 0, 1, or 2
 cvar_t cl_nolerp = {"cl_nolerp", "0"};
@@ -90,6 +91,7 @@ void CL_ClearState(void) {
     Q_memset(cl_lightstyle, 0, sizeof(cl_lightstyle));
     Q_memset(cl_temp_entities, 0, sizeof(cl_temp_entities));
     Q_memset(cl_beams, 0, sizeof(cl_beams));
+    CL_PredictClear();
 
     //
     // allocate the efrags and chain together into a free list
@@ -198,6 +200,11 @@ void CL_SignonReply(void) {
                             va("color %i %i\n", ((i32) cl_color.value) >> 4,
                                ((i32) cl_color.value) & 15));
 
+            if (cl_rate.value > 0) {
+                MSG_WriteByte(&cls.message, clc_stringcmd);
+                MSG_WriteString(&cls.message, va("rate %i\n", (i32) cl_rate.value));
+            }
+
             MSG_WriteByte(&cls.message, clc_stringcmd);
             sprintf(str, "spawn %s", cls.spawnparms);
             MSG_WriteString(&cls.message, str);
@@ -585,6 +592,7 @@ i32 CL_ReadFromServer(void) {
         Con_Printf("\n");
 
     CL_RelinkEntities();
+    CL_PredictMove();
     CL_UpdateTEnts();
 
     //
@@ -621,6 +629,7 @@ void CL_SendCmd(void) {
     }
 
     // send the reliable message
+    CL_PredictSampleRTT();
     if (!cls.message.cursize)
         return; // no message at all
 
@@ -645,12 +654,14 @@ void CL_Init(void) {
 
     CL_InitInput();
     CL_InitTEnts();
+    CL_InitPredict();
 
     //
     // register our commands
     //
     Cvar_RegisterVariable(&cl_name);
     Cvar_RegisterVariable(&cl_color);
+    Cvar_RegisterVariable(&cl_rate);
     Cvar_RegisterVariable(&cl_upspeed);
     Cvar_RegisterVariable(&cl_forwardspeed);
     Cvar_RegisterVariable(&cl_backspeed);
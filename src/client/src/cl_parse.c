@@ -25,12 +25,14 @@
 #include "cmd.h"
 #include "console.h"
 #include "host.h"
+#include "jobs.h"
 #include "model.h"
 #include "sbar.h"
 #include "screen.h"
 #include "server.h"
 #include "sys.h"
 #include "sound.h"
+#include <SDL_timer.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -159,7 +161,7 @@ void CL_KeepaliveMessage(void) {
     static float lastmsg;
     i32 ret;
     sizebuf_t old;
-    byte olddata[8192];
+    static byte olddata[NET_MAXMESSAGE];
 
     if (sv.active)
         return; // no need if server is local
@@ -204,6 +206,33 @@ void CL_KeepaliveMessage(void) {
     SZ_Clear(&cls.message);
 }
 
+/*
+==================
+CL_WaitForPrecache
+
+Keeps the window and the connection alive while the job threads finish
+decoding the precached models and sounds
+==================
+*/
+static void CL_WaitForPrecache(jobgroup_t* jobs) {
+    double lastdraw = 0;
+    double time;
+
+    while (!Jobs_IsDone(jobs)) {
+        if (!Jobs_RunOne())
+            SDL_Delay(1);
+        Sys_SendKeyEvents();
+        CL_KeepaliveMessage();
+
+        time = Sys_FloatTime();
+        if (time - lastdraw > 0.05) {
+            lastdraw = time;
+            SCR_DrawLoadingProgress(SDL_AtomicGet(&jobs->finished),
+                                    SDL_AtomicGet(&jobs->submitted));
+        }
+    }
+}
+
 /*
 ==================
 CL_ParseServerInfo
@@ -215,6 +244,7 @@ void CL_ParseServerInfo(void) {
     i32 nummodels, numsounds;
     char model_precache[MAX_MODELS][MAX_QPATH];
     char sound_precache[MAX_SOUNDS][MAX_QPATH];
+    static jobgroup_t precache_jobs;
 
     Con_DPrintf("Serverinfo packet received.\n");
     //
@@ -287,20 +317,27 @@ void CL_ParseServerInfo(void) {
     // now we try to load everything else until a cache allocation fails
     //
 
+    Jobs_Wait(&precache_jobs); // in case an earlier load was aborted
+    Jobs_ClearGroup(&precache_jobs);
+    Mod_BeginPrecaching(&precache_jobs);
     for (i = 1; i < nummodels; i++) {
         cl.model_precache[i] = Mod_ForName(model_precache[i], false);
         if (cl.model_precache[i] == NULL) {
             Con_Printf("Model %s not found\n", model_precache[i]);
+            Mod_EndPrecaching(); // don't leave the group to the next load
             return;
         }
         CL_KeepaliveMessage();
     }
 
-    S_BeginPrecaching();
+    S_BeginPrecaching(&precache_jobs);
     for (i = 1; i < numsounds; i++) {
         cl.sound_precache[i] = S_PrecacheSound(sound_precache[i]);
         CL_KeepaliveMessage();
     }
+
+    CL_WaitForPrecache(&precache_jobs);
+    Mod_EndPrecaching();
     S_EndPrecaching();
 
 
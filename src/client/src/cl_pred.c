@@ -0,0 +1,527 @@
+/*
+ * Copyright (C) 1996-1997 Id Software, Inc.
+ * Copyright (C) Henrique Barateli, <henriquejb194@gmail.com>, et al.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+// cl_pred.c -- client side movement prediction
+
+
+#include "client.h"
+#include "cmd.h"
+#include "console.h"
+#include "host.h"
+#include "model.h"
+#include "server.h"
+#include "world.h"
+#include <math.h>
+#include <string.h>
+
+
+/*
+
+The server only moves the player when a move reaches it, so without
+prediction every input shows up a full round trip late.
+
+With cl_predict the client keeps the moves it sent. Each frame it takes
+the last player state the server sent and replays on top of it the moves
+the server could not have seen yet, running the server's own movement
+math against the world hull. A new server state replaces the base, so
+whatever the prediction got wrong is dropped there.
+
+A move counts as seen if it was sent a round trip before the update that
+carried the state arrived. The round trip is measured on the reliable
+channel, so a reliable nop goes out each second while predicting.
+
+Other entities are not clipped against. Doors, lifts and other players
+are left to the corrections.
+
+*/
+
+// 128 moves at 72 fps, a little under two seconds.
+#define PRED_MOVES 128
+#define PRED_STEP  (1.0 / 72.0)
+
+#define STEPSIZE        18
+#define MAX_CLIP_PLANES 5
+
+typedef struct {
+    double time; // realtime the move was sent
+    usercmd_t cmd;
+    vec3_t viewangles;
+    qboolean jump;
+} predmove_t;
+
+typedef struct {
+    vec3_t origin;
+    vec3_t velocity;
+    vec3_t angles; // the roll is worked out from last frame's
+    qboolean onground;
+    qboolean jumpreleased;
+} predstate_t;
+
+extern cvar_t sv_friction;
+extern cvar_t sv_edgefriction;
+extern cvar_t sv_maxspeed;
+extern cvar_t sv_gravity;
+extern cvar_t sv_nostep;
+extern cvar_t cl_rollspeed;
+extern cvar_t cl_rollangle;
+
+cvar_t cl_predict = {"cl_predict", "0", true};
+
+static predmove_t predmoves[PRED_MOVES];
+static i32 numpredmoves; // total recorded, index is % PRED_MOVES
+static double pred_basemtime; // cl.mtime[0] of the state replayed on
+static double pred_basetime;  // realtime that state arrived
+static double pred_lastnop;
+
+// Statistic Counters
+static i32 pred_frames = 0;
+static i32 pred_updates = 0;
+static i32 pred_moves = 0;
+static double pred_replaytime = 0;
+
+
+/*
+===============================================================================
+
+MOVEMENT
+
+===============================================================================
+*/
+
+static trace_t CL_PredictTrace(i32 hullnum, vec3_t start, vec3_t end) {
+    hull_t* hull = &cl.worldmodel->hulls[hullnum];
+    trace_t trace;
+
+    Q_memset(&trace, 0, sizeof(trace));
+    trace.fraction = 1;
+    trace.allsolid = true;
+    VectorCopy(end, trace.endpos);
+    SV_RecursiveHullCheck(hull, hull->firstclipnode, 0, 1, start, end, &trace);
+    return trace;
+}
+
+static void CL_PredictPush(predstate_t* ps, vec3_t push) {
+    vec3_t end;
+
+    VectorAdd(ps->origin, push, end);
+    const trace_t trace = CL_PredictTrace(1, ps->origin, end);
+    VectorCopy(trace.endpos, ps->origin);
+}
+
+/*
+============
+CL_PredictFlyMove
+
+SV_FlyMove against the world only.
+============
+*/
+static i32 CL_PredictFlyMove(predstate_t* ps, double time) {
+    vec3_t planes[MAX_CLIP_PLANES];
+    vec3_t primal_velocity, original_velocity, new_velocity;
+    vec3_t end, dir;
+    i32 numplanes = 0;
+    i32 blocked = 0;
+    double time_left = time;
+    i32 i, j;
+
+    VectorCopy(ps->velocity, original_velocity);
+    VectorCopy(ps->velocity, primal_velocity);
+
+    for (i32 bumpcount = 0; bumpcount < 4; bumpcount++) {
+        if (!ps->velocity[0] && !ps->velocity[1] && !ps->velocity[2])
+            break;
+
+        for (i = 0; i < 3; i++)
+            end[i] = ps->origin[i] + time_left * ps->velocity[i];
+
+        trace_t trace = CL_PredictTrace(1, ps->origin, end);
+
+        if (trace.allsolid) {
+            VectorCopy(vec3_origin, ps->velocity);
+            return 3;
+        }
+        if (trace.fraction > 0) {
+            VectorCopy(trace.endpos, ps->origin);
+            VectorCopy(ps->velocity, original_velocity);
+            numplanes = 0;
+        }
+        if (trace.fraction == 1)
+            break;
+
+        if (trace.plane.normal[2] > 0.7) {
+            blocked |= 1;
+            ps->onground = true;
+        }
+        if (!trace.plane.normal[2])
+            blocked |= 2;
+
+        time_left -= time_left * trace.fraction;
+
+        if (numplanes >= MAX_CLIP_PLANES) {
+            VectorCopy(vec3_origin, ps->velocity);
+            return 3;
+        }
+        VectorCopy(trace.plane.normal, planes[numplanes]);
+        numplanes++;
+
+        for (i = 0; i < numplanes; i++) {
+            ClipVelocity(original_velocity, planes[i], new_velocity, 1);
+            for (j = 0; j < numplanes; j++)
+                if (j != i && DotProduct(new_velocity, planes[j]) < 0)
+                    break;
+            if (j == numplanes)
+                break;
+        }
+
+        if (i != numplanes) {
+            VectorCopy(new_velocity, ps->velocity);
+        } else {
+            if (numplanes != 2) {
+                VectorCopy(vec3_origin, ps->velocity);
+                return 7;
+            }
+            CrossProduct(planes[0], planes[1], dir);
+            VectorScale(dir, DotProduct(dir, ps->velocity), ps->velocity);
+        }
+
+        if (DotProduct(ps->velocity, primal_velocity) <= 0) {
+            VectorCopy(vec3_origin, ps->velocity);
+            return blocked;
+        }
+    }
+    return blocked;
+}
+
+/*
+============
+CL_PredictWalkMove
+
+SV_WalkMove against the world only.
+============
+*/
+static void CL_PredictWalkMove(predstate_t* ps, double frametime) {
+    vec3_t oldorg, oldvel, nosteporg, nostepvel;
+    vec3_t upmove = {0, 0, STEPSIZE};
+    vec3_t downmove = {0, 0, 0};
+
+    const qboolean oldonground = ps->onground;
+    ps->onground = false;
+
+    VectorCopy(ps->origin, oldorg);
+    VectorCopy(ps->velocity, oldvel);
+
+    if (!(CL_PredictFlyMove(ps, frametime) & 2))
+        return; // move didn't block on a step
+    if (!oldonground || sv_nostep.value)
+        return; // don't stair up while jumping
+
+    VectorCopy(ps->origin, nosteporg);
+    VectorCopy(ps->velocity, nostepvel);
+
+    // try moving up and forward to go up a step
+    VectorCopy(oldorg, ps->origin);
+    CL_PredictPush(ps, upmove);
+
+    ps->velocity[0] = oldvel[0];
+    ps->velocity[1] = oldvel[1];
+    ps->velocity[2] = 0;
+    CL_PredictFlyMove(ps, frametime);
+
+    // move down
+    downmove[2] = -STEPSIZE + oldvel[2] * frametime;
+    vec3_t end;
+    VectorAdd(ps->origin, downmove, end);
+    const trace_t downtrace = CL_PredictTrace(1, ps->origin, end);
+    VectorCopy(downtrace.endpos, ps->origin);
+
+    if (downtrace.plane.normal[2] > 0.7) {
+        ps->onground = true;
+    } else {
+        VectorCopy(nosteporg, ps->origin);
+        VectorCopy(nostepvel, ps->velocity);
+    }
+}
+
+/*
+============
+CL_PredictFriction
+
+SV_UserFriction, with the dropoff check against the world.
+============
+*/
+static void CL_PredictFriction(predstate_t* ps, double frametime) {
+    const float* vel = ps->velocity;
+    const float speed = sqrt(vel[0] * vel[0] + vel[1] * vel[1]);
+    vec3_t start, stop;
+
+    if (!speed)
+        return;
+
+    // if the leading edge is over a dropoff, increase friction
+    start[0] = stop[0] = ps->origin[0] + vel[0] / speed * 16;
+    start[1] = stop[1] = ps->origin[1] + vel[1] / speed * 16;
+    start[2] = ps->origin[2] - 24; // player mins
+    stop[2] = start[2] - 34;
+
+    const trace_t trace = CL_PredictTrace(0, start, stop);
+    float friction = sv_friction.value;
+    if (trace.fraction == 1.0)
+        friction *= sv_edgefriction.value;
+
+    SV_FrictionVelocity(ps->velocity, friction, frametime);
+}
+
+/*
+============
+CL_PredictRoll
+
+V_CalcRoll without its side effect on the view's forward, right and up.
+============
+*/
+static float CL_PredictRoll(vec3_t angles, vec3_t velocity) {
+    vec3_t forward, right, up;
+
+    AngleVectors(angles, forward, right, up);
+    float side = DotProduct(velocity, right);
+    const float sign = side < 0 ? -1 : 1;
+    side = fabs(side);
+
+    if (side < cl_rollspeed.value)
+        side = side * cl_rollangle.value / cl_rollspeed.value;
+    else
+        side = cl_rollangle.value;
+
+    return side * sign;
+}
+
+/*
+============
+CL_PredictFrame
+
+One server frame for the player: SV_ClientThink, the jump from
+PlayerPreThink, gravity and SV_WalkMove.
+============
+*/
+static void CL_PredictFrame(predstate_t* ps, const predmove_t* move,
+                            double frametime) {
+    vec3_t angles, forward, right, up;
+    vec3_t wishvel, wishdir;
+
+    // like SV_ClientThink, the roll comes from the angles the player
+    // had before this move
+    angles[ROLL] = CL_PredictRoll(ps->angles, ps->velocity) * 4;
+    angles[PITCH] = -move->viewangles[PITCH] / 3;
+    angles[YAW] = move->viewangles[YAW];
+    VectorCopy(angles, ps->angles);
+    AngleVectors(angles, forward, right, up);
+
+    for (i32 i = 0; i < 3; i++)
+        wishvel[i] = forward[i] * move->cmd.forwardmove +
+                     right[i] * move->cmd.sidemove;
+    wishvel[2] = 0;
+
+    VectorCopy(wishvel, wishdir);
+    float wishspeed = VectorNormalize(wishdir);
+    if (wishspeed > sv_maxspeed.value) {
+        VectorScale(wishvel, sv_maxspeed.value / wishspeed, wishvel);
+        wishspeed = sv_maxspeed.value;
+    }
+
+    if (ps->onground) {
+        CL_PredictFriction(ps, frametime);
+        SV_AccelerateVelocity(ps->velocity, wishdir, wishspeed, frametime);
+    } else {
+        SV_AirAccelerateVelocity(ps->velocity, wishvel, wishspeed, frametime);
+    }
+
+    if (!move->jump) {
+        ps->jumpreleased = true;
+    } else if (ps->onground && ps->jumpreleased) {
+        ps->jumpreleased = false;
+        ps->onground = false;
+        ps->velocity[2] += 270;
+    }
+
+    ps->velocity[2] -= sv_gravity.value * frametime;
+    CL_PredictWalkMove(ps, frametime);
+}
+
+static void CL_PredictRun(predstate_t* ps, const predmove_t* move,
+                          double duration) {
+    if (duration <= 0)
+        return;
+    const i32 steps = (i32) ceil(duration / PRED_STEP);
+    for (i32 i = 0; i < steps; i++) {
+        CL_PredictFrame(ps, move, duration / steps);
+    }
+}
+
+
+/*
+===============================================================================
+
+PREDICTION
+
+===============================================================================
+*/
+
+static qboolean CL_PredictActive(void) {
+    return cl_predict.value && !sv.active && !cls.demoplayback &&
+           cls.state == ca_connected && cls.signon == SIGNONS;
+}
+
+/*
+============
+CL_PredictClear
+
+Forgets the sent moves, on a new level.
+============
+*/
+void CL_PredictClear(void) {
+    numpredmoves = 0;
+    pred_basemtime = 0;
+    pred_basetime = 0;
+}
+
+/*
+============
+CL_PredictRecordMove
+
+Called for every move sent to the server.
+============
+*/
+void CL_PredictRecordMove(usercmd_t* cmd, qboolean jump) {
+    if (!CL_PredictActive()) {
+        return;
+    }
+    predmove_t* move = &predmoves[numpredmoves % PRED_MOVES];
+    move->time = realtime;
+    move->cmd = *cmd;
+    VectorCopy(cl.viewangles, move->viewangles);
+    move->jump = jump;
+    numpredmoves++;
+}
+
+/*
+============
+CL_PredictSampleRTT
+
+Keeps a reliable message going out now and then, so the round trip
+estimate stays current.
+============
+*/
+void CL_PredictSampleRTT(void) {
+    if (!CL_PredictActive() || cls.message.cursize ||
+        realtime - pred_lastnop < 1.0) {
+        return;
+    }
+    pred_lastnop = realtime;
+    MSG_WriteByte(&cls.message, clc_nop);
+}
+
+/*
+============
+CL_PredictMove
+
+Moves the view entity to where the moves still in flight will take it.
+Called after the entities are relinked for the frame.
+============
+*/
+void CL_PredictMove(void) {
+    if (!CL_PredictActive() || !cl.worldmodel || cl.intermission ||
+        cl.stats[STAT_HEALTH] <= 0 || cl.inwater || !numpredmoves) {
+        return;
+    }
+    const double rtt = NET_GetRTT(cls.netcon);
+    if (rtt <= 0) {
+        return;
+    }
+    entity_t* ent = &cl_entities[cl.viewentity];
+
+    if (cl.mtime[0] != pred_basemtime) {
+        pred_basemtime = cl.mtime[0];
+        pred_basetime = realtime;
+        pred_updates++;
+    }
+
+    predstate_t ps;
+    VectorCopy(ent->msg_origins[0], ps.origin);
+    VectorCopy(cl.mvelocity[0], ps.velocity);
+    VectorCopy(ent->msg_angles[0], ps.angles);
+    ps.onground = cl.onground;
+
+    // Find the move the server was running when it sent the state.
+    const double cutoff = pred_basetime - rtt;
+    const i32 oldest = numpredmoves > PRED_MOVES ? numpredmoves - PRED_MOVES : 0;
+    i32 first = numpredmoves - 1;
+    while (first > oldest && predmoves[first % PRED_MOVES].time > cutoff) {
+        first--;
+    }
+    const predmove_t* firstmove = &predmoves[first % PRED_MOVES];
+    double time = firstmove->time > cutoff ? firstmove->time : cutoff;
+    ps.jumpreleased = !(firstmove->jump && firstmove->time <= cutoff);
+
+    for (i32 i = first; i < numpredmoves; i++) {
+        const double end = i + 1 < numpredmoves
+                               ? predmoves[(i + 1) % PRED_MOVES].time
+                               : realtime;
+        CL_PredictRun(&ps, &predmoves[i % PRED_MOVES], end - time);
+        time = end;
+    }
+
+    pred_frames++;
+    pred_moves += numpredmoves - first;
+    pred_replaytime += realtime - cutoff;
+
+    VectorCopy(ps.origin, ent->origin);
+    VectorCopy(ps.velocity, cl.velocity);
+}
+
+/*
+============
+CL_PredictStats_f
+============
+*/
+static void CL_PredictStats_f(void) {
+    Con_Printf("prediction %s", CL_PredictActive() ? "active" : "inactive");
+    if (cls.state == ca_connected && !sv.active && !cls.demoplayback) {
+        Con_Printf(", rtt %.0f ms", NET_GetRTT(cls.netcon) * 1000);
+    }
+    Con_Printf("\n");
+    if (pred_frames) {
+        Con_Printf("%i frames, %i server updates\n", pred_frames, pred_updates);
+        Con_Printf("%.1f moves and %.0f ms replayed per frame\n",
+                   (double) pred_moves / pred_frames,
+                   pred_replaytime * 1000 / pred_frames);
+    }
+    pred_frames = 0;
+    pred_updates = 0;
+    pred_moves = 0;
+    pred_replaytime = 0;
+}
+
+/*
+============
+CL_InitPredict
+============
+*/
+void CL_InitPredict(void) {
+    Cvar_RegisterVariable(&cl_predict);
+    Cmd_AddCommand("cl_predstats", CL_PredictStats_f);
+}
@@ -141,6 +141,7 @@ extern qboolean hipnotic;
 
 void COM_Path_f(void);
 void COM_WriteFile(char* filename, void* data, i32 len);
+void COM_CreatePath(char* path);
 
 i32 COM_OpenFile(char* filename, i32* hndl);
 i32 COM_FOpenFile(char* filename, FILE** file);
@@ -152,6 +153,7 @@ qboolean COM_MusicTrackExists(const char* track_file);
 byte* COM_LoadStackFile(char* path, void* buffer, i32 bufsize);
 byte* COM_LoadTempFile(char* path);
 byte* COM_LoadHunkFile(char* path);
+byte* COM_LoadMallocFile(char* path);
 void COM_LoadCacheFile(char* path, struct cache_user_s* cu);
 
 void COM_InitFilesystem(void);
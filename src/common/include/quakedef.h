@@ -59,6 +59,10 @@
 #define MAX_MSGLEN   8000 // max length of a reliable message
 #define MAX_DATAGRAM 1024 // max length of unreliable message
 
+// limits for connections that negotiated NET_EXT_BIGMESSAGES
+#define MAX_MSGLEN_EXT   64000
+#define MAX_DATAGRAM_EXT 8192
+
 //
 // per-level limits
 //
@@ -179,10 +179,10 @@ FILE OPENING/CLOSING
 ============
 COM_CreatePath
 
-Only used for CopyFile
+Creates any directories needed for path
 ============
 */
-static void COM_CreatePath(char* path) {
+void COM_CreatePath(char* path) {
     for (char* ofs = path + 1; *ofs; ofs++) {
         if (*ofs == '/') {
             // Create the directory.
@@ -499,6 +499,9 @@ static byte* COM_LoadFile(char* path, i32 usehunk) {
                 buf = loadbuf;
             }
             break;
+        case 5:
+            buf = Q_malloc(len + 1);
+            break;
         default:
             Sys_Error("COM_LoadFile: bad usehunk");
             break;
@@ -537,6 +540,12 @@ byte* COM_LoadStackFile(char* path, void* buffer, i32 bufsize) {
     return buf;
 }
 
+// caller must Q_free the buffer; used for files that are
+// handed off to worker threads
+byte* COM_LoadMallocFile(char* path) {
+    return COM_LoadFile(path, 5);
+}
+
 /*
 =================
 COM_LoadPackFile
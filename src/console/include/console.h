@@ -43,6 +43,7 @@ void Con_Print(char* txt);
 void Con_Printf(char* fmt, ...);
 void Con_DPrintf(char* fmt, ...);
 void Con_SafePrintf(char* fmt, ...);
+void Con_PrintPending(void); // prints what other threads queued
 void Con_Clear_f(void);
 void Con_DrawNotify(void);
 void Con_ClearNotify(void);
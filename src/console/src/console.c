@@ -29,6 +29,8 @@
 #include "screen.h"
 #include "sound.h"
 #include "sys.h"
+#include <SDL_atomic.h>
+#include <SDL_thread.h>
 #include <fcntl.h>
 #include <stdarg.h>
 #include <string.h>
@@ -57,6 +59,15 @@ i32 con_current;    // where next message will be printed
 i32 con_x;          // offset in current line for next print
 char* con_text = 0;
 
+#define MAXPRINTMSG 4096
+
+// Prints from other threads wait here for the main thread, as printing
+// may update the screen.
+static SDL_threadID con_mainthread;
+static SDL_SpinLock con_pendinglock;
+static char con_pending[MAXPRINTMSG];
+static i32 con_pendinglen;
+
 cvar_t con_notifytime = {"con_notifytime", "3"}; //seconds
 
 #define NUM_CON_TIMES 4
@@ -216,6 +227,7 @@ void Con_Init(void) {
     char temp[MAXGAMEDIRLEN + 1];
     char* t2 = "/qconsole.log";
 
+    con_mainthread = SDL_ThreadID();
     con_debuglog = COM_CheckParm("-condebug");
 
     if (con_debuglog) {
@@ -352,6 +364,39 @@ void Con_DebugLog(char* file, char* fmt, ...) {
 }
 
 
+static void Con_QueuePrint(const char* msg) {
+    SDL_AtomicLock(&con_pendinglock);
+    i32 len = Q_strlen(msg);
+    if (len > MAXPRINTMSG - 1 - con_pendinglen) {
+        len = MAXPRINTMSG - 1 - con_pendinglen; // drop what doesn't fit
+    }
+    Q_memcpy(con_pending + con_pendinglen, msg, len);
+    con_pendinglen += len;
+    con_pending[con_pendinglen] = 0;
+    SDL_AtomicUnlock(&con_pendinglock);
+}
+
+/*
+================
+Con_PrintPending
+
+Prints what other threads had to say, from the main thread.
+================
+*/
+void Con_PrintPending(void) {
+    char msg[MAXPRINTMSG];
+
+    SDL_AtomicLock(&con_pendinglock);
+    Q_memcpy(msg, con_pending, con_pendinglen + 1);
+    con_pendinglen = 0;
+    con_pending[0] = 0;
+    SDL_AtomicUnlock(&con_pendinglock);
+
+    if (msg[0]) {
+        Con_Printf("%s", msg);
+    }
+}
+
 /*
 ================
 Con_Printf
@@ -359,7 +404,6 @@ Con_Printf
 Handles cursor positioning, line wrapping, etc
 ================
 */
-#define MAXPRINTMSG 4096
 // FIXME: make a buffer size safe vsprintf?
 void Con_Printf(char* fmt, ...) {
     va_list argptr;
@@ -370,6 +414,14 @@ void Con_Printf(char* fmt, ...) {
     vsprintf(msg, fmt, argptr);
     va_end(argptr);
 
+    if (con_mainthread && SDL_ThreadID() != con_mainthread) {
+        Con_QueuePrint(msg);
+        return;
+    }
+    if (con_pendinglen) {
+        Con_PrintPending(); // keep the order they came in
+    }
+
     // also echo to debugging console
     Sys_Printf("%s", msg); // also echo to debugging console
 
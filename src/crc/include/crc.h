@@ -28,5 +28,6 @@
 void CRC_Init(u16* crcvalue);
 void CRC_ProcessByte(u16* crcvalue, byte data);
 u16 CRC_Value(u16 crcvalue);
+u16 CRC_Block(byte* start, i32 count);
 
 #endif
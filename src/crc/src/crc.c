@@ -74,3 +74,12 @@ void CRC_ProcessByte(u16* crcvalue, byte data) {
 u16 CRC_Value(u16 crcvalue) {
     return crcvalue ^ CRC_XOR_VALUE;
 }
+
+u16 CRC_Block(byte* start, i32 count) {
+    u16 crc = CRC_INIT_VALUE;
+
+    while (count--)
+        crc = (crc << 8) ^ crctable[(crc >> 8) ^ *start++];
+
+    return crc ^ CRC_XOR_VALUE;
+}
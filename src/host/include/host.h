@@ -80,6 +80,7 @@ void Host_Shutdown(void);
 void Host_Error(char* error, ...);
 void Host_EndGame(char* message, ...);
 void Host_Frame(float time);
+void Host_Sleep(double elapsed);
 void Host_Quit_f(void);
 void Host_ClientCommands(char* fmt, ...);
 void Host_ShutdownServer(qboolean crash);
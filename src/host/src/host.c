@@ -27,9 +27,11 @@
 #include "console.h"
 #include "draw.h"
 #include "input.h"
+#include "jobs.h"
 #include "keys.h"
 #include "menu.h"
 #include "model.h"
+#include "net.h"
 #include "progs.h"
 #include "sbar.h"
 #include "screen.h"
@@ -41,6 +43,7 @@
 #include <SDL.h>
 #include <stdarg.h>
 #include <string.h>
+#include <time.h>
 
 
 /*
@@ -77,6 +80,7 @@ byte* host_colormap;
 
 cvar_t host_framerate = {"host_framerate", "0"}; // set for slow motion
 cvar_t host_speeds = {"host_speeds", "0"};       // set for running times
+cvar_t host_sleep = {"host_sleep", "1"}; // dedicated servers block on sockets
 
 cvar_t sys_ticrate = {"sys_ticrate", "0.05"};
 cvar_t serverprofile = {"serverprofile", "0"};
@@ -98,6 +102,14 @@ cvar_t pausable = {"pausable", "1"};
 
 cvar_t temp1 = {"temp1", "0"};
 
+// Leave this much of the wait to Host_FilterTime, sleeps overshoot.
+#define HOST_SLEEPSLACK 0.001
+
+// CPU usage sample taken by the last cpustats.
+static clock_t cpustats_clock;
+static double cpustats_time;
+static i32 cpustats_frames;
+
 
 /*
 ================
@@ -220,6 +232,33 @@ void Host_FindMaxClients() {
 }
 
 
+/*
+=======================
+Host_CPUStats_f
+
+Reports the process CPU time used since the previous call, to compare
+an idle dedicated server with and without host_sleep.
+=======================
+*/
+static void Host_CPUStats_f(void) {
+    const clock_t clock_now = clock();
+    const double time_now = Sys_FloatTime();
+    const double wall = time_now - cpustats_time;
+    const double cpu = (double) (clock_now - cpustats_clock) / CLOCKS_PER_SEC;
+    const i32 frames = host_framecount - cpustats_frames;
+
+    if (wall > 0) {
+        Con_Printf("%.1f seconds, %.1f%% cpu, %i frames (%.1f fps), "
+                   "host_sleep %s\n",
+                   wall, cpu * 100.0 / wall, frames, frames / wall,
+                   host_sleep.value ? "on" : "off");
+    }
+    cpustats_clock = clock_now;
+    cpustats_time = time_now;
+    cpustats_frames = host_framecount;
+}
+
+
 /*
 =======================
 Host_InitLocal
@@ -230,6 +269,7 @@ void Host_InitLocal() {
 
     Cvar_RegisterVariable(&host_framerate);
     Cvar_RegisterVariable(&host_speeds);
+    Cvar_RegisterVariable(&host_sleep);
 
     Cvar_RegisterVariable(&sys_ticrate);
     Cvar_RegisterVariable(&serverprofile);
@@ -248,6 +288,10 @@ void Host_InitLocal() {
 
     Cvar_RegisterVariable(&temp1);
 
+    Cmd_AddCommand("cpustats", Host_CPUStats_f);
+    cpustats_clock = clock();
+    cpustats_time = Sys_FloatTime();
+
     Host_FindMaxClients();
 
     // so a think at time 0 won't get called
@@ -660,19 +704,48 @@ void _Host_Frame(float time) {
     }
 
     BGMusic_Update();
+    Con_PrintPending();
 
     if (host_speeds.value) {
         pass1 = (time1 - time3) * 1000;
         time3 = Sys_FloatTime();
         pass2 = (time2 - time1) * 1000;
         pass3 = (time3 - time2) * 1000;
-        Con_Printf("%3i tot %3i server %3i gfx %3i snd\n",
-                   pass1 + pass2 + pass3, pass1, pass2, pass3);
+        Con_Printf("%3i tot %3i server %3i gfx %3i snd %3i pvs\n",
+                   pass1 + pass2 + pass3, pass1, pass2, pass3,
+                   mod_pvsdecompressions);
     }
+    mod_pvsdecompressions = 0;
 
     host_framecount++;
 }
 
+/*
+===================
+Host_Sleep
+
+Called after each pass of the main loop with the time the pass took.
+An idle dedicated server would otherwise spin in Host_FilterTime until
+the next frame is due; block on the network sockets instead, waking
+early to pull in client packets as they arrive.
+===================
+*/
+void Host_Sleep(double elapsed) {
+    if (cls.state != ca_dedicated || !host_sleep.value) {
+        return;
+    }
+    double wait = oldrealtime + 1.0 / 72.0 - (realtime + elapsed);
+    while (wait > HOST_SLEEPSLACK) {
+        const double start = Sys_FloatTime();
+        if (!NET_Sleep(wait - HOST_SLEEPSLACK)) {
+            // A connection request stays readable until the next frame
+            // reads it, so the sockets can't be waited on until then.
+            SDL_Delay(1);
+        }
+        wait -= Sys_FloatTime() - start;
+    }
+}
+
 void Host_Frame(float time) {
     static double timetotal;
     static i32 timecount;
@@ -770,6 +843,26 @@ void Host_InitTimer() {
     }
 }
 
+/*
+====================
+Host_InitBSPBench
+
+-bspbench <map> [count] times the brush model loading and quits
+====================
+*/
+static void Host_InitBSPBench(void) {
+    i32 i = COM_CheckParm("-bspbench");
+
+    if (!i || i >= com_argc - 1)
+        return;
+
+    if (i < com_argc - 2 && com_argv[i + 2][0] >= '0' &&
+        com_argv[i + 2][0] <= '9')
+        Cbuf_AddText(va("bspbench %s %s\n", com_argv[i + 1], com_argv[i + 2]));
+    else
+        Cbuf_AddText(va("bspbench %s\n", com_argv[i + 1]));
+}
+
 /*
 ====================
 Host_Init
@@ -807,6 +900,7 @@ void Host_Init(quakeparms_t* parms) {
     Con_Init();
     M_Init();
     PR_Init();
+    Jobs_Init();
     Mod_Init();
     NET_Init();
     SV_Init();
@@ -836,6 +930,7 @@ void Host_Init(quakeparms_t* parms) {
     }
 
     Cbuf_InsertText("exec quake.rc\n");
+    Host_InitBSPBench();
 
     Hunk_AllocName(0, "-HOST_HUNKLEVEL-");
     host_hunklevel = Hunk_LowMark();
@@ -872,6 +967,7 @@ void Host_Shutdown() {
     Host_WriteConfiguration();
 
     Host_ShutdownTimer();
+    Jobs_Shutdown();
     BGMusic_Shutdown();
     NET_Shutdown();
     S_Shutdown();
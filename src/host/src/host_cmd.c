@@ -22,6 +22,7 @@
 #include "host.h"
 #include "cmd.h"
 #include "console.h"
+#include "jobs.h"
 #include "keys.h"
 #include "screen.h"
 #include "server.h"
@@ -106,6 +107,8 @@ void Host_Status_f(void) {
         print("#%-2u %-16.16s  %3i  %2i:%02i:%02i\n", j + 1, client->name,
               (i32) client->edict->v.frags, hours, minutes, seconds);
         print("   %s\n", NET_GetSocketAddr(conn));
+        print("   rate %i  %i B/s  choke %i\n", SV_ClientRate(client),
+              client->bytespersec, client->chokecount);
     }
 }
 
@@ -283,6 +286,71 @@ void Host_Map_f(void) {
     }
 }
 
+/*
+======================
+Host_BSPBench_f
+
+bspbench <map> [count]
+Loads a map's brush model count times and prints the time spent per lump.
+Active clients are kicked off.
+======================
+*/
+void Host_BSPBench_f(void) {
+    char name[MAX_QPATH];
+    double start, time;
+    i32 i, count;
+    const qboolean quit = COM_CheckParm("-bspbench") != 0;
+
+    if (cmd_source != src_command)
+        return;
+
+    if (Cmd_Argc() < 2) {
+        Con_Printf("bspbench <map> [count] : time brush model loading\n");
+        return;
+    }
+
+    count = 10;
+    if (Cmd_Argc() > 2)
+        count = Q_atoi(Cmd_Argv(2));
+    if (count < 1)
+        count = 1;
+
+    const i32 len = snprintf(name, sizeof(name), "maps/%s.bsp", Cmd_Argv(1));
+    if (len < 0 || len >= (i32) sizeof(name)) {
+        if (quit)
+            Sys_Error("bspbench: map name too long");
+        Con_Printf("Map name too long\n");
+        return;
+    }
+
+    cls.demonum = -1;
+    CL_Disconnect();
+    Host_ShutdownServer(false);
+
+    Mod_ClearLumpTimes();
+    start = Sys_FloatTime();
+    for (i = 0; i < count; i++) {
+        Host_ClearMemory();
+        if (!Mod_ForName(name, false)) {
+            // a benchmark run must not carry on as if it had worked
+            if (quit)
+                Sys_Error("bspbench: couldn't load %s", name);
+            Con_Printf("Couldn't load %s\n", name);
+            return;
+        }
+    }
+    time = Sys_FloatTime() - start;
+    Host_ClearMemory();
+
+    Con_Printf("%s, %i loads, %i job threads\n", name, count,
+               Jobs_NumWorkers());
+    Mod_PrintLumpTimes();
+    Con_Printf("%-12s %8.3f ms\n", "wall", time * 1000 / count);
+
+    if (quit)
+        Sys_Quit();
+}
+
 /*
 ==================
 Host_Changelevel_f
@@ -827,6 +895,35 @@ void Host_Color_f(void) {
     MSG_WriteByte(&sv.reliable_datagram, host_client->colors);
 }
 
+/*
+==================
+Host_Rate_f
+
+Bytes per second the server may send us, 0 for as much as it likes.
+==================
+*/
+void Host_Rate_f(void) {
+    i32 rate;
+
+    if (Cmd_Argc() == 1) {
+        Con_Printf("\"rate\" is \"%i\"\n", (i32) cl_rate.value);
+        return;
+    }
+
+    rate = atoi(Cmd_Argv(1));
+    if (rate < 0)
+        rate = 0;
+
+    if (cmd_source == src_command) {
+        Cvar_SetValue("_cl_rate", rate);
+        if (cls.state == ca_connected)
+            Cmd_ForwardToServer();
+        return;
+    }
+
+    host_client->rate = rate;
+}
+
 /*
 ==================
 Host_Kill_f
@@ -898,6 +995,16 @@ void Host_PreSpawn_f(void) {
         return;
     }
 
+    if (sv.signon.cursize + 2 > host_client->message.maxsize - host_client->message.cursize) {
+        // Only clients with NET_EXT_BIGMESSAGES take signons past MAX_MSGLEN.
+        Con_Printf("%s can't take a %i byte signon\n", host_client->name, sv.signon.cursize);
+        SZ_Clear(&host_client->message);
+        MSG_WriteByte(&host_client->message, svc_print);
+        MSG_WriteString(&host_client->message, "This level is too large for your client.\n");
+        SV_DropClient(false);
+        return;
+    }
+
     SZ_Write(&host_client->message, sv.signon.data, sv.signon.cursize);
     MSG_WriteByte(&host_client->message, svc_signonnum);
     MSG_WriteByte(&host_client->message, 2);
@@ -1461,6 +1568,7 @@ void Host_InitCommands(void) {
     Cmd_AddCommand("notarget", Host_Notarget_f);
     Cmd_AddCommand("fly", Host_Fly_f);
     Cmd_AddCommand("map", Host_Map_f);
+    Cmd_AddCommand("bspbench", Host_BSPBench_f);
     Cmd_AddCommand("restart", Host_Restart_f);
     Cmd_AddCommand("changelevel", Host_Changelevel_f);
     Cmd_AddCommand("connect", Host_Connect_f);
@@ -1472,6 +1580,7 @@ void Host_InitCommands(void) {
     Cmd_AddCommand("say_team", Host_Say_Team_f);
     Cmd_AddCommand("tell", Host_Tell_f);
     Cmd_AddCommand("color", Host_Color_f);
+    Cmd_AddCommand("rate", Host_Rate_f);
     Cmd_AddCommand("kill", Host_Kill_f);
     Cmd_AddCommand("pause", Host_Pause_f);
     Cmd_AddCommand("spawn", Host_Spawn_f);
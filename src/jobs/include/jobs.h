@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 1996-1997 Id Software, Inc.
+ * Copyright (C) Henrique Barateli, <henriquejb194@gmail.com>, et al.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+// jobs.h -- worker thread pool for load-time work
+
+
+#ifndef __JOBS__
+#define __JOBS__
+
+#include "quakedef.h"
+#include <SDL_atomic.h>
+
+//
+// Jobs run on a small pool of worker threads. Job functions must not touch
+// the hunk, the cache, the console or any other engine global that is not
+// explicitly owned by the job; they should decode into memory handed to them
+// and let the main thread commit the results in a fixed order.
+//
+// With no worker threads (-nojobs, or a single CPU), jobs simply run on the
+// thread that waits for them, so results never depend on the thread count.
+//
+
+typedef void (*jobfunc_t)(void* data);
+
+// A set of jobs that can be waited upon together.
+typedef struct {
+    SDL_atomic_t submitted;
+    SDL_atomic_t finished;
+} jobgroup_t;
+
+void Jobs_Init(void);
+void Jobs_Shutdown(void);
+
+i32 Jobs_NumWorkers(void);
+
+void Jobs_ClearGroup(jobgroup_t* group);
+void Jobs_Submit(jobgroup_t* group, jobfunc_t func, void* data);
+
+// Returns true if every job submitted to the group has completed.
+qboolean Jobs_IsDone(jobgroup_t* group);
+
+// Runs one queued job on the calling thread.
+// Returns false if nothing was waiting to be run.
+qboolean Jobs_RunOne(void);
+
+// Blocks until every job in the group has completed, helping out with
+// queued work while waiting.
+void Jobs_Wait(jobgroup_t* group);
+
+#endif
@@ -0,0 +1,253 @@
+/*
+ * Copyright (C) 1996-1997 Id Software, Inc.
+ * Copyright (C) Henrique Barateli, <henriquejb194@gmail.com>, et al.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+// jobs.c -- worker thread pool for load-time work
+
+
+#include "jobs.h"
+#include "console.h"
+#include "sys.h"
+#include <SDL_cpuinfo.h>
+#include <SDL_mutex.h>
+#include <SDL_thread.h>
+
+
+#define MAX_JOB_THREADS 8
+#define MAX_QUEUED_JOBS 1024
+
+typedef struct {
+    jobfunc_t func;
+    void* data;
+    jobgroup_t* group;
+} job_t;
+
+static job_t job_queue[MAX_QUEUED_JOBS];
+static i32 job_head; // next job to be run
+static i32 job_count;
+
+static SDL_mutex* job_lock;
+static SDL_cond* job_wake;     // signaled when a job is queued
+static SDL_cond* job_finished; // signaled when a job completes
+
+static SDL_Thread* job_threads[MAX_JOB_THREADS];
+static i32 job_numthreads;
+static qboolean job_shutdown;
+
+
+/*
+================
+Jobs_Pop
+
+Takes the next job off the queue, job_lock must be held.
+================
+*/
+static qboolean Jobs_Pop(job_t* job) {
+    if (!job_count) {
+        return false;
+    }
+    *job = job_queue[job_head];
+    job_head = (job_head + 1) % MAX_QUEUED_JOBS;
+    job_count--;
+    return true;
+}
+
+/*
+================
+Jobs_Complete
+
+Marks a job as finished and wakes anybody waiting on it,
+job_lock must be held.
+================
+*/
+static void Jobs_Complete(const job_t* job) {
+    SDL_AtomicAdd(&job->group->finished, 1);
+    SDL_CondBroadcast(job_finished);
+}
+
+static int Jobs_WorkerThread(void* unused) {
+    job_t job;
+
+    SDL_LockMutex(job_lock);
+    while (true) {
+        while (!job_count && !job_shutdown) {
+            SDL_CondWait(job_wake, job_lock);
+        }
+        if (job_shutdown) {
+            break;
+        }
+        Jobs_Pop(&job);
+        SDL_UnlockMutex(job_lock);
+
+        job.func(job.data);
+
+        SDL_LockMutex(job_lock);
+        Jobs_Complete(&job);
+    }
+    SDL_UnlockMutex(job_lock);
+
+    return 0;
+}
+
+static i32 Jobs_DefaultThreadCount(void) {
+    if (COM_CheckParm("-nojobs")) {
+        return 0;
+    }
+    i32 i = COM_CheckParm("-jobs");
+    if (i && i < com_argc - 1) {
+        return Q_atoi(com_argv[i + 1]);
+    }
+    // Leave a core for the main thread.
+    return SDL_GetCPUCount() - 1;
+}
+
+/*
+================
+Jobs_Init
+================
+*/
+void Jobs_Init(void) {
+    job_lock = SDL_CreateMutex();
+    job_wake = SDL_CreateCond();
+    job_finished = SDL_CreateCond();
+    if (!job_lock || !job_wake || !job_finished) {
+        Sys_Error("Jobs_Init: %s", SDL_GetError());
+    }
+
+    i32 count = Jobs_DefaultThreadCount();
+    if (count < 0) {
+        count = 0;
+    } else if (count > MAX_JOB_THREADS) {
+        count = MAX_JOB_THREADS;
+    }
+
+    job_shutdown = false;
+    for (job_numthreads = 0; job_numthreads < count; job_numthreads++) {
+        SDL_Thread* thread =
+            SDL_CreateThread(Jobs_WorkerThread, "jobs", NULL);
+        if (!thread) {
+            Con_Printf("Couldn't create job thread: %s\n", SDL_GetError());
+            break;
+        }
+        job_threads[job_numthreads] = thread;
+    }
+
+    Con_Printf("Job threads: %i\n", job_numthreads);
+}
+
+/*
+================
+Jobs_Shutdown
+================
+*/
+void Jobs_Shutdown(void) {
+    if (!job_lock) {
+        return;
+    }
+
+    SDL_LockMutex(job_lock);
+    job_shutdown = true;
+    SDL_CondBroadcast(job_wake);
+    SDL_UnlockMutex(job_lock);
+
+    for (i32 i = 0; i < job_numthreads; i++) {
+        SDL_WaitThread(job_threads[i], NULL);
+        job_threads[i] = NULL;
+    }
+    job_numthreads = 0;
+    job_count = 0;
+
+    SDL_DestroyCond(job_finished);
+    SDL_DestroyCond(job_wake);
+    SDL_DestroyMutex(job_lock);
+    job_finished = NULL;
+    job_wake = NULL;
+    job_lock = NULL;
+}
+
+i32 Jobs_NumWorkers(void) {
+    return job_numthreads;
+}
+
+void Jobs_ClearGroup(jobgroup_t* group) {
+    SDL_AtomicSet(&group->submitted, 0);
+    SDL_AtomicSet(&group->finished, 0);
+}
+
+/*
+================
+Jobs_Submit
+
+Queues a job, or runs it right away if the queue is full.
+================
+*/
+void Jobs_Submit(jobgroup_t* group, jobfunc_t func, void* data) {
+    SDL_AtomicAdd(&group->submitted, 1);
+
+    SDL_LockMutex(job_lock);
+    if (job_count == MAX_QUEUED_JOBS) {
+        SDL_UnlockMutex(job_lock);
+        func(data);
+        SDL_AtomicAdd(&group->finished, 1);
+        return;
+    }
+    job_t* job = &job_queue[(job_head + job_count) % MAX_QUEUED_JOBS];
+    job->func = func;
+    job->data = data;
+    job->group = group;
+    job_count++;
+    SDL_CondSignal(job_wake);
+    SDL_UnlockMutex(job_lock);
+}
+
+qboolean Jobs_IsDone(jobgroup_t* group) {
+    return SDL_AtomicGet(&group->finished) ==
+           SDL_AtomicGet(&group->submitted);
+}
+
+qboolean Jobs_RunOne(void) {
+    job_t job;
+
+    SDL_LockMutex(job_lock);
+    if (!Jobs_Pop(&job)) {
+        SDL_UnlockMutex(job_lock);
+        return false;
+    }
+    SDL_UnlockMutex(job_lock);
+
+    job.func(job.data);
+
+    SDL_LockMutex(job_lock);
+    Jobs_Complete(&job);
+    SDL_UnlockMutex(job_lock);
+    return true;
+}
+
+void Jobs_Wait(jobgroup_t* group) {
+    while (!Jobs_IsDone(group)) {
+        if (Jobs_RunOne()) {
+            continue;
+        }
+        // Everything left is running on a worker.
+        SDL_LockMutex(job_lock);
+        if (!Jobs_IsDone(group)) {
+            SDL_CondWait(job_finished, job_lock);
+        }
+        SDL_UnlockMutex(job_lock);
+    }
+}
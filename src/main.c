@@ -35,5 +35,6 @@ int main(int argc, char* argv[]) {
         double dt = new_time - old_time;
         Host_Frame((float) dt);
         old_time = new_time;
+        Host_Sleep(Sys_FloatTime() - new_time);
     }
 }
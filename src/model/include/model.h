@@ -28,6 +28,7 @@
 #include "spritegn.h"
 #include "mathlib.h"
 #include "render.h"
+#include "jobs.h"
 #include "zone.h"
 
 /*
@@ -362,7 +363,15 @@ model_t* Mod_ForName(char* name, qboolean crash);
 void* Mod_Extradata(model_t* mod); // handles caching
 void Mod_TouchModel(char* name);
 
+void Mod_BeginPrecaching(jobgroup_t* jobs);
+void Mod_EndPrecaching(void);
+
+void Mod_ClearLumpTimes(void);
+void Mod_PrintLumpTimes(void);
+
 mleaf_t* Mod_PointInLeaf(float* p, model_t* model);
 byte* Mod_LeafPVS(mleaf_t* leaf, model_t* model);
 
+extern i32 mod_pvsdecompressions; // reset every host frame
+
 #endif // __MODEL__
@@ -0,0 +1,538 @@
+/*
+ * Copyright (C) 1996-1997 Id Software, Inc.
+ * Copyright (C) Henrique Barateli, <henriquejb194@gmail.com>, et al.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+// mod_cache.c -- on-disk cache of loaded models
+
+#include "mod_cache.h"
+#include "console.h"
+#include "sys.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+
+//
+// Loaded models are saved to <gamedir>/modelcache, keyed by the CRC and
+// length of the file they were loaded from, so the next load of an unchanged
+// file is a read and a pointer fixup instead of a parse.
+//
+// Alias models are position independent already, so their cache block is
+// written as is.  Brush models are saved as an image of the low hunk they
+// were loaded into, followed by the model_t.  Every pointer in the image
+// is replaced by an offset into it, and listed in a relocation table.
+// The image starts on a page boundary so it could be mapped straight from
+// the file.
+//
+// The files hold the in-memory structures, so they are only valid for the
+// build that wrote them; the layout field rejects files from builds with
+// different structure sizes.
+//
+
+#define MODCACHE_IDENT   (('C' << 24) + ('D' << 16) + ('M' << 8) + 'Q')
+#define MODCACHE_VERSION 1
+#define MODCACHE_ALIGN   4096
+
+#define MODCACHE_LAYOUT                                                        \
+    ((i32) (sizeof(void*) | sizeof(model_t) << 4 | sizeof(msurface_t) << 16 | \
+            sizeof(mleaf_t) << 24) ^                                           \
+     (i32) (sizeof(aliashdr_t) << 8))
+
+typedef struct {
+    i32 ident;
+    i32 version;
+    i32 layout;
+    i32 type; // mod_brush or mod_alias
+    i32 crc;  // of the source file
+    i32 filelen;
+    i32 flags;
+    i32 synctype;
+    i32 numframes;
+    i32 numrelocs;
+    i32 dataofs;
+    i32 size;
+} dmodcache_t;
+
+#define RELOC_IMAGE     0 // offset into the image
+#define RELOC_NOTEXTURE 1 // r_notexture_mip
+
+typedef struct {
+    i32 ofs; // slot offset, the model_t comes first, then the image
+    i32 kind;
+} mreloc_t;
+
+cvar_t mod_diskcache = {"mod_diskcache", "0"};
+
+// used while saving a brush model
+static model_t* mc_model;
+static model_t mc_modelcopy;
+static byte* mc_base;
+static byte* mc_image;
+static i32 mc_size;
+static mreloc_t* mc_relocs;
+static i32 mc_numrelocs;
+static qboolean mc_badpointer;
+
+
+/*
+=================
+Mod_InitDiskCache
+=================
+*/
+void Mod_InitDiskCache(void) {
+    Cvar_RegisterVariable(&mod_diskcache);
+}
+
+// Returns false if the path doesn't fit, then the model isn't cached.
+static qboolean Mod_CachePath(model_t* mod, char* path) {
+    const i32 len = snprintf(path, MAX_OSPATH, "%s/modelcache/%s.mdc",
+                             com_gamedir, mod->name);
+    return len >= 0 && len < MAX_OSPATH;
+}
+
+/*
+=================
+Mod_OpenCache
+
+Returns the cache file positioned after the header if it matches the
+model's source file
+=================
+*/
+static FILE* Mod_OpenCache(model_t* mod, dmodcache_t* header, modtype_t type,
+                           u16 crc, i32 filelen) {
+    char path[MAX_OSPATH];
+    FILE* f;
+
+    if (!Mod_CachePath(mod, path))
+        return NULL;
+    f = fopen(path, "rb");
+    if (!f)
+        return NULL;
+
+    if (fread(header, sizeof(*header), 1, f) != 1 ||
+        header->ident != MODCACHE_IDENT ||
+        header->version != MODCACHE_VERSION ||
+        header->layout != MODCACHE_LAYOUT || header->type != type ||
+        header->crc != crc || header->filelen != filelen ||
+        header->numrelocs < 0 || header->size <= 0) {
+        Con_DPrintf("%s: stale model cache\n", mod->name);
+        fclose(f);
+        return NULL;
+    }
+    return f;
+}
+
+/*
+=================
+Mod_WriteCache
+
+Writes a cache file, the data is aligned to MODCACHE_ALIGN
+=================
+*/
+static void Mod_WriteCache(model_t* mod, dmodcache_t* header, void* extra,
+                           i32 extrasize, void* data) {
+    char path[MAX_OSPATH];
+    byte pad[MODCACHE_ALIGN];
+    FILE* f;
+    i32 ofs;
+    qboolean ok;
+
+    if (!Mod_CachePath(mod, path))
+        return;
+    COM_CreatePath(path);
+    f = fopen(path, "wb");
+    if (!f) {
+        Con_DPrintf("Couldn't write %s\n", path);
+        return;
+    }
+
+    ofs = sizeof(*header) + extrasize;
+    header->dataofs = (ofs + MODCACHE_ALIGN - 1) & ~(MODCACHE_ALIGN - 1);
+
+    Q_memset(pad, 0, sizeof(pad));
+    ok = fwrite(header, sizeof(*header), 1, f) == 1;
+    if (extrasize)
+        ok = ok && fwrite(extra, extrasize, 1, f) == 1;
+    if (header->dataofs > ofs)
+        ok = ok && fwrite(pad, header->dataofs - ofs, 1, f) == 1;
+    ok = ok && fwrite(data, header->size, 1, f) == 1;
+    fclose(f);
+
+    if (!ok) {
+        Con_DPrintf("Couldn't write %s\n", path);
+        remove(path);
+        return;
+    }
+    Con_DPrintf("Cached %s\n", mod->name);
+}
+
+/*
+===============================================================================
+
+BRUSH MODELS
+
+===============================================================================
+*/
+
+static void Mod_AddReloc(void* slot) {
+    byte* copy;
+    byte* value;
+    mreloc_t* r;
+
+    if ((byte*) slot >= (byte*) mc_model &&
+        (byte*) slot < (byte*) (mc_model + 1)) {
+        r = &mc_relocs[mc_numrelocs];
+        r->ofs = (byte*) slot - (byte*) mc_model;
+        copy = (byte*) &mc_modelcopy + r->ofs;
+    } else if ((byte*) slot >= mc_base && (byte*) slot < mc_base + mc_size) {
+        r = &mc_relocs[mc_numrelocs];
+        r->ofs = sizeof(model_t) + ((byte*) slot - mc_base);
+        copy = mc_image + ((byte*) slot - mc_base);
+    } else {
+        mc_badpointer = true;
+        return;
+    }
+
+    Q_memcpy(&value, slot, sizeof(value));
+    if (!value)
+        return;
+
+    if (value >= mc_base && value < mc_base + mc_size) {
+        r->kind = RELOC_IMAGE;
+        value = (byte*) (uintptr_t) (value - mc_base);
+    } else if (value == (byte*) r_notexture_mip) {
+        r->kind = RELOC_NOTEXTURE;
+        value = NULL;
+    } else {
+        mc_badpointer = true;
+        return;
+    }
+    Q_memcpy(copy, &value, sizeof(value));
+    mc_numrelocs++;
+}
+
+/*
+=================
+Mod_MaxBrushRelocs
+=================
+*/
+static i32 Mod_MaxBrushRelocs(model_t* m) {
+    return 32 + 2 * MAX_MAP_HULLS + m->numtextures * 3 + m->numtexinfo +
+           m->numsurfaces * (3 + MIPLEVELS) + m->numnodes * 4 +
+           m->numleafs * 4 + m->nummarksurfaces;
+}
+
+/*
+=================
+Mod_RelocBrushPointers
+
+Lists every pointer of a freshly loaded brush model
+=================
+*/
+static void Mod_RelocBrushPointers(model_t* m) {
+    texture_t* tx;
+    msurface_t* surf;
+    mnode_t* node;
+    mleaf_t* leaf;
+    i32 i, j;
+
+    Mod_AddReloc(&m->submodels);
+    Mod_AddReloc(&m->planes);
+    Mod_AddReloc(&m->leafs);
+    Mod_AddReloc(&m->vertexes);
+    Mod_AddReloc(&m->edges);
+    Mod_AddReloc(&m->nodes);
+    Mod_AddReloc(&m->texinfo);
+    Mod_AddReloc(&m->surfaces);
+    Mod_AddReloc(&m->surfedges);
+    Mod_AddReloc(&m->clipnodes);
+    Mod_AddReloc(&m->marksurfaces);
+    Mod_AddReloc(&m->textures);
+    Mod_AddReloc(&m->visdata);
+    Mod_AddReloc(&m->lightdata);
+    Mod_AddReloc(&m->entities);
+    for (i = 0; i < MAX_MAP_HULLS; i++) {
+        Mod_AddReloc(&m->hulls[i].clipnodes);
+        Mod_AddReloc(&m->hulls[i].planes);
+    }
+
+    for (i = 0; i < m->numtextures; i++) {
+        Mod_AddReloc(&m->textures[i]);
+        tx = m->textures[i];
+        if (!tx)
+            continue;
+        Mod_AddReloc(&tx->anim_next);
+        Mod_AddReloc(&tx->alternate_anims);
+    }
+
+    for (i = 0; i < m->numtexinfo; i++)
+        Mod_AddReloc(&m->texinfo[i].texture);
+
+    for (i = 0, surf = m->surfaces; i < m->numsurfaces; i++, surf++) {
+        Mod_AddReloc(&surf->plane);
+        Mod_AddReloc(&surf->texinfo);
+        Mod_AddReloc(&surf->samples);
+        for (j = 0; j < MIPLEVELS; j++)
+            Mod_AddReloc(&surf->cachespots[j]);
+    }
+
+    for (i = 0, node = m->nodes; i < m->numnodes; i++, node++) {
+        Mod_AddReloc(&node->parent);
+        Mod_AddReloc(&node->plane);
+        Mod_AddReloc(&node->children[0]);
+        Mod_AddReloc(&node->children[1]);
+    }
+
+    for (i = 0, leaf = m->leafs; i < m->numleafs; i++, leaf++) {
+        Mod_AddReloc(&leaf->parent);
+        Mod_AddReloc(&leaf->compressed_vis);
+        Mod_AddReloc(&leaf->efrags);
+        Mod_AddReloc(&leaf->firstmarksurface);
+    }
+
+    for (i = 0; i < m->nummarksurfaces; i++)
+        Mod_AddReloc(&m->marksurfaces[i]);
+}
+
+/*
+=================
+Mod_SaveBrushCache
+
+base and size cover the low hunk the model was loaded into.  Must be called
+before the submodels are set up, while the model_t still holds the counts
+of the whole file.
+=================
+*/
+void Mod_SaveBrushCache(model_t* mod, u16 crc, i32 filelen, byte* base,
+                        i32 size) {
+    dmodcache_t header;
+    byte* extra;
+    i32 extrasize;
+
+    if (!mod_diskcache.value || size <= 0)
+        return;
+
+    mc_model = mod;
+    mc_modelcopy = *mod;
+    mc_base = base;
+    mc_size = size;
+    mc_image = Q_malloc(size);
+    mc_relocs = Q_malloc(Mod_MaxBrushRelocs(mod) * sizeof(*mc_relocs));
+    mc_numrelocs = 0;
+    mc_badpointer = false;
+    if (!mc_image || !mc_relocs)
+        goto done;
+
+    Q_memcpy(mc_image, base, size);
+    Mod_RelocBrushPointers(mod);
+    if (mc_badpointer) {
+        Con_DPrintf("%s: can't cache, pointer outside of the model\n",
+                    mod->name);
+        goto done;
+    }
+
+    // the model_t and relocations go between the header and the image
+    extrasize = sizeof(model_t) + mc_numrelocs * sizeof(mreloc_t);
+    extra = Q_malloc(extrasize);
+    if (!extra)
+        goto done;
+    Q_memcpy(extra, &mc_modelcopy, sizeof(model_t));
+    Q_memcpy(extra + sizeof(model_t), mc_relocs,
+             mc_numrelocs * sizeof(mreloc_t));
+
+    Q_memset(&header, 0, sizeof(header));
+    header.ident = MODCACHE_IDENT;
+    header.version = MODCACHE_VERSION;
+    header.layout = MODCACHE_LAYOUT;
+    header.type = mod_brush;
+    header.crc = crc;
+    header.filelen = filelen;
+    header.flags = mod->flags;
+    header.numframes = mod->numframes;
+    header.numrelocs = mc_numrelocs;
+    header.size = size;
+    Mod_WriteCache(mod, &header, extra, extrasize, mc_image);
+    Q_free(extra);
+
+done:
+    Q_free(mc_image);
+    Q_free(mc_relocs);
+    mc_image = NULL;
+    mc_relocs = NULL;
+    mc_model = NULL;
+}
+
+/*
+=================
+Mod_LoadBrushCache
+
+Loads the model from the cache into the low hunk, in the same state
+Mod_SaveBrushCache saw it.  Returns false if there is no valid cache.
+=================
+*/
+qboolean Mod_LoadBrushCache(model_t* mod, u16 crc, i32 filelen) {
+    dmodcache_t header;
+    model_t loaded;
+    mreloc_t* relocs;
+    byte* image;
+    byte* slot;
+    byte* value;
+    char name[32];
+    FILE* f;
+    i32 i, mark;
+
+    if (!mod_diskcache.value)
+        return false;
+
+    f = Mod_OpenCache(mod, &header, mod_brush, crc, filelen);
+    if (!f)
+        return false;
+
+    relocs = Q_malloc(header.numrelocs * sizeof(*relocs) + 1);
+    if (!relocs || fread(&loaded, sizeof(loaded), 1, f) != 1 ||
+        fread(relocs, sizeof(*relocs), header.numrelocs, f) !=
+            (size_t) header.numrelocs) {
+        Q_free(relocs);
+        fclose(f);
+        return false;
+    }
+
+    COM_FileBase(mod->name, name, sizeof(name));
+    mark = Hunk_LowMark();
+    image = Hunk_AllocName(header.size, name);
+    if (fseek(f, header.dataofs, SEEK_SET) ||
+        fread(image, header.size, 1, f) != 1)
+        goto fail;
+    fclose(f);
+    f = NULL;
+
+    for (i = 0; i < header.numrelocs; i++) {
+        if (relocs[i].ofs < 0 || relocs[i].ofs + (i32) sizeof(void*) >
+                                     (i32) sizeof(model_t) + header.size)
+            goto fail;
+        if (relocs[i].ofs < (i32) sizeof(model_t))
+            slot = (byte*) &loaded + relocs[i].ofs;
+        else
+            slot = image + relocs[i].ofs - sizeof(model_t);
+
+        if (relocs[i].kind == RELOC_NOTEXTURE) {
+            value = (byte*) r_notexture_mip;
+        } else {
+            Q_memcpy(&value, slot, sizeof(value));
+            if ((uintptr_t) value >= (uintptr_t) header.size)
+                goto fail;
+            value = image + (uintptr_t) value;
+        }
+        Q_memcpy(slot, &value, sizeof(value));
+    }
+    Q_free(relocs);
+
+    Q_memcpy(loaded.name, mod->name, sizeof(loaded.name));
+    loaded.needload = mod->needload;
+    loaded.cache = mod->cache;
+    *mod = loaded;
+
+    for (i = 0; i < mod->numtextures; i++) {
+        if (mod->textures[i] && !Q_strncmp(mod->textures[i]->name, "sky", 3))
+            R_InitSky(mod->textures[i]);
+    }
+
+    Con_DPrintf("%s loaded from the model cache\n", mod->name);
+    return true;
+
+fail:
+    Con_DPrintf("%s: bad model cache\n", mod->name);
+    if (f)
+        fclose(f);
+    Q_free(relocs);
+    Hunk_FreeToLowMark(mark);
+    return false;
+}
+
+/*
+===============================================================================
+
+ALIAS MODELS
+
+===============================================================================
+*/
+
+/*
+=================
+Mod_SaveAliasCache
+
+data is the position independent cache block of the model
+=================
+*/
+void Mod_SaveAliasCache(model_t* mod, u16 crc, i32 filelen, void* data,
+                        i32 size) {
+    dmodcache_t header;
+
+    if (!mod_diskcache.value || size <= 0)
+        return;
+
+    Q_memset(&header, 0, sizeof(header));
+    header.ident = MODCACHE_IDENT;
+    header.version = MODCACHE_VERSION;
+    header.layout = MODCACHE_LAYOUT;
+    header.type = mod_alias;
+    header.crc = crc;
+    header.filelen = filelen;
+    header.flags = mod->flags;
+    header.synctype = mod->synctype;
+    header.numframes = mod->numframes;
+    header.size = size;
+    Mod_WriteCache(mod, &header, NULL, 0, data);
+}
+
+/*
+=================
+Mod_LoadAliasCache
+
+Returns the Q_malloc'ed cache block and fills in the model's flags, or NULL
+if there is no valid cache
+=================
+*/
+void* Mod_LoadAliasCache(model_t* mod, u16 crc, i32 filelen, i32* size) {
+    dmodcache_t header;
+    FILE* f;
+    byte* data;
+
+    if (!mod_diskcache.value)
+        return NULL;
+
+    f = Mod_OpenCache(mod, &header, mod_alias, crc, filelen);
+    if (!f)
+        return NULL;
+
+    data = Q_malloc(header.size);
+    if (!data || fseek(f, header.dataofs, SEEK_SET) ||
+        fread(data, header.size, 1, f) != 1) {
+        Con_DPrintf("%s: bad model cache\n", mod->name);
+        Q_free(data);
+        fclose(f);
+        return NULL;
+    }
+    fclose(f);
+
+    mod->flags = header.flags;
+    mod->synctype = header.synctype;
+    mod->numframes = header.numframes;
+    *size = header.size;
+    return data;
+}
@@ -0,0 +1,42 @@
+/*
+ * Copyright (C) 1996-1997 Id Software, Inc.
+ * Copyright (C) Henrique Barateli, <henriquejb194@gmail.com>, et al.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+// mod_cache.h -- on-disk cache of loaded models
+
+
+#ifndef __MOD_CACHE__
+#define __MOD_CACHE__
+
+#include "quakedef.h"
+#include "model.h"
+#include "cvar.h"
+
+extern cvar_t mod_diskcache;
+
+void Mod_InitDiskCache(void);
+
+qboolean Mod_LoadBrushCache(model_t* mod, u16 crc, i32 filelen);
+void Mod_SaveBrushCache(model_t* mod, u16 crc, i32 filelen, byte* base,
+                        i32 size);
+
+void* Mod_LoadAliasCache(model_t* mod, u16 crc, i32 filelen, i32* size);
+void Mod_SaveAliasCache(model_t* mod, u16 crc, i32 filelen, void* data,
+                        i32 size);
+
+#endif // __MOD_CACHE__
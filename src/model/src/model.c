@@ -25,9 +25,12 @@
 
 #include "model.h"
 #include "console.h"
+#include "crc.h"
+#include "mod_cache.h"
 #include "r_local.h"
 #include "sys.h"
 #include <math.h>
+#include <setjmp.h>
 #include <string.h>
 
 
@@ -38,9 +41,16 @@ void Mod_LoadSpriteModel(model_t* mod, void* buffer);
 void Mod_LoadBrushModel(model_t* mod, void* buffer);
 void Mod_LoadAliasModel(model_t* mod, void* buffer);
 model_t* Mod_LoadModel(model_t* mod, qboolean crash);
+static qboolean Mod_IsPending(model_t* mod);
+static void Mod_DiscardPending(void);
+static void Mod_SetupSubmodels(model_t* mod);
+static void Mod_FlushPVSCache(void);
 
 byte mod_novis[MAX_MAP_LEAFS / 8];
 
+cvar_t mod_pvscache = {"mod_pvscache", "4096"}; // kilobytes, 0 = off
+i32 mod_pvsdecompressions;
+
 #define MAX_MOD_KNOWN 256
 model_t mod_known[MAX_MOD_KNOWN];
 i32 mod_numknown;
@@ -50,6 +60,35 @@ i32 mod_numknown;
 #define NL_NEEDS_LOADED 1
 #define NL_UNREFERENCED 2
 
+// Alias models are decoded into a private block of memory instead of the
+// hunk, so that the decoding can run on a job thread. The block is position
+// independent and is copied into the cache by the main thread.
+typedef struct {
+    byte* base;
+    i32 size;
+    i32 used;
+    const char* error; // set by the job, raised by the main thread
+    jmp_buf abort;     // where Mod_AliasError returns to
+} aliasbuild_t;
+
+// An alias model queued for decoding between Mod_BeginPrecaching and
+// Mod_EndPrecaching.
+typedef struct {
+    model_t* mod;
+    byte* file; // Q_malloc'ed file contents
+    aliasbuild_t build;
+    i32 flags;
+    synctype_t synctype;
+    i32 numframes;
+    qboolean tocache; // save to the disk cache when committed
+    u16 crc;
+    i32 filelen;
+} aliasjob_t;
+
+static jobgroup_t* mod_precache_jobs;
+static aliasjob_t* mod_pending[MAX_MOD_KNOWN];
+static i32 mod_numpending;
+
 
 /*
 ===============
@@ -58,6 +97,8 @@ Mod_Init
 */
 void Mod_Init(void) {
     Q_memset(mod_novis, 0xff, sizeof(mod_novis));
+    Cvar_RegisterVariable(&mod_pvscache);
+    Mod_InitDiskCache();
 }
 
 /*
@@ -112,24 +153,25 @@ mleaf_t* Mod_PointInLeaf(vec3_t p, model_t* model) {
 
 /*
 ===================
-Mod_DecompressVis
+Mod_DecompressVisRow
 ===================
 */
-byte* Mod_DecompressVis(byte* in, model_t* model) {
-    static byte decompressed[MAX_MAP_LEAFS / 8];
+static void Mod_DecompressVisRow(byte* in, model_t* model, byte* out) {
     i32 c;
-    byte* out;
+    byte* start;
     i32 row;
 
     row = (model->numleafs + 7) >> 3;
-    out = decompressed;
+    start = out;
+
+    mod_pvsdecompressions++;
 
     if (!in) { // no vis info, so make all visible
         while (row) {
             *out++ = 0xff;
             row--;
         }
-        return decompressed;
+        return;
     }
 
     do {
@@ -138,20 +180,193 @@ byte* Mod_DecompressVis(byte* in, model_t* model) {
             continue;
         }
 
+        // a malformed run must not spill into the next cached row
         c = in[1];
         in += 2;
+        if (c > row - (out - start))
+            c = row - (out - start);
         while (c) {
             *out++ = 0;
             c--;
         }
-    } while (out - decompressed < row);
+    } while (out - start < row);
+}
+
+/*
+===================
+Mod_DecompressVis
+===================
+*/
+byte* Mod_DecompressVis(byte* in, model_t* model) {
+    static byte decompressed[MAX_MAP_LEAFS / 8];
 
+    Mod_DecompressVisRow(in, model, decompressed);
     return decompressed;
 }
 
+/*
+===============================================================================
+
+PVS CACHE
+
+Decompressed PVS rows of the last model asked for are kept in a pool of at
+most mod_pvscache kilobytes.  If the pool can't hold a row for every leaf,
+the least recently used row is decompressed over.
+
+===============================================================================
+*/
+
+static model_t* pvs_model; // the pool is for this model
+static mleaf_t* pvs_leafs; // and its leafs, in case the model_t is reused
+static i32 pvs_budget;     // mod_pvscache.value the pool was sized for
+static i32 pvs_rowbytes;
+static i32 pvs_numslots;
+static byte* pvs_rows;
+static i32* pvs_slotforleaf; // -1 if the leaf has no row in the pool
+static i32* pvs_leafforslot;
+static i32* pvs_prev; // LRU list, pvs_head is the most recently used
+static i32* pvs_next;
+static i32 pvs_head, pvs_tail;
+static i32 pvs_used;
+
+
+/*
+===================
+Mod_FlushPVSCache
+===================
+*/
+static void Mod_FlushPVSCache(void) {
+    Q_free(pvs_rows);
+    Q_free(pvs_slotforleaf);
+    Q_free(pvs_leafforslot);
+    Q_free(pvs_prev);
+    Q_free(pvs_next);
+    pvs_rows = NULL;
+    pvs_slotforleaf = pvs_leafforslot = pvs_prev = pvs_next = NULL;
+    pvs_model = NULL;
+    pvs_leafs = NULL;
+    pvs_numslots = 0;
+}
+
+/*
+===================
+Mod_InitPVSCache
+
+Sizes the pool for model, returns false if it is disabled
+===================
+*/
+static qboolean Mod_InitPVSCache(model_t* model) {
+    i32 numleafs, slots;
+
+    Mod_FlushPVSCache();
+
+    pvs_model = model;
+    pvs_leafs = model->leafs;
+    pvs_budget = mod_pvscache.value;
+    if (pvs_budget <= 0)
+        return false;
+
+    numleafs = model->numleafs + 1; // leaf 0 is the solid leaf
+    pvs_rowbytes = (model->numleafs + 7) >> 3;
+    slots = (i32) ((pvs_budget * 1024.0) / pvs_rowbytes);
+    if (slots > numleafs)
+        slots = numleafs;
+    if (slots < 2)
+        return false;
+
+    pvs_rows = Q_malloc(slots * pvs_rowbytes);
+    pvs_slotforleaf = Q_malloc(numleafs * sizeof(i32));
+    pvs_leafforslot = Q_malloc(slots * sizeof(i32));
+    pvs_prev = Q_malloc(slots * sizeof(i32));
+    pvs_next = Q_malloc(slots * sizeof(i32));
+    if (!pvs_rows || !pvs_slotforleaf || !pvs_leafforslot || !pvs_prev ||
+        !pvs_next) {
+        Mod_FlushPVSCache();
+        pvs_model = model;
+        pvs_leafs = model->leafs;
+        return false;
+    }
+
+    for (i32 i = 0; i < numleafs; i++)
+        pvs_slotforleaf[i] = -1;
+    pvs_numslots = slots;
+    pvs_used = 0;
+    pvs_head = pvs_tail = -1;
+    return true;
+}
+
+static void Mod_UnlinkPVSSlot(i32 slot) {
+    if (pvs_prev[slot] != -1)
+        pvs_next[pvs_prev[slot]] = pvs_next[slot];
+    else
+        pvs_head = pvs_next[slot];
+    if (pvs_next[slot] != -1)
+        pvs_prev[pvs_next[slot]] = pvs_prev[slot];
+    else
+        pvs_tail = pvs_prev[slot];
+}
+
+static void Mod_LinkPVSSlot(i32 slot) {
+    pvs_prev[slot] = -1;
+    pvs_next[slot] = pvs_head;
+    if (pvs_head != -1)
+        pvs_prev[pvs_head] = slot;
+    pvs_head = slot;
+    if (pvs_tail == -1)
+        pvs_tail = slot;
+}
+
+/*
+===================
+Mod_CachedLeafPVS
+===================
+*/
+static byte* Mod_CachedLeafPVS(mleaf_t* leaf, model_t* model) {
+    i32 leafnum, slot;
+
+    leafnum = leaf - model->leafs;
+    slot = pvs_slotforleaf[leafnum];
+    if (slot != -1) {
+        if (slot != pvs_head) {
+            Mod_UnlinkPVSSlot(slot);
+            Mod_LinkPVSSlot(slot);
+        }
+        return pvs_rows + slot * pvs_rowbytes;
+    }
+
+    if (pvs_used < pvs_numslots) {
+        slot = pvs_used++;
+    } else { // reuse the least recently used row
+        slot = pvs_tail;
+        Mod_UnlinkPVSSlot(slot);
+        pvs_slotforleaf[pvs_leafforslot[slot]] = -1;
+    }
+    pvs_slotforleaf[leafnum] = slot;
+    pvs_leafforslot[slot] = leafnum;
+    Mod_LinkPVSSlot(slot);
+
+    Mod_DecompressVisRow(leaf->compressed_vis, model,
+                         pvs_rows + slot * pvs_rowbytes);
+    return pvs_rows + slot * pvs_rowbytes;
+}
+
+/*
+===================
+Mod_LeafPVS
+
+The returned row is only valid until the next call
+===================
+*/
 byte* Mod_LeafPVS(mleaf_t* leaf, model_t* model) {
     if (leaf == model->leafs)
         return mod_novis;
+
+    if (model != pvs_model || model->leafs != pvs_leafs ||
+        (i32) mod_pvscache.value != pvs_budget)
+        Mod_InitPVSCache(model);
+    if (pvs_numslots)
+        return Mod_CachedLeafPVS(leaf, model);
+
     return Mod_DecompressVis(leaf->compressed_vis, model);
 }
 
@@ -164,6 +379,9 @@ void Mod_ClearAll(void) {
     i32 i;
     model_t* mod;
 
+    Mod_DiscardPending();
+    mod_precache_jobs = NULL;
+    Mod_FlushPVSCache();
 
     for (i = 0, mod = mod_known; i < mod_numknown; i++, mod++) {
         mod->needload = NL_UNREFERENCED;
@@ -243,12 +461,15 @@ Loads a model into the cache
 model_t* Mod_LoadModel(model_t* mod, qboolean crash) {
     u32* buf;
     byte stackbuf[1024]; // avoid dirtying the cache heap
+    qboolean queued;
 
     if (mod->type == mod_alias) {
         if (Cache_Check(&mod->cache)) {
             mod->needload = NL_PRESENT;
             return mod;
         }
+        if (Mod_IsPending(mod))
+            return mod;
     } else {
         if (mod->needload == NL_PRESENT)
             return mod;
@@ -261,7 +482,10 @@ model_t* Mod_LoadModel(model_t* mod, qboolean crash) {
     //
     // load the file
     //
-    buf = (u32*) COM_LoadStackFile(mod->name, stackbuf, sizeof(stackbuf));
+    if (mod_precache_jobs)
+        buf = (u32*) COM_LoadMallocFile(mod->name);
+    else
+        buf = (u32*) COM_LoadStackFile(mod->name, stackbuf, sizeof(stackbuf));
     if (!buf) {
         if (crash)
             Sys_Error("Mod_NumForName: %s not found", mod->name);
@@ -281,10 +505,12 @@ model_t* Mod_LoadModel(model_t* mod, qboolean crash) {
 
     // call the apropriate loader
     mod->needload = NL_PRESENT;
+    queued = false;
 
     switch (LittleLong(*buf)) {
         case IDPOLYHEADER:
             Mod_LoadAliasModel(mod, buf);
+            queued = mod_precache_jobs != NULL; // the job owns the file now
             break;
 
         case IDSPRITEHEADER:
@@ -296,6 +522,9 @@ model_t* Mod_LoadModel(model_t* mod, qboolean crash) {
             break;
     }
 
+    if (mod_precache_jobs && !queued)
+        Q_free(buf);
+
     return mod;
 }
 
@@ -325,6 +554,149 @@ model_t* Mod_ForName(char* name, qboolean crash) {
 
 byte* mod_base;
 
+//
+// The lumps are converted by jobs, in two passes.  All of the hunk memory is
+// allocated on the main thread first, in the same order the lumps have
+// always been loaded in, so the jobs only fill in memory they own and the
+// hunk layout does not depend on the number of threads.  Faces need the
+// vertexes, edges, surfedges and texinfo to compute their extents, and the
+// drawing hull needs the nodes and leafs, so those go in the second pass.
+//
+
+#define LUMP_HULL0      HEADER_LUMPS // timing slot for Mod_MakeHull0
+#define MAX_LUMP_JOBS   512
+#define LUMP_BATCH      2048 // elements per job
+#define MAX_LUMP_SPLITS 32
+
+typedef struct lumpjob_s {
+    void (*convert)(struct lumpjob_s* job);
+    i32 lump; // LUMP_*, for the timing report
+    void* in;
+    void* out;
+    i32 count;
+    char* error; // set by the job, raised by the main thread
+    double time;
+} lumpjob_t;
+
+static jobgroup_t mod_lumpgroup;
+static lumpjob_t mod_lumpjobs[MAX_LUMP_JOBS];
+static i32 mod_numlumpjobs;
+
+// seconds spent on each lump since the last Mod_ClearLumpTimes
+static double mod_lumptime[HEADER_LUMPS + 1];
+static i32 mod_lumploads;
+
+static char* mod_lumpnames[HEADER_LUMPS + 1] = {
+    "entities", "planes",    "textures", "vertexes",     "visibility",
+    "nodes",    "texinfo",   "faces",    "lighting",     "clipnodes",
+    "leafs",    "marksurfs", "edges",    "surfedges",    "models",
+    "hull0",
+};
+
+
+static void Mod_RunLumpJob(void* data) {
+    lumpjob_t* job = data;
+    double start;
+
+    start = Sys_FloatTime();
+    job->convert(job);
+    job->time = Sys_FloatTime() - start;
+}
+
+/*
+=================
+Mod_QueueLump
+
+Splits the conversion of count elements into batches for the job threads
+=================
+*/
+static void Mod_QueueLump(i32 lump, void (*convert)(lumpjob_t* job), void* in,
+                          i32 insize, void* out, i32 outsize, i32 count) {
+    lumpjob_t* job;
+    i32 batch, splits;
+
+    splits = (count + LUMP_BATCH - 1) / LUMP_BATCH;
+    if (splits > MAX_LUMP_SPLITS)
+        splits = MAX_LUMP_SPLITS;
+    if (splits < 1)
+        return;
+    batch = (count + splits - 1) / splits;
+
+    while (count > 0) {
+        if (mod_numlumpjobs == MAX_LUMP_JOBS)
+            Sys_Error("Mod_QueueLump: MAX_LUMP_JOBS");
+        job = &mod_lumpjobs[mod_numlumpjobs++];
+        job->convert = convert;
+        job->lump = lump;
+        job->in = in;
+        job->out = out;
+        job->count = batch < count ? batch : count;
+        job->error = NULL;
+        job->time = 0;
+
+        in = (byte*) in + job->count * insize;
+        out = (byte*) out + job->count * outsize;
+        count -= job->count;
+    }
+}
+
+/*
+=================
+Mod_RunLumpJobs
+
+Converts everything queued since the last call and waits for it
+=================
+*/
+static void Mod_RunLumpJobs(void) {
+    lumpjob_t* job;
+    i32 i;
+
+    Jobs_ClearGroup(&mod_lumpgroup);
+    for (i = 0; i < mod_numlumpjobs; i++)
+        Jobs_Submit(&mod_lumpgroup, Mod_RunLumpJob, &mod_lumpjobs[i]);
+    Jobs_Wait(&mod_lumpgroup);
+
+    for (i = 0, job = mod_lumpjobs; i < mod_numlumpjobs; i++, job++) {
+        if (job->error)
+            Sys_Error("%s in %s", job->error, loadmodel->name);
+        mod_lumptime[job->lump] += job->time;
+    }
+    mod_numlumpjobs = 0;
+}
+
+/*
+=================
+Mod_ClearLumpTimes
+=================
+*/
+void Mod_ClearLumpTimes(void) {
+    Q_memset(mod_lumptime, 0, sizeof(mod_lumptime));
+    mod_lumploads = 0;
+}
+
+/*
+=================
+Mod_PrintLumpTimes
+
+Prints the average time spent on each lump per brush model load
+=================
+*/
+void Mod_PrintLumpTimes(void) {
+    double total;
+    i32 i;
+
+    if (!mod_lumploads)
+        return;
+
+    total = 0;
+    for (i = 0; i <= HEADER_LUMPS; i++) {
+        Con_Printf("%-12s %8.3f ms\n", mod_lumpnames[i],
+                   mod_lumptime[i] * 1000 / mod_lumploads);
+        total += mod_lumptime[i];
+    }
+    Con_Printf("%-12s %8.3f ms\n", "total", total * 1000 / mod_lumploads);
+}
+
 
 /*
 =================
@@ -462,6 +834,10 @@ void Mod_LoadTextures(lump_t* l) {
     }
 }
 
+static void Mod_ConvertCopy(lumpjob_t* job) {
+    Q_memcpy(job->out, job->in, job->count);
+}
+
 /*
 =================
 Mod_LoadLighting
@@ -473,7 +849,8 @@ void Mod_LoadLighting(lump_t* l) {
         return;
     }
     loadmodel->lightdata = Hunk_AllocName(l->filelen, loadname);
-    Q_memcpy(loadmodel->lightdata, mod_base + l->fileofs, l->filelen);
+    Mod_QueueLump(LUMP_LIGHTING, Mod_ConvertCopy, mod_base + l->fileofs, 1,
+                  loadmodel->lightdata, 1, l->filelen);
 }
 
 
@@ -488,7 +865,8 @@ void Mod_LoadVisibility(lump_t* l) {
         return;
     }
     loadmodel->visdata = Hunk_AllocName(l->filelen, loadname);
-    Q_memcpy(loadmodel->visdata, mod_base + l->fileofs, l->filelen);
+    Mod_QueueLump(LUMP_VISIBILITY, Mod_ConvertCopy, mod_base + l->fileofs, 1,
+                  loadmodel->visdata, 1, l->filelen);
 }
 
 
@@ -503,10 +881,22 @@ void Mod_LoadEntities(lump_t* l) {
         return;
     }
     loadmodel->entities = Hunk_AllocName(l->filelen, loadname);
-    Q_memcpy(loadmodel->entities, mod_base + l->fileofs, l->filelen);
+    Mod_QueueLump(LUMP_ENTITIES, Mod_ConvertCopy, mod_base + l->fileofs, 1,
+                  loadmodel->entities, 1, l->filelen);
 }
 
 
+static void Mod_ConvertVertexes(lumpjob_t* job) {
+    dvertex_t* in = job->in;
+    mvertex_t* out = job->out;
+
+    for (i32 i = 0; i < job->count; i++, in++, out++) {
+        out->position[0] = LittleFloat(in->point[0]);
+        out->position[1] = LittleFloat(in->point[1]);
+        out->position[2] = LittleFloat(in->point[2]);
+    }
+}
+
 /*
 =================
 Mod_LoadVertexes
@@ -515,7 +905,7 @@ Mod_LoadVertexes
 void Mod_LoadVertexes(lump_t* l) {
     dvertex_t* in;
     mvertex_t* out;
-    i32 i, count;
+    i32 count;
 
     in = (void*) (mod_base + l->fileofs);
     if (l->filelen % sizeof(*in))
@@ -526,10 +916,26 @@ void Mod_LoadVertexes(lump_t* l) {
     loadmodel->vertexes = out;
     loadmodel->numvertexes = count;
 
-    for (i = 0; i < count; i++, in++, out++) {
-        out->position[0] = LittleFloat(in->point[0]);
-        out->position[1] = LittleFloat(in->point[1]);
-        out->position[2] = LittleFloat(in->point[2]);
+    Mod_QueueLump(LUMP_VERTEXES, Mod_ConvertVertexes, in, sizeof(*in), out,
+                  sizeof(*out), count);
+}
+
+static void Mod_ConvertSubmodels(lumpjob_t* job) {
+    dmodel_t* in = job->in;
+    dmodel_t* out = job->out;
+    i32 i, j;
+
+    for (i = 0; i < job->count; i++, in++, out++) {
+        for (j = 0; j < 3; j++) { // spread the mins / maxs by a pixel
+            out->mins[j] = LittleFloat(in->mins[j]) - 1;
+            out->maxs[j] = LittleFloat(in->maxs[j]) + 1;
+            out->origin[j] = LittleFloat(in->origin[j]);
+        }
+        for (j = 0; j < MAX_MAP_HULLS; j++)
+            out->headnode[j] = LittleLong(in->headnode[j]);
+        out->visleafs = LittleLong(in->visleafs);
+        out->firstface = LittleLong(in->firstface);
+        out->numfaces = LittleLong(in->numfaces);
     }
 }
 
@@ -541,7 +947,7 @@ Mod_LoadSubmodels
 void Mod_LoadSubmodels(lump_t* l) {
     dmodel_t* in;
     dmodel_t* out;
-    i32 i, j, count;
+    i32 count;
 
     in = (void*) (mod_base + l->fileofs);
     if (l->filelen % sizeof(*in))
@@ -552,17 +958,17 @@ void Mod_LoadSubmodels(lump_t* l) {
     loadmodel->submodels = out;
     loadmodel->numsubmodels = count;
 
-    for (i = 0; i < count; i++, in++, out++) {
-        for (j = 0; j < 3; j++) { // spread the mins / maxs by a pixel
-            out->mins[j] = LittleFloat(in->mins[j]) - 1;
-            out->maxs[j] = LittleFloat(in->maxs[j]) + 1;
-            out->origin[j] = LittleFloat(in->origin[j]);
-        }
-        for (j = 0; j < MAX_MAP_HULLS; j++)
-            out->headnode[j] = LittleLong(in->headnode[j]);
-        out->visleafs = LittleLong(in->visleafs);
-        out->firstface = LittleLong(in->firstface);
-        out->numfaces = LittleLong(in->numfaces);
+    Mod_QueueLump(LUMP_MODELS, Mod_ConvertSubmodels, in, sizeof(*in), out,
+                  sizeof(*out), count);
+}
+
+static void Mod_ConvertEdges(lumpjob_t* job) {
+    dedge_t* in = job->in;
+    medge_t* out = job->out;
+
+    for (i32 i = 0; i < job->count; i++, in++, out++) {
+        out->v[0] = (u16) LittleShort(in->v[0]);
+        out->v[1] = (u16) LittleShort(in->v[1]);
     }
 }
 
@@ -574,7 +980,7 @@ Mod_LoadEdges
 void Mod_LoadEdges(lump_t* l) {
     dedge_t* in;
     medge_t* out;
-    i32 i, count;
+    i32 count;
 
     in = (void*) (mod_base + l->fileofs);
     if (l->filelen % sizeof(*in))
@@ -585,34 +991,18 @@ void Mod_LoadEdges(lump_t* l) {
     loadmodel->edges = out;
     loadmodel->numedges = count;
 
-    for (i = 0; i < count; i++, in++, out++) {
-        out->v[0] = (u16) LittleShort(in->v[0]);
-        out->v[1] = (u16) LittleShort(in->v[1]);
-    }
+    Mod_QueueLump(LUMP_EDGES, Mod_ConvertEdges, in, sizeof(*in), out,
+                  sizeof(*out), count);
 }
 
-/*
-=================
-Mod_LoadTexinfo
-=================
-*/
-void Mod_LoadTexinfo(lump_t* l) {
-    texinfo_t* in;
-    mtexinfo_t* out;
-    i32 i, j, count;
+static void Mod_ConvertTexinfo(lumpjob_t* job) {
+    texinfo_t* in = job->in;
+    mtexinfo_t* out = job->out;
+    i32 i, j;
     i32 miptex;
     float len1, len2;
 
-    in = (void*) (mod_base + l->fileofs);
-    if (l->filelen % sizeof(*in))
-        Sys_Error("MOD_LoadBmodel: funny lump size in %s", loadmodel->name);
-    count = l->filelen / sizeof(*in);
-    out = Hunk_AllocName(count * sizeof(*out), loadname);
-
-    loadmodel->texinfo = out;
-    loadmodel->numtexinfo = count;
-
-    for (i = 0; i < count; i++, in++, out++) {
+    for (i = 0; i < job->count; i++, in++, out++) {
         for (j = 0; j < 8; j++)
             out->vecs[0][j] = LittleFloat(in->vecs[0][j]);
         len1 = Length(out->vecs[0]);
@@ -640,8 +1030,10 @@ void Mod_LoadTexinfo(lump_t* l) {
             out->texture = r_notexture_mip; // checkerboard texture
             out->flags = 0;
         } else {
-            if (miptex >= loadmodel->numtextures)
-                Sys_Error("miptex >= loadmodel->numtextures");
+            if (miptex >= loadmodel->numtextures) {
+                job->error = "miptex >= loadmodel->numtextures";
+                return;
+            }
             out->texture = loadmodel->textures[miptex];
             if (!out->texture) {
                 out->texture = r_notexture_mip; // texture not found
@@ -651,14 +1043,38 @@ void Mod_LoadTexinfo(lump_t* l) {
     }
 }
 
+/*
+=================
+Mod_LoadTexinfo
+=================
+*/
+void Mod_LoadTexinfo(lump_t* l) {
+    texinfo_t* in;
+    mtexinfo_t* out;
+    i32 count;
+
+    in = (void*) (mod_base + l->fileofs);
+    if (l->filelen % sizeof(*in))
+        Sys_Error("MOD_LoadBmodel: funny lump size in %s", loadmodel->name);
+    count = l->filelen / sizeof(*in);
+    out = Hunk_AllocName(count * sizeof(*out), loadname);
+
+    loadmodel->texinfo = out;
+    loadmodel->numtexinfo = count;
+
+    Mod_QueueLump(LUMP_TEXINFO, Mod_ConvertTexinfo, in, sizeof(*in), out,
+                  sizeof(*out), count);
+}
+
 /*
 ================
 CalcSurfaceExtents
 
 Fills in s->texturemins[] and s->extents[]
+Returns false if the extents are too large for a lightmapped surface
 ================
 */
-void CalcSurfaceExtents(msurface_t* s) {
+static qboolean CalcSurfaceExtents(msurface_t* s) {
     float mins[2], maxs[2], val;
     i32 i, j, e;
     mvertex_t* v;
@@ -695,32 +1111,18 @@ void CalcSurfaceExtents(msurface_t* s) {
         s->texturemins[i] = bmins[i] * 16;
         s->extents[i] = (bmaxs[i] - bmins[i]) * 16;
         if (!(tex->flags & TEX_SPECIAL) && s->extents[i] > 256)
-            Sys_Error("Bad surface extents");
+            return false;
     }
+    return true;
 }
 
-
-/*
-=================
-Mod_LoadFaces
-=================
-*/
-void Mod_LoadFaces(lump_t* l) {
-    dface_t* in;
-    msurface_t* out;
-    i32 i, count, surfnum;
+static void Mod_ConvertFaces(lumpjob_t* job) {
+    dface_t* in = job->in;
+    msurface_t* out = job->out;
+    i32 i, surfnum;
     i32 planenum, side;
 
-    in = (void*) (mod_base + l->fileofs);
-    if (l->filelen % sizeof(*in))
-        Sys_Error("MOD_LoadBmodel: funny lump size in %s", loadmodel->name);
-    count = l->filelen / sizeof(*in);
-    out = Hunk_AllocName(count * sizeof(*out), loadname);
-
-    loadmodel->surfaces = out;
-    loadmodel->numsurfaces = count;
-
-    for (surfnum = 0; surfnum < count; surfnum++, in++, out++) {
+    for (surfnum = 0; surfnum < job->count; surfnum++, in++, out++) {
         out->firstedge = LittleLong(in->firstedge);
         out->numedges = LittleShort(in->numedges);
         out->flags = 0;
@@ -734,7 +1136,10 @@ void Mod_LoadFaces(lump_t* l) {
 
         out->texinfo = loadmodel->texinfo + LittleShort(in->texinfo);
 
-        CalcSurfaceExtents(out);
+        if (!CalcSurfaceExtents(out)) {
+            job->error = "Bad surface extents";
+            return;
+        }
 
         // lighting info
 
@@ -766,6 +1171,28 @@ void Mod_LoadFaces(lump_t* l) {
     }
 }
 
+/*
+=================
+Mod_LoadFaces
+
+Only allocates the surfaces, they are filled in by the second pass
+=================
+*/
+void Mod_LoadFaces(lump_t* l) {
+    dface_t* in;
+    msurface_t* out;
+    i32 count;
+
+    in = (void*) (mod_base + l->fileofs);
+    if (l->filelen % sizeof(*in))
+        Sys_Error("MOD_LoadBmodel: funny lump size in %s", loadmodel->name);
+    count = l->filelen / sizeof(*in);
+    out = Hunk_AllocName(count * sizeof(*out), loadname);
+
+    loadmodel->surfaces = out;
+    loadmodel->numsurfaces = count;
+}
+
 
 /*
 =================
@@ -780,26 +1207,16 @@ void Mod_SetParent(mnode_t* node, mnode_t* parent) {
     Mod_SetParent(node->children[1], node);
 }
 
-/*
-=================
-Mod_LoadNodes
-=================
-*/
-void Mod_LoadNodes(lump_t* l) {
-    i32 i, j, count, p;
-    dnode_t* in;
-    mnode_t* out;
+static void Mod_SetParents(lumpjob_t* job) {
+    Mod_SetParent(job->out, NULL); // sets nodes and leafs
+}
 
-    in = (void*) (mod_base + l->fileofs);
-    if (l->filelen % sizeof(*in))
-        Sys_Error("MOD_LoadBmodel: funny lump size in %s", loadmodel->name);
-    count = l->filelen / sizeof(*in);
-    out = Hunk_AllocName(count * sizeof(*out), loadname);
+static void Mod_ConvertNodes(lumpjob_t* job) {
+    dnode_t* in = job->in;
+    mnode_t* out = job->out;
+    i32 i, j, p;
 
-    loadmodel->nodes = out;
-    loadmodel->numnodes = count;
-
-    for (i = 0; i < count; i++, in++, out++) {
+    for (i = 0; i < job->count; i++, in++, out++) {
         for (j = 0; j < 3; j++) {
             out->minmaxs[j] = LittleShort(in->mins[j]);
             out->minmaxs[3 + j] = LittleShort(in->maxs[j]);
@@ -819,19 +1236,17 @@ void Mod_LoadNodes(lump_t* l) {
                 out->children[j] = (mnode_t*) (loadmodel->leafs + (-1 - p));
         }
     }
-
-    Mod_SetParent(loadmodel->nodes, NULL); // sets nodes and leafs
 }
 
 /*
 =================
-Mod_LoadLeafs
+Mod_LoadNodes
 =================
 */
-void Mod_LoadLeafs(lump_t* l) {
-    dleaf_t* in;
-    mleaf_t* out;
-    i32 i, j, count, p;
+void Mod_LoadNodes(lump_t* l) {
+    i32 count;
+    dnode_t* in;
+    mnode_t* out;
 
     in = (void*) (mod_base + l->fileofs);
     if (l->filelen % sizeof(*in))
@@ -839,10 +1254,19 @@ void Mod_LoadLeafs(lump_t* l) {
     count = l->filelen / sizeof(*in);
     out = Hunk_AllocName(count * sizeof(*out), loadname);
 
-    loadmodel->leafs = out;
-    loadmodel->numleafs = count;
+    loadmodel->nodes = out;
+    loadmodel->numnodes = count;
 
-    for (i = 0; i < count; i++, in++, out++) {
+    Mod_QueueLump(LUMP_NODES, Mod_ConvertNodes, in, sizeof(*in), out,
+                  sizeof(*out), count);
+}
+
+static void Mod_ConvertLeafs(lumpjob_t* job) {
+    dleaf_t* in = job->in;
+    mleaf_t* out = job->out;
+    i32 i, j, p;
+
+    for (i = 0; i < job->count; i++, in++, out++) {
         for (j = 0; j < 3; j++) {
             out->minmaxs[j] = LittleShort(in->mins[j]);
             out->minmaxs[3 + j] = LittleShort(in->maxs[j]);
@@ -867,6 +1291,40 @@ void Mod_LoadLeafs(lump_t* l) {
     }
 }
 
+/*
+=================
+Mod_LoadLeafs
+=================
+*/
+void Mod_LoadLeafs(lump_t* l) {
+    dleaf_t* in;
+    mleaf_t* out;
+    i32 count;
+
+    in = (void*) (mod_base + l->fileofs);
+    if (l->filelen % sizeof(*in))
+        Sys_Error("MOD_LoadBmodel: funny lump size in %s", loadmodel->name);
+    count = l->filelen / sizeof(*in);
+    out = Hunk_AllocName(count * sizeof(*out), loadname);
+
+    loadmodel->leafs = out;
+    loadmodel->numleafs = count;
+
+    Mod_QueueLump(LUMP_LEAFS, Mod_ConvertLeafs, in, sizeof(*in), out,
+                  sizeof(*out), count);
+}
+
+static void Mod_ConvertClipnodes(lumpjob_t* job) {
+    dclipnode_t* in = job->in;
+    dclipnode_t* out = job->out;
+
+    for (i32 i = 0; i < job->count; i++, out++, in++) {
+        out->planenum = LittleLong(in->planenum);
+        out->children[0] = LittleShort(in->children[0]);
+        out->children[1] = LittleShort(in->children[1]);
+    }
+}
+
 /*
 =================
 Mod_LoadClipnodes
@@ -874,7 +1332,7 @@ Mod_LoadClipnodes
 */
 void Mod_LoadClipnodes(lump_t* l) {
     dclipnode_t *in, *out;
-    i32 i, count;
+    i32 count;
     hull_t* hull;
 
     in = (void*) (mod_base + l->fileofs);
@@ -910,10 +1368,24 @@ void Mod_LoadClipnodes(lump_t* l) {
     hull->clip_maxs[1] = 32;
     hull->clip_maxs[2] = 64;
 
-    for (i = 0; i < count; i++, out++, in++) {
-        out->planenum = LittleLong(in->planenum);
-        out->children[0] = LittleShort(in->children[0]);
-        out->children[1] = LittleShort(in->children[1]);
+    Mod_QueueLump(LUMP_CLIPNODES, Mod_ConvertClipnodes, in, sizeof(*in), out,
+                  sizeof(*out), count);
+}
+
+static void Mod_ConvertHull0(lumpjob_t* job) {
+    mnode_t *in = job->in, *child;
+    dclipnode_t* out = job->out;
+    i32 i, j;
+
+    for (i = 0; i < job->count; i++, out++, in++) {
+        out->planenum = in->plane - loadmodel->planes;
+        for (j = 0; j < 2; j++) {
+            child = in->children[j];
+            if (child->contents < 0)
+                out->children[j] = child->contents;
+            else
+                out->children[j] = child - loadmodel->nodes;
+        }
     }
 }
 
@@ -925,14 +1397,12 @@ Deplicate the drawing hull structure as a clipping hull
 =================
 */
 void Mod_MakeHull0(void) {
-    mnode_t *in, *child;
     dclipnode_t* out;
-    i32 i, j, count;
+    i32 count;
     hull_t* hull;
 
     hull = &loadmodel->hulls[0];
 
-    in = loadmodel->nodes;
     count = loadmodel->numnodes;
     out = Hunk_AllocName(count * sizeof(*out), loadname);
 
@@ -940,16 +1410,20 @@ void Mod_MakeHull0(void) {
     hull->firstclipnode = 0;
     hull->lastclipnode = count - 1;
     hull->planes = loadmodel->planes;
+}
 
-    for (i = 0; i < count; i++, out++, in++) {
-        out->planenum = in->plane - loadmodel->planes;
-        for (j = 0; j < 2; j++) {
-            child = in->children[j];
-            if (child->contents < 0)
-                out->children[j] = child->contents;
-            else
-                out->children[j] = child - loadmodel->nodes;
+static void Mod_ConvertMarksurfaces(lumpjob_t* job) {
+    i16* in = job->in;
+    msurface_t** out = job->out;
+    i32 i, j;
+
+    for (i = 0; i < job->count; i++) {
+        j = LittleShort(in[i]);
+        if (j >= loadmodel->numsurfaces) {
+            job->error = "Mod_ParseMarksurfaces: bad surface number";
+            return;
         }
+        out[i] = loadmodel->surfaces + j;
     }
 }
 
@@ -959,7 +1433,7 @@ Mod_LoadMarksurfaces
 =================
 */
 void Mod_LoadMarksurfaces(lump_t* l) {
-    i32 i, j, count;
+    i32 count;
     i16* in;
     msurface_t** out;
 
@@ -972,12 +1446,16 @@ void Mod_LoadMarksurfaces(lump_t* l) {
     loadmodel->marksurfaces = out;
     loadmodel->nummarksurfaces = count;
 
-    for (i = 0; i < count; i++) {
-        j = LittleShort(in[i]);
-        if (j >= loadmodel->numsurfaces)
-            Sys_Error("Mod_ParseMarksurfaces: bad surface number");
-        out[i] = loadmodel->surfaces + j;
-    }
+    Mod_QueueLump(LUMP_MARKSURFACES, Mod_ConvertMarksurfaces, in, sizeof(*in),
+                  out, sizeof(*out), count);
+}
+
+static void Mod_ConvertSurfedges(lumpjob_t* job) {
+    i32* in = job->in;
+    i32* out = job->out;
+
+    for (i32 i = 0; i < job->count; i++)
+        out[i] = LittleLong(in[i]);
 }
 
 /*
@@ -986,7 +1464,7 @@ Mod_LoadSurfedges
 =================
 */
 void Mod_LoadSurfedges(lump_t* l) {
-    i32 i, count;
+    i32 count;
     i32 *in, *out;
 
     in = (void*) (mod_base + l->fileofs);
@@ -998,8 +1476,28 @@ void Mod_LoadSurfedges(lump_t* l) {
     loadmodel->surfedges = out;
     loadmodel->numsurfedges = count;
 
-    for (i = 0; i < count; i++)
-        out[i] = LittleLong(in[i]);
+    Mod_QueueLump(LUMP_SURFEDGES, Mod_ConvertSurfedges, in, sizeof(*in), out,
+                  sizeof(*out), count);
+}
+
+static void Mod_ConvertPlanes(lumpjob_t* job) {
+    dplane_t* in = job->in;
+    mplane_t* out = job->out;
+    i32 i, j;
+    i32 bits;
+
+    for (i = 0; i < job->count; i++, in++, out++) {
+        bits = 0;
+        for (j = 0; j < 3; j++) {
+            out->normal[j] = LittleFloat(in->normal[j]);
+            if (out->normal[j] < 0)
+                bits |= 1 << j;
+        }
+
+        out->dist = LittleFloat(in->dist);
+        out->type = LittleLong(in->type);
+        out->signbits = bits;
+    }
 }
 
 /*
@@ -1008,11 +1506,9 @@ Mod_LoadPlanes
 =================
 */
 void Mod_LoadPlanes(lump_t* l) {
-    i32 i, j;
     mplane_t* out;
     dplane_t* in;
     i32 count;
-    i32 bits;
 
     in = (void*) (mod_base + l->fileofs);
     if (l->filelen % sizeof(*in))
@@ -1023,18 +1519,8 @@ void Mod_LoadPlanes(lump_t* l) {
     loadmodel->planes = out;
     loadmodel->numplanes = count;
 
-    for (i = 0; i < count; i++, in++, out++) {
-        bits = 0;
-        for (j = 0; j < 3; j++) {
-            out->normal[j] = LittleFloat(in->normal[j]);
-            if (out->normal[j] < 0)
-                bits |= 1 << j;
-        }
-
-        out->dist = LittleFloat(in->dist);
-        out->type = LittleLong(in->type);
-        out->signbits = bits;
-    }
+    Mod_QueueLump(LUMP_PLANES, Mod_ConvertPlanes, in, sizeof(*in), out,
+                  sizeof(*out), count);
 }
 
 /*
@@ -1060,9 +1546,13 @@ Mod_LoadBrushModel
 =================
 */
 void Mod_LoadBrushModel(model_t* mod, void* buffer) {
-    i32 i, j;
+    i32 i;
     dheader_t* header;
-    dmodel_t* bm;
+    lump_t* l;
+    double start;
+    byte* base;
+    i32 mark, filelen;
+    u16 crc;
 
     loadmodel->type = mod_brush;
 
@@ -1074,6 +1564,21 @@ void Mod_LoadBrushModel(model_t* mod, void* buffer) {
             "Mod_LoadBrushModel: %s has wrong version number (%i should be %i)",
             mod->name, i, BSPVERSION);
 
+    base = NULL;
+    mark = filelen = 0;
+    crc = 0;
+    if (mod_diskcache.value) {
+        filelen = com_filesize;
+        crc = CRC_Block(buffer, filelen);
+        if (Mod_LoadBrushCache(mod, crc, filelen)) {
+            Mod_SetupSubmodels(mod);
+            return;
+        }
+        // everything from here on is the image Mod_SaveBrushCache writes
+        base = Hunk_AllocName(0, loadname);
+        mark = Hunk_LowMark();
+    }
+
     // swap all the lumps
     mod_base = (byte*) header;
 
@@ -1085,7 +1590,9 @@ void Mod_LoadBrushModel(model_t* mod, void* buffer) {
     Mod_LoadVertexes(&header->lumps[LUMP_VERTEXES]);
     Mod_LoadEdges(&header->lumps[LUMP_EDGES]);
     Mod_LoadSurfedges(&header->lumps[LUMP_SURFEDGES]);
+    start = Sys_FloatTime();
     Mod_LoadTextures(&header->lumps[LUMP_TEXTURES]);
+    mod_lumptime[LUMP_TEXTURES] += Sys_FloatTime() - start;
     Mod_LoadLighting(&header->lumps[LUMP_LIGHTING]);
     Mod_LoadPlanes(&header->lumps[LUMP_PLANES]);
     Mod_LoadTexinfo(&header->lumps[LUMP_TEXINFO]);
@@ -1097,15 +1604,43 @@ void Mod_LoadBrushModel(model_t* mod, void* buffer) {
     Mod_LoadClipnodes(&header->lumps[LUMP_CLIPNODES]);
     Mod_LoadEntities(&header->lumps[LUMP_ENTITIES]);
     Mod_LoadSubmodels(&header->lumps[LUMP_MODELS]);
-
     Mod_MakeHull0();
+    Mod_RunLumpJobs();
+
+    // second pass, everything the faces and hull 0 refer to is converted
+    l = &header->lumps[LUMP_FACES];
+    Mod_QueueLump(LUMP_FACES, Mod_ConvertFaces, mod_base + l->fileofs,
+                  sizeof(dface_t), loadmodel->surfaces, sizeof(msurface_t),
+                  loadmodel->numsurfaces);
+    Mod_QueueLump(LUMP_HULL0, Mod_ConvertHull0, loadmodel->nodes,
+                  sizeof(mnode_t), loadmodel->hulls[0].clipnodes,
+                  sizeof(dclipnode_t), loadmodel->numnodes);
+    if (loadmodel->numnodes)
+        Mod_QueueLump(LUMP_NODES, Mod_SetParents, NULL, 0, loadmodel->nodes,
+                      0, 1);
+    Mod_RunLumpJobs();
+    mod_lumploads++;
 
     mod->numframes = 2; // regular and alternate animation
     mod->flags = 0;
 
-    //
-    // set up the submodels (FIXME: this is confusing)
-    //
+    if (base)
+        Mod_SaveBrushCache(mod, crc, filelen, base, Hunk_LowMark() - mark);
+
+    Mod_SetupSubmodels(mod);
+}
+
+/*
+=================
+Mod_SetupSubmodels
+
+Set up the submodels (FIXME: this is confusing)
+=================
+*/
+static void Mod_SetupSubmodels(model_t* mod) {
+    i32 i, j;
+    dmodel_t* bm;
+
     for (i = 0; i < mod->numsubmodels; i++) {
         bm = &mod->submodels[i];
 
@@ -1144,6 +1679,40 @@ ALIAS MODELS
 ==============================================================================
 */
 
+/*
+=================
+Mod_AliasError
+
+Gives up on the decode, which may be running on a job thread, so the main
+thread can raise the error once it commits the model
+=================
+*/
+static void Mod_AliasError(aliasbuild_t* build, const char* error) {
+    build->error = error;
+    longjmp(build->abort, 1);
+}
+
+/*
+=================
+Mod_AliasAlloc
+
+Returns 0 filled memory, like Hunk_AllocName
+=================
+*/
+static void* Mod_AliasAlloc(aliasbuild_t* build, i32 size) {
+    void* buf;
+
+    size = (size + 3) & ~3;
+    if (build->used + size > build->size)
+        Mod_AliasError(build, "Mod_AliasAlloc: overflow");
+
+    buf = build->base + build->used;
+    build->used += size;
+    Q_memset(buf, 0, size);
+
+    return buf;
+}
+
 /*
 =================
 Mod_LoadAliasFrame
@@ -1151,7 +1720,7 @@ Mod_LoadAliasFrame
 */
 void* Mod_LoadAliasFrame(void* pin, i32* pframeindex, i32 numv,
                          trivertx_t* pbboxmin, trivertx_t* pbboxmax,
-                         aliashdr_t* pheader, char* name) {
+                         aliasbuild_t* build, char* name) {
     trivertx_t *pframe, *pinframe;
     i32 i, j;
     daliasframe_t* pdaliasframe;
@@ -1168,9 +1737,9 @@ void* Mod_LoadAliasFrame(void* pin, i32* pframeindex, i32 numv,
     }
 
     pinframe = (trivertx_t*) (pdaliasframe + 1);
-    pframe = Hunk_AllocName(numv * sizeof(*pframe), loadname);
+    pframe = Mod_AliasAlloc(build, numv * sizeof(*pframe));
 
-    *pframeindex = (byte*) pframe - (byte*) pheader;
+    *pframeindex = (byte*) pframe - build->base;
 
     for (j = 0; j < numv; j++) {
         i32 k;
@@ -1196,7 +1765,7 @@ Mod_LoadAliasGroup
 */
 void* Mod_LoadAliasGroup(void* pin, i32* pframeindex, i32 numv,
                          trivertx_t* pbboxmin, trivertx_t* pbboxmax,
-                         aliashdr_t* pheader, char* name) {
+                         aliasbuild_t* build, char* name) {
     daliasgroup_t* pingroup;
     maliasgroup_t* paliasgroup;
     i32 i, numframes;
@@ -1209,9 +1778,8 @@ void* Mod_LoadAliasGroup(void* pin, i32* pframeindex, i32 numv,
     numframes = LittleLong(pingroup->numframes);
 
     paliasgroup =
-        Hunk_AllocName(sizeof(maliasgroup_t) +
-                           (numframes - 1) * sizeof(paliasgroup->frames[0]),
-                       loadname);
+        Mod_AliasAlloc(build, sizeof(maliasgroup_t) +
+                                  (numframes - 1) * sizeof(paliasgroup->frames[0]));
 
     paliasgroup->numframes = numframes;
 
@@ -1221,18 +1789,18 @@ void* Mod_LoadAliasGroup(void* pin, i32* pframeindex, i32 numv,
         pbboxmax->v[i] = pingroup->bboxmax.v[i];
     }
 
-    *pframeindex = (byte*) paliasgroup - (byte*) pheader;
+    *pframeindex = (byte*) paliasgroup - build->base;
 
     pin_intervals = (daliasinterval_t*) (pingroup + 1);
 
-    poutintervals = Hunk_AllocName(numframes * sizeof(float), loadname);
+    poutintervals = Mod_AliasAlloc(build, numframes * sizeof(float));
 
-    paliasgroup->intervals = (byte*) poutintervals - (byte*) pheader;
+    paliasgroup->intervals = (byte*) poutintervals - build->base;
 
     for (i = 0; i < numframes; i++) {
         *poutintervals = LittleFloat(pin_intervals->interval);
         if (*poutintervals <= 0.0)
-            Sys_Error("Mod_LoadAliasGroup: interval<=0");
+            Mod_AliasError(build, "Mod_LoadAliasGroup: interval<=0");
 
         poutintervals++;
         pin_intervals++;
@@ -1244,7 +1812,7 @@ void* Mod_LoadAliasGroup(void* pin, i32* pframeindex, i32 numv,
         ptemp =
             Mod_LoadAliasFrame(ptemp, &paliasgroup->frames[i].frame, numv,
                                &paliasgroup->frames[i].bboxmin,
-                               &paliasgroup->frames[i].bboxmax, pheader, name);
+                               &paliasgroup->frames[i].bboxmax, build, name);
     }
 
     return ptemp;
@@ -1257,14 +1825,12 @@ Mod_LoadAliasSkin
 =================
 */
 void* Mod_LoadAliasSkin(void* pin, i32* pskinindex, i32 skinsize,
-                        aliashdr_t* pheader) {
-    i32 i;
+                        aliasbuild_t* build) {
     byte *pskin, *pinskin;
-    u16* pusskin;
 
-    pskin = Hunk_AllocName(skinsize, loadname);
+    pskin = Mod_AliasAlloc(build, skinsize);
     pinskin = (byte*) pin;
-    *pskinindex = (byte*) pskin - (byte*) pheader;
+    *pskinindex = (byte*) pskin - build->base;
 
     Q_memcpy(pskin, pinskin, skinsize);
 
@@ -1280,7 +1846,7 @@ Mod_LoadAliasSkinGroup
 =================
 */
 void* Mod_LoadAliasSkinGroup(void* pin, i32* pskinindex, i32 skinsize,
-                             aliashdr_t* pheader) {
+                             aliasbuild_t* build) {
     daliasskingroup_t* pinskingroup;
     maliasskingroup_t* paliasskingroup;
     i32 i, numskins;
@@ -1292,25 +1858,24 @@ void* Mod_LoadAliasSkinGroup(void* pin, i32* pskinindex, i32 skinsize,
 
     numskins = LittleLong(pinskingroup->numskins);
 
-    paliasskingroup = Hunk_AllocName(
-        sizeof(maliasskingroup_t) +
-            (numskins - 1) * sizeof(paliasskingroup->skindescs[0]),
-        loadname);
+    paliasskingroup = Mod_AliasAlloc(
+        build, sizeof(maliasskingroup_t) +
+                   (numskins - 1) * sizeof(paliasskingroup->skindescs[0]));
 
     paliasskingroup->numskins = numskins;
 
-    *pskinindex = (byte*) paliasskingroup - (byte*) pheader;
+    *pskinindex = (byte*) paliasskingroup - build->base;
 
     pinskinintervals = (daliasskininterval_t*) (pinskingroup + 1);
 
-    poutskinintervals = Hunk_AllocName(numskins * sizeof(float), loadname);
+    poutskinintervals = Mod_AliasAlloc(build, numskins * sizeof(float));
 
-    paliasskingroup->intervals = (byte*) poutskinintervals - (byte*) pheader;
+    paliasskingroup->intervals = (byte*) poutskinintervals - build->base;
 
     for (i = 0; i < numskins; i++) {
         *poutskinintervals = LittleFloat(pinskinintervals->interval);
         if (*poutskinintervals <= 0)
-            Sys_Error("Mod_LoadAliasSkinGroup: interval<=0");
+            Mod_AliasError(build, "Mod_LoadAliasSkinGroup: interval<=0");
 
         poutskinintervals++;
         pinskinintervals++;
@@ -1320,7 +1885,7 @@ void* Mod_LoadAliasSkinGroup(void* pin, i32* pskinindex, i32 skinsize,
 
     for (i = 0; i < numskins; i++) {
         ptemp = Mod_LoadAliasSkin(ptemp, &paliasskingroup->skindescs[i].skin,
-                                  skinsize, pheader);
+                                  skinsize, build);
     }
 
     return ptemp;
@@ -1329,32 +1894,103 @@ void* Mod_LoadAliasSkinGroup(void* pin, i32* pskinindex, i32 skinsize,
 
 /*
 =================
-Mod_LoadAliasModel
+Mod_CheckAliasHeader
+
+Validates everything the decoder relies on, so that errors are raised
+on the main thread
 =================
 */
-void Mod_LoadAliasModel(model_t* mod, void* buffer) {
+static void Mod_CheckAliasHeader(model_t* mod, mdl_t* pinmodel) {
+    i32 version;
+
+    version = LittleLong(pinmodel->version);
+    if (version != ALIAS_VERSION)
+        Sys_Error("%s has wrong version number (%i should be %i)", mod->name,
+                  version, ALIAS_VERSION);
+
+    if (LittleLong(pinmodel->skinheight) > MAX_LBM_HEIGHT)
+        Sys_Error("model %s has a skin taller than %d", mod->name,
+                  MAX_LBM_HEIGHT);
+
+    if (LittleLong(pinmodel->numverts) <= 0)
+        Sys_Error("model %s has no vertices", mod->name);
+
+    if (LittleLong(pinmodel->numverts) > MAXALIASVERTS)
+        Sys_Error("model %s has too many vertices", mod->name);
+
+    if (LittleLong(pinmodel->numtris) <= 0)
+        Sys_Error("model %s has no triangles", mod->name);
+
+    if (LittleLong(pinmodel->skinwidth) & 0x03)
+        Sys_Error("Mod_LoadAliasModel: skinwidth not multiple of 4");
+
+    if (LittleLong(pinmodel->numskins) < 1)
+        Sys_Error("Mod_LoadAliasModel: Invalid # of skins: %d\n",
+                  LittleLong(pinmodel->numskins));
+
+    if (LittleLong(pinmodel->numframes) < 1)
+        Sys_Error("Mod_LoadAliasModel: Invalid # of frames: %d\n",
+                  LittleLong(pinmodel->numframes));
+}
+
+/*
+=================
+Mod_InitAliasJob
+
+Sizes the decoding block. Every allocation made by the decoder is no larger
+than the file data it was converted from plus 3 bytes of padding, which in
+turn is never smaller than 4 bytes.
+=================
+*/
+static void Mod_InitAliasJob(aliasjob_t* job, model_t* mod, byte* file,
+                             i32 filelen) {
+    mdl_t* pinmodel;
+    i32 numframes;
+
+    pinmodel = (mdl_t*) file;
+    Mod_CheckAliasHeader(mod, pinmodel);
+
+    numframes = LittleLong(pinmodel->numframes);
+
+    job->mod = mod;
+    job->file = file;
+    job->build.size = sizeof(aliashdr_t) +
+                      numframes * sizeof(maliasframedesc_t) + sizeof(mdl_t) +
+                      2 * filelen;
+    job->build.base = Q_malloc(job->build.size);
+    job->build.used = 0;
+    job->build.error = NULL;
+    if (!job->build.base)
+        Sys_Error("Mod_LoadAliasModel: out of memory for %s", mod->name);
+}
+
+/*
+=================
+Mod_DecodeAliasModel
+
+Only touches the job, so it is safe to run on a job thread
+=================
+*/
+static void Mod_DecodeAliasModel(void* data) {
+    aliasjob_t* job = data;
+    aliasbuild_t* build = &job->build;
     i32 i;
     mdl_t *pmodel, *pinmodel;
     stvert_t *pstverts, *pinstverts;
     aliashdr_t* pheader;
     mtriangle_t* ptri;
     dtriangle_t* pintriangles;
-    i32 version, numframes, numskins;
+    i32 numframes, numskins;
     i32 size;
     daliasframetype_t* pframetype;
     daliasskintype_t* pskintype;
     maliasskindesc_t* pskindesc;
     i32 skinsize;
-    i32 start, end, total;
-
-    start = Hunk_LowMark();
 
-    pinmodel = (mdl_t*) buffer;
+    if (setjmp(build->abort))
+        return; // Mod_CommitAliasModel raises build->error
 
-    version = LittleLong(pinmodel->version);
-    if (version != ALIAS_VERSION)
-        Sys_Error("%s has wrong version number (%i should be %i)", mod->name,
-                  version, ALIAS_VERSION);
+    pinmodel = (mdl_t*) job->file;
 
     //
     // allocate space for a working header, plus all the data except the frames,
@@ -1365,13 +2001,12 @@ void Mod_LoadAliasModel(model_t* mod, void* buffer) {
            sizeof(mdl_t) + LittleLong(pinmodel->numverts) * sizeof(stvert_t) +
            LittleLong(pinmodel->numtris) * sizeof(mtriangle_t);
 
-    pheader = Hunk_AllocName(size, loadname);
+    pheader = Mod_AliasAlloc(build, size);
     pmodel =
         (mdl_t*) ((byte*) &pheader[1] + (LittleLong(pinmodel->numframes) - 1) *
                                             sizeof(pheader->frames[0]));
 
-    //	mod->cache.data = pheader;
-    mod->flags = LittleLong(pinmodel->flags);
+    job->flags = LittleLong(pinmodel->flags);
 
     //
     // endian-adjust and copy the data, starting with the alias model header
@@ -1380,28 +2015,12 @@ void Mod_LoadAliasModel(model_t* mod, void* buffer) {
     pmodel->numskins = LittleLong(pinmodel->numskins);
     pmodel->skinwidth = LittleLong(pinmodel->skinwidth);
     pmodel->skinheight = LittleLong(pinmodel->skinheight);
-
-    if (pmodel->skinheight > MAX_LBM_HEIGHT)
-        Sys_Error("model %s has a skin taller than %d", mod->name,
-                  MAX_LBM_HEIGHT);
-
     pmodel->numverts = LittleLong(pinmodel->numverts);
-
-    if (pmodel->numverts <= 0)
-        Sys_Error("model %s has no vertices", mod->name);
-
-    if (pmodel->numverts > MAXALIASVERTS)
-        Sys_Error("model %s has too many vertices", mod->name);
-
     pmodel->numtris = LittleLong(pinmodel->numtris);
-
-    if (pmodel->numtris <= 0)
-        Sys_Error("model %s has no triangles", mod->name);
-
     pmodel->numframes = LittleLong(pinmodel->numframes);
     pmodel->size = LittleFloat(pinmodel->size) * ALIAS_BASE_SIZE_RATIO;
-    mod->synctype = LittleLong(pinmodel->synctype);
-    mod->numframes = pmodel->numframes;
+    job->synctype = LittleLong(pinmodel->synctype);
+    job->numframes = pmodel->numframes;
 
     for (i = 0; i < 3; i++) {
         pmodel->scale[i] = LittleFloat(pinmodel->scale[i]);
@@ -1412,9 +2031,6 @@ void Mod_LoadAliasModel(model_t* mod, void* buffer) {
     numskins = pmodel->numskins;
     numframes = pmodel->numframes;
 
-    if (pmodel->skinwidth & 0x03)
-        Sys_Error("Mod_LoadAliasModel: skinwidth not multiple of 4");
-
     pheader->model = (byte*) pmodel - (byte*) pheader;
 
     //
@@ -1422,12 +2038,9 @@ void Mod_LoadAliasModel(model_t* mod, void* buffer) {
     //
     skinsize = pmodel->skinheight * pmodel->skinwidth;
 
-    if (numskins < 1)
-        Sys_Error("Mod_LoadAliasModel: Invalid # of skins: %d\n", numskins);
-
     pskintype = (daliasskintype_t*) &pinmodel[1];
 
-    pskindesc = Hunk_AllocName(numskins * sizeof(maliasskindesc_t), loadname);
+    pskindesc = Mod_AliasAlloc(build, numskins * sizeof(maliasskindesc_t));
 
     pheader->skindesc = (byte*) pskindesc - (byte*) pheader;
 
@@ -1439,10 +2052,10 @@ void Mod_LoadAliasModel(model_t* mod, void* buffer) {
 
         if (skintype == ALIAS_SKIN_SINGLE) {
             pskintype = (daliasskintype_t*) Mod_LoadAliasSkin(
-                pskintype + 1, &pskindesc[i].skin, skinsize, pheader);
+                pskintype + 1, &pskindesc[i].skin, skinsize, build);
         } else {
             pskintype = (daliasskintype_t*) Mod_LoadAliasSkinGroup(
-                pskintype + 1, &pskindesc[i].skin, skinsize, pheader);
+                pskintype + 1, &pskindesc[i].skin, skinsize, build);
         }
     }
 
@@ -1482,9 +2095,6 @@ void Mod_LoadAliasModel(model_t* mod, void* buffer) {
     //
     // load the frames
     //
-    if (numframes < 1)
-        Sys_Error("Mod_LoadAliasModel: Invalid # of frames: %d\n", numframes);
-
     pframetype = (daliasframetype_t*) &pintriangles[pmodel->numtris];
 
     for (i = 0; i < numframes; i++) {
@@ -1497,14 +2107,58 @@ void Mod_LoadAliasModel(model_t* mod, void* buffer) {
             pframetype = (daliasframetype_t*) Mod_LoadAliasFrame(
                 pframetype + 1, &pheader->frames[i].frame, pmodel->numverts,
                 &pheader->frames[i].bboxmin, &pheader->frames[i].bboxmax,
-                pheader, pheader->frames[i].name);
+                build, pheader->frames[i].name);
         } else {
             pframetype = (daliasframetype_t*) Mod_LoadAliasGroup(
                 pframetype + 1, &pheader->frames[i].frame, pmodel->numverts,
                 &pheader->frames[i].bboxmin, &pheader->frames[i].bboxmax,
-                pheader, pheader->frames[i].name);
+                build, pheader->frames[i].name);
         }
     }
+}
+
+/*
+=================
+Mod_CommitAliasModel
+
+Moves the complete, relocatable alias model to the cache
+=================
+*/
+static void Mod_CommitAliasModel(aliasjob_t* job) {
+    model_t* mod = job->mod;
+
+    if (job->build.error)
+        Sys_Error("%s in %s", job->build.error, mod->name);
+
+    mod->flags = job->flags;
+    mod->synctype = job->synctype;
+    mod->numframes = job->numframes;
+
+    COM_FileBase(mod->name, loadname, 32);
+    Cache_Alloc(&mod->cache, job->build.used, loadname);
+    if (mod->cache.data)
+        Q_memcpy(mod->cache.data, job->build.base, job->build.used);
+
+    if (job->tocache)
+        Mod_SaveAliasCache(mod, job->crc, job->filelen, job->build.base,
+                           job->build.used);
+
+    Q_free(job->build.base);
+    Q_free(job->file);
+    Q_free(job);
+}
+
+/*
+=================
+Mod_LoadAliasModel
+=================
+*/
+void Mod_LoadAliasModel(model_t* mod, void* buffer) {
+    aliasjob_t* job;
+    byte* cached;
+    i32 size;
+
+    job = Q_calloc(1, sizeof(*job));
 
     mod->type = mod_alias;
 
@@ -1512,18 +2166,100 @@ void Mod_LoadAliasModel(model_t* mod, void* buffer) {
     mod->mins[0] = mod->mins[1] = mod->mins[2] = -16;
     mod->maxs[0] = mod->maxs[1] = mod->maxs[2] = 16;
 
-    //
-    // move the complete, relocatable alias model to the cache
-    //
-    end = Hunk_LowMark();
-    total = end - start;
+    if (mod_diskcache.value) {
+        job->filelen = com_filesize;
+        job->crc = CRC_Block(buffer, com_filesize);
+        cached = Mod_LoadAliasCache(mod, job->crc, job->filelen, &size);
+        if (cached) {
+            job->mod = mod;
+            job->build.base = cached;
+            job->build.size = job->build.used = size;
+            job->flags = mod->flags;
+            job->synctype = mod->synctype;
+            job->numframes = mod->numframes;
+            if (mod_precache_jobs) {
+                // keep the cache order, Mod_EndPrecaching commits it
+                job->file = buffer;
+                mod_pending[mod_numpending++] = job;
+            } else {
+                Mod_CommitAliasModel(job);
+            }
+            return;
+        }
+        job->tocache = true;
+    }
 
-    Cache_Alloc(&mod->cache, total, loadname);
-    if (!mod->cache.data)
+    Mod_InitAliasJob(job, mod, buffer, com_filesize);
+
+    if (mod_precache_jobs) {
+        // decode in the background, Mod_EndPrecaching fills the cache
+        mod_pending[mod_numpending++] = job;
+        Jobs_Submit(mod_precache_jobs, Mod_DecodeAliasModel, job);
+        return;
+    }
+
+    Mod_DecodeAliasModel(job);
+    job->file = NULL; // owned by the caller
+    Mod_CommitAliasModel(job);
+}
+
+static qboolean Mod_IsPending(model_t* mod) {
+    for (i32 i = 0; i < mod_numpending; i++) {
+        if (mod_pending[i]->mod == mod)
+            return true;
+    }
+    return false;
+}
+
+/*
+=================
+Mod_DiscardPending
+
+Throws away decodes left over from an aborted precache
+=================
+*/
+static void Mod_DiscardPending(void) {
+    if (!mod_numpending)
+        return;
+
+    Jobs_Wait(mod_precache_jobs);
+    for (i32 i = 0; i < mod_numpending; i++) {
+        Q_free(mod_pending[i]->build.base);
+        Q_free(mod_pending[i]->file);
+        Q_free(mod_pending[i]);
+    }
+    mod_numpending = 0;
+}
+
+/*
+=================
+Mod_BeginPrecaching
+
+Alias models loaded until Mod_EndPrecaching are decoded on the job threads
+=================
+*/
+void Mod_BeginPrecaching(jobgroup_t* jobs) {
+    Mod_DiscardPending();
+    mod_precache_jobs = jobs;
+}
+
+/*
+=================
+Mod_EndPrecaching
+
+Waits for the queued decodes and caches them in the order they were loaded,
+so the cache layout does not depend on how the threads were scheduled
+=================
+*/
+void Mod_EndPrecaching(void) {
+    if (!mod_precache_jobs)
         return;
-    Q_memcpy(mod->cache.data, pheader, total);
 
-    Hunk_FreeToLowMark(start);
+    Jobs_Wait(mod_precache_jobs);
+    for (i32 i = 0; i < mod_numpending; i++)
+        Mod_CommitAliasModel(mod_pending[i]);
+    mod_numpending = 0;
+    mod_precache_jobs = NULL;
 }
 
 //=============================================================================
@@ -31,7 +31,8 @@
 
 #define NET_NAMELEN 64
 
-#define NET_MAXMESSAGE   8192
+// Room for an extended reliable message and datagram queued together.
+#define NET_MAXMESSAGE   (MAX_MSGLEN_EXT + MAX_DATAGRAM_EXT + 1024)
 #define NET_HEADERSIZE   (2 * sizeof(u32))
 #define NET_DATAGRAMSIZE (MAX_DATAGRAM + NET_HEADERSIZE)
 
@@ -42,6 +43,7 @@
 #define NETFLAG_NAK         0x00040000
 #define NETFLAG_EOM         0x00080000
 #define NETFLAG_UNRELIABLE  0x00100000
+#define NETFLAG_FRAGMENT    0x00200000
 #define NETFLAG_CTL         0x80000000
 
 
@@ -59,6 +61,8 @@
 // CCREQ_CONNECT
 //		string	game_name				"QUAKE"
 //		byte	net_protocol_version	NET_PROTOCOL_VERSION
+//		long	extensions				optional, NET_EXT_* wanted by the client
+//		long	cookie					optional, from CCREP_CHALLENGE
 //
 // CCREQ_SERVER_INFO
 //		string	game_name				"QUAKE"
@@ -74,10 +78,14 @@
 //
 // CCREP_ACCEPT
 //		long	port
+//		long	extensions			optional, NET_EXT_* granted by the server
 //
 // CCREP_REJECT
 //		string	reason
 //
+// CCREP_CHALLENGE
+//		long	cookie				send CCREQ_CONNECT again with this
+//
 // CCREP_SERVER_INFO
 //		string	server_address
 //		string	host_name
@@ -99,6 +107,11 @@
 //		string	value
 
 //	note:
+//		Stock peers ignore the trailing extensions field, and a missing one
+//		reads as no extensions, so both sides fall back to the original
+//		protocol unless each of them asked for the same extension.
+//		Only clients that set NET_EXT_CHALLENGE are sent CCREP_CHALLENGE.
+//
 //		There are two address forms used above.  The short form is just a
 //		port number.  The address that goes along with the port is defined as
 //		"whatever address you receive this reponse from".  This lets us use
@@ -118,6 +131,12 @@
 #define CCREP_SERVER_INFO 0x83
 #define CCREP_PLAYER_INFO 0x84
 #define CCREP_RULE_INFO   0x85
+#define CCREP_CHALLENGE   0x86
+
+// Protocol extensions negotiated at connect time.
+#define NET_EXT_RELIABLEWINDOW 0x00000001 // sliding window with selective acks
+#define NET_EXT_BIGMESSAGES    0x00000002 // MAX_MSGLEN_EXT and MAX_DATAGRAM_EXT
+#define NET_EXT_CHALLENGE      0x00000004 // client answers CCREP_CHALLENGE
 
 typedef struct qsocket_s qsocket_t;
 
@@ -216,6 +235,15 @@ i32 NET_SendUnreliableMessage(qsocket_t* sock, sizebuf_t* data);
 i32 NET_SendToAll(sizebuf_t* data, i32 blocktime);
 // This is a reliable *blocking* send to all attached clients.
 
+void NET_BeginBatch(void);
+void NET_FlushBatch(void);
+// Packets written between these calls are held back and sent together
+// when the batch is flushed.
+
+qboolean NET_Sleep(double seconds);
+// Blocks until a packet arrives or the timeout expires. Returns false if
+// data is pending that only the next frame can consume.
+
 
 void NET_Close(qsocket_t* sock);
 // if a dead connection is returned by a get or send function, this function
@@ -228,10 +256,21 @@ void NET_Close(qsocket_t* sock);
 
 void NET_Poll(void);
 
+void NET_ReclaimMessage(void);
+// net_message may be a view into the loopback buffers after NET_GetMessage.
+// Points it back at its own storage; done by every call that fills it.
+
 const char* NET_GetSocketAddr(const qsocket_t* sock);
 
 double NET_GetSocketConnectTime(const qsocket_t* sock);
 
+i32 NET_GetMaxMessage(const qsocket_t* sock);
+i32 NET_GetMaxDatagram(const qsocket_t* sock);
+// largest reliable and unreliable message the peer can take
+
+double NET_GetRTT(const qsocket_t* sock);
+// smoothed round trip time of reliable messages, 0 until one is acked
+
 
 extern qboolean serialAvailable;
 extern qboolean ipxAvailable;
@@ -252,5 +291,6 @@ extern qboolean slistSilent;
 extern qboolean slistLocal;
 
 void NET_Slist_f(void);
+void NET_SlistMaster_f(void);
 
 #endif
@@ -31,6 +31,8 @@
 #include "server.h"
 #include "sys.h"
 #include <SDL_net.h>
+#include <stdlib.h>
+#include <time.h>
 
 // This enables a simple IP banning mechanism
 // #define BAN_TEST
@@ -152,6 +154,344 @@ void NET_Ban_f(void) {
 #endif
 
 
+/*
+================================================================================
+
+SLIDING WINDOW
+
+With NET_EXT_RELIABLEWINDOW a reliable message is cut into MAX_DATAGRAM
+fragments and up to NET_WINDOWSIZE of them are in flight at once. The
+receiver acks with the next sequence it expects, followed by a bitmask of
+the fragments past that point it already holds. Each fragment is resent
+when its own timer runs out, and the timeout follows the measured round
+trip time instead of the fixed second of the original protocol.
+
+================================================================================
+*/
+
+#define NET_MINRTO 0.1
+#define NET_MAXRTO 3.0
+
+static cvar_t net_reliablewindow = {"net_reliablewindow", "1"};
+static cvar_t net_bigmessages = {"net_bigmessages", "1"};
+
+static i32 NET_LocalExtensions(void) {
+    i32 extensions = 0;
+    if (net_reliablewindow.value) {
+        extensions |= NET_EXT_RELIABLEWINDOW;
+    }
+    if (net_bigmessages.value) {
+        extensions |= NET_EXT_BIGMESSAGES;
+    }
+    return extensions;
+}
+
+static qboolean IsWindowed(const qsocket_t* sock) {
+    return (sock->extensions & NET_EXT_RELIABLEWINDOW) != 0;
+}
+
+static qboolean IsInFlight(const qsocket_t* sock, const u32 sequence) {
+    return sequence - sock->ackSequence < sock->sendSequence - sock->ackSequence;
+}
+
+static i32 WriteFragment(qsocket_t* sock, const u32 sequence) {
+    sendfragment_t* frag = &sock->sendWindow[sequence % NET_WINDOWSIZE];
+    const u32 packetLen = NET_HEADERSIZE + frag->length;
+    const u32 eom = frag->eom ? NETFLAG_EOM : 0;
+
+    packetBuffer.length = BigLong(packetLen | (NETFLAG_DATA | eom));
+    packetBuffer.sequence = BigLong(sequence);
+    Q_memcpy(packetBuffer.data, sock->sendMessage + frag->offset, frag->length);
+
+    frag->sendTime = net_time;
+    sock->lastSendTime = net_time;
+    return UDP_Write(sock->socket, (byte*) &packetBuffer, packetLen, &sock->addr);
+}
+
+static i32 FillSendWindow(qsocket_t* sock) {
+    while (sock->sendOffset < sock->sendMessageLength
+           && sock->sendSequence - sock->ackSequence < NET_WINDOWSIZE) {
+        const u32 sequence = sock->sendSequence++;
+        sendfragment_t* frag = &sock->sendWindow[sequence % NET_WINDOWSIZE];
+        frag->offset = sock->sendOffset;
+        frag->length = sock->sendMessageLength - sock->sendOffset;
+        if (frag->length > MAX_DATAGRAM) {
+            frag->length = MAX_DATAGRAM;
+        }
+        frag->eom = frag->offset + frag->length == sock->sendMessageLength;
+        frag->acked = false;
+        frag->resent = false;
+        sock->sendOffset += frag->length;
+        sock->inFlight += frag->length;
+        if (WriteFragment(sock, sequence) == -1) {
+            return -1;
+        }
+        packetsSent++;
+    }
+    return 1;
+}
+
+static void ResendFragment(qsocket_t* sock, const u32 sequence) {
+    sock->sendWindow[sequence % NET_WINDOWSIZE].resent = true;
+    WriteFragment(sock, sequence);
+    sock->retransmits++;
+    packetsReSent++;
+}
+
+static void ResendExpired(qsocket_t* sock) {
+    qboolean expired = false;
+    for (u32 seq = sock->ackSequence; seq != sock->sendSequence; seq++) {
+        const sendfragment_t* frag = &sock->sendWindow[seq % NET_WINDOWSIZE];
+        if (!frag->acked && net_time - frag->sendTime > sock->rto) {
+            ResendFragment(sock, seq);
+            expired = true;
+        }
+    }
+    if (expired) {
+        // Back off until a fresh sample comes in.
+        sock->rto *= 2;
+        if (sock->rto > NET_MAXRTO) {
+            sock->rto = NET_MAXRTO;
+        }
+    }
+}
+
+static void UpdateRTT(qsocket_t* sock, const double rtt) {
+    if (sock->srtt == 0) {
+        sock->srtt = rtt;
+        sock->rttvar = rtt / 2;
+    } else {
+        const double err = rtt - sock->srtt;
+        sock->rttvar = 0.75 * sock->rttvar + 0.25 * (err < 0 ? -err : err);
+        sock->srtt = 0.875 * sock->srtt + 0.125 * rtt;
+    }
+    sock->rto = sock->srtt + 4 * sock->rttvar;
+    if (sock->rto < NET_MINRTO) {
+        sock->rto = NET_MINRTO;
+    } else if (sock->rto > NET_MAXRTO) {
+        sock->rto = NET_MAXRTO;
+    }
+}
+
+static void AckFragment(qsocket_t* sock, const u32 sequence) {
+    sendfragment_t* frag = &sock->sendWindow[sequence % NET_WINDOWSIZE];
+    if (frag->acked) {
+        return;
+    }
+    frag->acked = true;
+    sock->inFlight -= frag->length;
+    // A resent fragment can't tell which copy was acked (Karn).
+    if (!frag->resent) {
+        UpdateRTT(sock, net_time - frag->sendTime);
+    }
+}
+
+static void ProcessWindowAck(qsocket_t* sock, const u32 expected, const u32 mask) {
+    if (expected - sock->ackSequence > sock->sendSequence - sock->ackSequence) {
+        Con_DPrintf("Stale ACK received\n");
+        return;
+    }
+
+    const u32 oldAck = sock->ackSequence;
+    u32 highest = expected;
+    for (u32 seq = sock->ackSequence; seq != expected; seq++) {
+        AckFragment(sock, seq);
+    }
+    for (i32 i = 0; i < NET_WINDOWSIZE - 1; i++) {
+        const u32 seq = expected + 1 + i;
+        if ((mask & (1u << i)) && IsInFlight(sock, seq)) {
+            AckFragment(sock, seq);
+            highest = seq;
+        }
+    }
+    while (sock->ackSequence != sock->sendSequence
+           && sock->sendWindow[sock->ackSequence % NET_WINDOWSIZE].acked) {
+        sock->ackSequence++;
+    }
+
+    if (sock->ackSequence != oldAck) {
+        sock->dupAcks = 0;
+    } else if (mask && ++sock->dupAcks == 3) {
+        // Later fragments got through, so the holes are lost, not late.
+        for (u32 seq = sock->ackSequence; seq != highest; seq++) {
+            if (!sock->sendWindow[seq % NET_WINDOWSIZE].acked) {
+                ResendFragment(sock, seq);
+            }
+        }
+    }
+
+    if (sock->ackSequence == sock->sendSequence && sock->sendOffset == sock->sendMessageLength) {
+        sock->sendMessageLength = 0;
+        sock->sendOffset = 0;
+        sock->canSend = true;
+    }
+}
+
+static void SendWindowAck(qsocket_t* sock, const IPaddress* addr) {
+    u32 mask = 0;
+    for (i32 i = 1; i < NET_WINDOWSIZE; i++) {
+        if (sock->recvWindow[(sock->receiveSequence + i) % NET_WINDOWSIZE].present) {
+            mask |= 1u << (i - 1);
+        }
+    }
+    packetBuffer.length = BigLong((NET_HEADERSIZE + sizeof(u32)) | NETFLAG_ACK);
+    packetBuffer.sequence = BigLong(sock->receiveSequence);
+    *((u32*) packetBuffer.data) = BigLong(mask);
+    UDP_Write(sock->socket, (byte*) &packetBuffer, NET_HEADERSIZE + sizeof(u32), addr);
+}
+
+static i32 DeliverWindow(qsocket_t* sock) {
+    while (true) {
+        recvfragment_t* frag = &sock->recvWindow[sock->receiveSequence % NET_WINDOWSIZE];
+        if (!frag->present) {
+            return 0;
+        }
+        if (sock->receiveMessageLength + frag->length > NET_MAXMESSAGE) {
+            Con_Printf("Reliable message overflow\n");
+            return -1;
+        }
+        frag->present = false;
+        sock->receiveSequence++;
+
+        if (frag->eom) {
+            SZ_Clear(&net_message);
+            SZ_Write(&net_message, sock->receiveMessage, sock->receiveMessageLength);
+            SZ_Write(&net_message, frag->data, frag->length);
+            sock->receiveMessageLength = 0;
+            return 1;
+        }
+
+        Q_memcpy(sock->receiveMessage + sock->receiveMessageLength, frag->data, frag->length);
+        sock->receiveMessageLength += frag->length;
+    }
+}
+
+static i32 ProcessWindowData(
+    qsocket_t* sock,
+    const u32 sequence,
+    const u32 flags,
+    const i32 length,
+    const IPaddress* addr
+) {
+    if (sequence - sock->receiveSequence < NET_WINDOWSIZE) {
+        recvfragment_t* frag = &sock->recvWindow[sequence % NET_WINDOWSIZE];
+        if (frag->present) {
+            receivedDuplicateCount++;
+        } else {
+            frag->present = true;
+            frag->eom = (flags & NETFLAG_EOM) != 0;
+            frag->length = length;
+            Q_memcpy(frag->data, packetBuffer.data, length);
+        }
+    } else {
+        // Already delivered, or too far ahead to hold.
+        receivedDuplicateCount++;
+    }
+
+    // Deliver before acking, so the ack covers what was just consumed.
+    const i32 ret = DeliverWindow(sock);
+    if (ret != -1) {
+        SendWindowAck(sock, addr);
+    }
+    return ret;
+}
+
+//==============================================================================
+
+
+/*
+================================================================================
+
+UNRELIABLE FRAGMENTS
+
+With NET_EXT_BIGMESSAGES an unreliable message longer than MAX_DATAGRAM
+is split into NETFLAG_FRAGMENT packets sharing one sequence. Each starts
+with its index and the fragment count. A message missing any fragment is
+dropped like a lost datagram.
+
+================================================================================
+*/
+
+#define NET_FRAGMENTSIZE (MAX_DATAGRAM - 2)
+#define NET_MAXFRAGMENTS ((MAX_DATAGRAM_EXT + NET_FRAGMENTSIZE - 1) / NET_FRAGMENTSIZE)
+
+static i32 SendUnreliableFragments(qsocket_t* sock, const sizebuf_t* data) {
+    const i32 count = (data->cursize + NET_FRAGMENTSIZE - 1) / NET_FRAGMENTSIZE;
+    const u32 sequence = sock->unreliableSendSequence++;
+
+    for (i32 i = 0; i < count; i++) {
+        const i32 offset = i * NET_FRAGMENTSIZE;
+        i32 dataLen = data->cursize - offset;
+        if (dataLen > NET_FRAGMENTSIZE) {
+            dataLen = NET_FRAGMENTSIZE;
+        }
+        const i32 packetLen = NET_HEADERSIZE + 2 + dataLen;
+
+        packetBuffer.length = BigLong(packetLen | NETFLAG_UNRELIABLE | NETFLAG_FRAGMENT);
+        packetBuffer.sequence = BigLong(sequence);
+        packetBuffer.data[0] = i;
+        packetBuffer.data[1] = count;
+        Q_memcpy(packetBuffer.data + 2, data->data + offset, dataLen);
+
+        if (UDP_Write(sock->socket, (byte*) &packetBuffer, packetLen, &sock->addr) == -1) {
+            return -1;
+        }
+        packetsSent++;
+    }
+    return 1;
+}
+
+static qboolean ReassembleFragment(qsocket_t* sock, const u32 sequence, const i32 length) {
+    if (!(sock->extensions & NET_EXT_BIGMESSAGES)) {
+        // never negotiated, so nobody should be sending them
+        return false;
+    }
+    if (length < 2) {
+        shortPacketCount++;
+        return false;
+    }
+    const i32 index = packetBuffer.data[0];
+    const i32 count = packetBuffer.data[1];
+    const i32 dataLen = length - 2;
+    if (index >= count || count > NET_MAXFRAGMENTS || dataLen > NET_FRAGMENTSIZE) {
+        return false;
+    }
+    if (index < count - 1 && dataLen != NET_FRAGMENTSIZE) {
+        return false;
+    }
+    // the last fragment may claim more than MAX_DATAGRAM_EXT holds
+    if (index * NET_FRAGMENTSIZE + dataLen > MAX_DATAGRAM_EXT) {
+        return false;
+    }
+
+    if (!sock->fragmentMask || sequence != sock->fragmentSequence) {
+        // A newer message replaces whatever was left of the last one.
+        sock->fragmentSequence = sequence;
+        sock->fragmentMask = 0;
+        sock->fragmentCount = count;
+    }
+    if (count != sock->fragmentCount) {
+        return false;
+    }
+
+    Q_memcpy(sock->fragmentMessage + index * NET_FRAGMENTSIZE, packetBuffer.data + 2, dataLen);
+    if (index == count - 1) {
+        sock->fragmentLength = index * NET_FRAGMENTSIZE + dataLen;
+    }
+    sock->fragmentMask |= 1u << index;
+    if (sock->fragmentMask != (1u << count) - 1) {
+        return false;
+    }
+
+    sock->fragmentMask = 0;
+    SZ_Clear(&net_message);
+    SZ_Write(&net_message, sock->fragmentMessage, sock->fragmentLength);
+    return true;
+}
+
+//==============================================================================
+
+
 i32 Datagram_SendMessage(qsocket_t* sock, sizebuf_t* data) {
     u32 packetLen;
     u32 dataLen;
@@ -172,6 +512,12 @@ i32 Datagram_SendMessage(qsocket_t* sock, sizebuf_t* data) {
     Q_memcpy(sock->sendMessage, data->data, data->cursize);
     sock->sendMessageLength = data->cursize;
 
+    if (IsWindowed(sock)) {
+        sock->sendOffset = 0;
+        sock->canSend = false;
+        return FillSendWindow(sock);
+    }
+
     if (data->cursize <= MAX_DATAGRAM) {
         dataLen = data->cursize;
         eom = NETFLAG_EOM;
@@ -186,6 +532,7 @@ i32 Datagram_SendMessage(qsocket_t* sock, sizebuf_t* data) {
     Q_memcpy(packetBuffer.data, sock->sendMessage, dataLen);
 
     sock->canSend = false;
+    sock->resent = false;
 
     if (UDP_Write(sock->socket, (byte*) &packetBuffer, packetLen, &sock->addr) == -1) {
         return -1;
@@ -216,6 +563,7 @@ static i32 SendMessageNext(qsocket_t* sock) {
     Q_memcpy(packetBuffer.data, sock->sendMessage, dataLen);
 
     sock->sendNext = false;
+    sock->resent = false;
 
     if (UDP_Write(sock->socket, (byte*) &packetBuffer, packetLen, &sock->addr) == -1) {
         return -1;
@@ -246,6 +594,7 @@ static i32 ReSendMessage(qsocket_t* sock) {
     Q_memcpy(packetBuffer.data, sock->sendMessage, dataLen);
 
     sock->sendNext = false;
+    sock->resent = true;
 
     if (UDP_Write(sock->socket, (byte*) &packetBuffer, packetLen, &sock->addr) == -1) {
         return -1;
@@ -275,11 +624,15 @@ i32 Datagram_SendUnreliableMessage(qsocket_t* sock, sizebuf_t* data) {
     if (data->cursize == 0) {
         Sys_Error("Datagram_SendUnreliableMessage: zero length message\n");
     }
-    if (data->cursize > MAX_DATAGRAM) {
+    if (data->cursize > NET_GetMaxDatagram(sock)) {
         Sys_Error("Datagram_SendUnreliableMessage: message too big %u\n", data->cursize);
     }
 #endif
 
+    if (data->cursize > MAX_DATAGRAM) {
+        return SendUnreliableFragments(sock, data);
+    }
+
     const i32 packetLen = NET_HEADERSIZE + data->cursize;
 
     packetBuffer.length = BigLong(packetLen | NETFLAG_UNRELIABLE);
@@ -303,12 +656,21 @@ i32 Datagram_GetMessage(qsocket_t* sock) {
     u32 sequence;
     u32 count;
 
-    if (!sock->canSend && (net_time - sock->lastSendTime) > 1.0) {
+    if (IsWindowed(sock)) {
+        if (!sock->canSend) {
+            ResendExpired(sock);
+        }
+        // Fragments may be waiting behind the message delivered last time.
+        ret = DeliverWindow(sock);
+        if (ret != 0) {
+            return ret;
+        }
+    } else if (!sock->canSend && (net_time - sock->lastSendTime) > 1.0) {
         ReSendMessage(sock);
     }
 
     while (true) {
-        length = UDP_Read(sock->socket, (byte*) &packetBuffer, NET_DATAGRAMSIZE, &readaddr);
+        length = UDP_ReadQueued(sock->socket, (byte*) &packetBuffer, NET_DATAGRAMSIZE, &readaddr);
         if (length == 0) {
             break;
         }
@@ -346,6 +708,18 @@ i32 Datagram_GetMessage(qsocket_t* sock) {
                 ret = 0;
                 break;
             }
+
+            length -= NET_HEADERSIZE;
+
+            if (flags & NETFLAG_FRAGMENT) {
+                if (!ReassembleFragment(sock, sequence, length)) {
+                    continue;
+                }
+            } else {
+                SZ_Clear(&net_message);
+                SZ_Write(&net_message, packetBuffer.data, length);
+            }
+
             if (sequence != sock->unreliableReceiveSequence) {
                 count = sequence - sock->unreliableReceiveSequence;
                 droppedDatagrams += count;
@@ -353,16 +727,19 @@ i32 Datagram_GetMessage(qsocket_t* sock) {
             }
             sock->unreliableReceiveSequence = sequence + 1;
 
-            length -= NET_HEADERSIZE;
-
-            SZ_Clear(&net_message);
-            SZ_Write(&net_message, packetBuffer.data, length);
-
             ret = 2;
             break;
         }
 
         if (flags & NETFLAG_ACK) {
+            if (IsWindowed(sock)) {
+                u32 mask = 0;
+                if (length >= NET_HEADERSIZE + sizeof(u32)) {
+                    mask = BigLong(*((u32*) packetBuffer.data));
+                }
+                ProcessWindowAck(sock, sequence, mask);
+                continue;
+            }
             if (sequence != (sock->sendSequence - 1)) {
                 Con_DPrintf("Stale ACK received\n");
                 continue;
@@ -376,6 +753,9 @@ i32 Datagram_GetMessage(qsocket_t* sock) {
                 Con_DPrintf("Duplicate ACK received\n");
                 continue;
             }
+            if (!sock->resent) {
+                UpdateRTT(sock, net_time - sock->lastSendTime);
+            }
             sock->sendMessageLength -= MAX_DATAGRAM;
             if (sock->sendMessageLength > 0) {
                 Q_memcpy(sock->sendMessage, sock->sendMessage + MAX_DATAGRAM, sock->sendMessageLength);
@@ -387,6 +767,19 @@ i32 Datagram_GetMessage(qsocket_t* sock) {
             continue;
         }
 
+        if ((flags & NETFLAG_DATA) && IsWindowed(sock)) {
+            length -= NET_HEADERSIZE;
+            if (length > MAX_DATAGRAM) {
+                shortPacketCount++;
+                continue;
+            }
+            ret = ProcessWindowData(sock, sequence, flags, length, &readaddr);
+            if (ret != 0) {
+                break;
+            }
+            continue;
+        }
+
         if (flags & NETFLAG_DATA) {
             packetBuffer.length = BigLong(NET_HEADERSIZE | NETFLAG_ACK);
             packetBuffer.sequence = BigLong(sequence);
@@ -414,7 +807,9 @@ i32 Datagram_GetMessage(qsocket_t* sock) {
         }
     }
 
-    if (sock->sendNext) {
+    if (IsWindowed(sock)) {
+        FillSendWindow(sock);
+    } else if (sock->sendNext) {
         SendMessageNext(sock);
     }
 
@@ -422,6 +817,168 @@ i32 Datagram_GetMessage(qsocket_t* sock) {
 }
 
 
+/*
+================================================================================
+
+FLOOD PROTECTION
+
+Control packets arrive on the accept socket from anyone, with a source
+address that may be forged. Each source address gets a token bucket, and
+a global bucket bounds the total, since a spoofed flood spreads over more
+sources than the table holds. Packets over budget are dropped unanswered.
+
+Clients that can answer a challenge get a cookie derived from their
+address and the time instead of a connection. Nothing is allocated until
+the request comes back carrying it, which a forged source never sees.
+
+================================================================================
+*/
+
+#define NET_RATEBUCKETS    256
+#define NET_RATEPROBES     4
+#define NET_COOKIEPERIOD   10.0
+#define NET_MAXCTLPACKETS  64 // read per call of Datagram_CheckNewConnections
+
+typedef struct {
+    u32 host;
+    double time;
+    double tokens;
+} ratebucket_t;
+
+static cvar_t net_ctlrate = {"net_ctlrate", "5"};
+static cvar_t net_ctlburst = {"net_ctlburst", "10"};
+static cvar_t net_ctlglobalrate = {"net_ctlglobalrate", "200"};
+static cvar_t net_connectcookie = {"net_connectcookie", "1"};
+
+static ratebucket_t ratebuckets[NET_RATEBUCKETS];
+static ratebucket_t globalbucket;
+static u32 cookieSecret;
+
+// Statistic Counters
+static i32 ctlPacketsReceived = 0;
+static i32 ctlSourceDrops = 0;
+static i32 ctlGlobalDrops = 0;
+static i32 challengesSent = 0;
+static i32 cookiesAccepted = 0;
+static i32 stockConnectsRejected = 0;
+
+static qboolean NET_TakeToken(ratebucket_t* bucket, double rate, double burst) {
+    bucket->tokens += (net_time - bucket->time) * rate;
+    if (bucket->tokens > burst) {
+        bucket->tokens = burst;
+    }
+    bucket->time = net_time;
+    if (bucket->tokens < 1) {
+        return false;
+    }
+    bucket->tokens -= 1;
+    return true;
+}
+
+static ratebucket_t* NET_FindRateBucket(const u32 host) {
+    const u32 start = (host * 2654435761u) >> 24;
+    ratebucket_t* oldest = NULL;
+
+    for (u32 i = 0; i < NET_RATEPROBES; i++) {
+        ratebucket_t* bucket = &ratebuckets[(start + i) % NET_RATEBUCKETS];
+        if (bucket->host == host && bucket->time > 0) {
+            return bucket;
+        }
+        if (!oldest || bucket->time < oldest->time) {
+            oldest = bucket;
+        }
+    }
+    // Evict the least recently seen source, the newcomer starts full.
+    oldest->host = host;
+    oldest->time = net_time;
+    oldest->tokens = net_ctlburst.value;
+    return oldest;
+}
+
+static qboolean NET_AllowControlPacket(const IPaddress* addr) {
+    ctlPacketsReceived++;
+    if (net_ctlrate.value <= 0) {
+        return true;
+    }
+    ratebucket_t* bucket = NET_FindRateBucket(addr->host);
+    if (!NET_TakeToken(bucket, net_ctlrate.value, net_ctlburst.value)) {
+        ctlSourceDrops++;
+        return false;
+    }
+    const double globalrate = net_ctlglobalrate.value;
+    if (globalrate > 0 && !NET_TakeToken(&globalbucket, globalrate, globalrate)) {
+        ctlGlobalDrops++;
+        return false;
+    }
+    return true;
+}
+
+static i32 NET_MakeCookie(const IPaddress* addr, const i32 period) {
+    u32 h = cookieSecret ^ (u32) period * 0x9e3779b9u;
+    h = (h ^ addr->host) * 0x85ebca6bu;
+    h = (h ^ addr->port ^ (h >> 13)) * 0xc2b2ae35u;
+    h ^= h >> 16;
+    return (i32) (h | 1); // never 0, which means no cookie
+}
+
+static void NET_REP_Challenge(
+    UDPsocket acceptsock,
+    const IPaddress* addr,
+    const i32 cookie
+) {
+    SZ_Clear(&net_message);
+
+    // save space for the header, filled in later
+    MSG_WriteLong(&net_message, 0);
+    MSG_WriteByte(&net_message, CCREP_CHALLENGE);
+    MSG_WriteLong(&net_message, cookie);
+    *((i32*) net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
+
+    UDP_Write(acceptsock, net_message.data, net_message.cursize, addr);
+
+    SZ_Clear(&net_message);
+}
+
+static void NET_InitFloodProtection(void) {
+    Cvar_RegisterVariable(&net_ctlrate);
+    Cvar_RegisterVariable(&net_ctlburst);
+    Cvar_RegisterVariable(&net_ctlglobalrate);
+    Cvar_RegisterVariable(&net_connectcookie);
+    cookieSecret = (u32) SDL_GetPerformanceCounter() ^ (u32) time(NULL);
+}
+
+static void NET_PrintFloodStats(void) {
+    Con_Printf("control packets received   = %i\n", ctlPacketsReceived);
+    Con_Printf("dropped over source rate   = %i\n", ctlSourceDrops);
+    Con_Printf("dropped over global rate   = %i\n", ctlGlobalDrops);
+    Con_Printf("connect challenges sent    = %i\n", challengesSent);
+    Con_Printf("connect cookies accepted   = %i\n", cookiesAccepted);
+    Con_Printf("stock connects rejected    = %i\n", stockConnectsRejected);
+}
+
+//==============================================================================
+
+
+static void NET_PrintWindowStats(void) {
+    i32 inFlight = 0;
+    i32 retransmits = 0;
+    i32 count = 0;
+    double rtt = 0;
+    for (const qsocket_t* s = net_activeSockets; s; s = s->next) {
+        if (!IsWindowed(s)) {
+            continue;
+        }
+        inFlight += s->inFlight;
+        retransmits += s->retransmits;
+        rtt += s->srtt;
+        count++;
+    }
+    Con_Printf("windowed connections       = %i\n", count);
+    Con_Printf("reliable bytes in flight   = %i\n", inFlight);
+    Con_Printf("window retransmits         = %i\n", retransmits);
+    Con_Printf("mean rtt                   = %.0f ms\n", count ? rtt / count * 1000 : 0);
+}
+
 static void NET_Stats_f(void) {
     if (Cmd_Argc() == 1) {
         Con_Printf("unreliable messages sent   = %i\n", unreliableMessagesSent);
@@ -434,6 +991,14 @@ static void NET_Stats_f(void) {
         Con_Printf("receivedDuplicateCount     = %i\n", receivedDuplicateCount);
         Con_Printf("shortPacketCount           = %i\n", shortPacketCount);
         Con_Printf("droppedDatagrams           = %i\n", droppedDatagrams);
+        NET_PrintWindowStats();
+        Con_Printf("receive pumps              = %i\n", udp_pumps);
+        Con_Printf("queued packets received    = %i\n", udp_queuedpackets);
+        Con_Printf("send batches               = %i\n", udp_sendbatches);
+        Con_Printf("batched packets sent       = %i\n", udp_batchedpackets);
+        Con_Printf("socket sleeps              = %i\n", udp_sleeps);
+        Con_Printf("packet wakeups             = %i\n", udp_wakeups);
+        NET_PrintFloodStats();
         return;
     }
     NET_PrintSocketStats(Cmd_Argv(1));
@@ -549,6 +1114,7 @@ JustDoIt:
 
     testInProgress = true;
     testPollCount = 20;
+    NET_ReclaimMessage();
 
     for (n = 0; n < max; n++) {
         SZ_Clear(&net_message);
@@ -671,6 +1237,7 @@ JustDoIt:
     }
 
     test2InProgress = true;
+    NET_ReclaimMessage();
 
     SZ_Clear(&net_message);
     // save space for the header, filled in later
@@ -684,9 +1251,126 @@ JustDoIt:
 }
 
 
+/*
+====================
+Flood_f
+
+net_flood <host> [count] [info|connect]
+Sends a burst of control requests from one socket and counts what comes
+back, to check net_ctlrate and the connect challenge from outside.
+====================
+*/
+static qboolean floodInProgress = false;
+static i32 floodPollCount;
+static UDPsocket floodSocket;
+static i32 floodSent;
+static i32 floodReplies;
+static i32 floodChallenges;
+static i32 floodAccepts;
+
+static void Flood_Poll(void);
+poll_procedure_t floodPollProcedure = {NULL, 0.0, &Flood_Poll};
+
+static void Flood_Poll(void) {
+    IPaddress clientaddr;
+
+    while (true) {
+        const i32 len = UDP_Read(floodSocket, net_message.data, net_message.maxsize, &clientaddr);
+        if (len < (i32) sizeof(i32)) {
+            break;
+        }
+        net_message.cursize = len;
+        MSG_BeginReading();
+        const i32 control = BigLong(*((i32*) net_message.data));
+        MSG_ReadLong();
+        if ((control & (~NETFLAG_LENGTH_MASK)) != NETFLAG_CTL) {
+            continue;
+        }
+        if ((control & NETFLAG_LENGTH_MASK) != len) {
+            continue;
+        }
+        floodReplies++;
+        const i32 command = MSG_ReadByte();
+        if (command == CCREP_CHALLENGE) {
+            floodChallenges++;
+        } else if (command == CCREP_ACCEPT) {
+            floodAccepts++;
+        }
+    }
+    SZ_Clear(&net_message);
+
+    floodPollCount--;
+    if (floodPollCount) {
+        NET_SchedulePollProcedure(&floodPollProcedure, 0.05);
+        return;
+    }
+    Con_Printf("sent %i, replies %i, challenges %i, accepts %i\n",
+               floodSent, floodReplies, floodChallenges, floodAccepts);
+    UDP_CloseSocket(floodSocket);
+    floodInProgress = false;
+}
+
+static void Flood_f(void) {
+    IPaddress sendaddr;
+
+    if (floodInProgress) {
+        return;
+    }
+    if (Cmd_Argc() < 2) {
+        Con_Printf("usage: net_flood <host> [count] [info|connect]\n");
+        return;
+    }
+    if (!UDP_IsInitialized()) {
+        return;
+    }
+    if (UDP_GetAddrFromName(Cmd_Argv(1), &sendaddr) == -1) {
+        Con_Printf("Could not resolve %s\n", Cmd_Argv(1));
+        return;
+    }
+    const i32 count = Cmd_Argc() > 2 ? Q_atoi(Cmd_Argv(2)) : 100;
+    const qboolean connect = Cmd_Argc() > 3 && !Q_strcmp(Cmd_Argv(3), "connect");
+
+    floodSocket = UDP_OpenSocket(0);
+    if (floodSocket == NULL) {
+        return;
+    }
+
+    floodInProgress = true;
+    floodPollCount = 20;
+    floodSent = floodReplies = floodChallenges = floodAccepts = 0;
+    NET_ReclaimMessage();
+
+    for (i32 n = 0; n < count; n++) {
+        SZ_Clear(&net_message);
+        // save space for the header, filled in later
+        MSG_WriteLong(&net_message, 0);
+        if (connect) {
+            // Without a cookie a protected server must answer with a
+            // challenge and allocate nothing.
+            MSG_WriteByte(&net_message, CCREQ_CONNECT);
+            MSG_WriteString(&net_message, "QUAKE");
+            MSG_WriteByte(&net_message, NET_PROTOCOL_VERSION);
+            MSG_WriteLong(&net_message, NET_EXT_CHALLENGE);
+        } else {
+            MSG_WriteByte(&net_message, CCREQ_SERVER_INFO);
+            MSG_WriteString(&net_message, "QUAKE");
+            MSG_WriteByte(&net_message, NET_PROTOCOL_VERSION);
+        }
+        *((i32*) net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
+        UDP_Write(floodSocket, net_message.data, net_message.cursize, &sendaddr);
+        floodSent++;
+    }
+    SZ_Clear(&net_message);
+    NET_SchedulePollProcedure(&floodPollProcedure, 0.05);
+}
+
+
 i32 Datagram_Init(void) {
     myDriverLevel = net_driverlevel;
     Cmd_AddCommand("net_stats", NET_Stats_f);
+    Cvar_RegisterVariable(&net_reliablewindow);
+    Cvar_RegisterVariable(&net_bigmessages);
+    NET_InitFloodProtection();
 
     if (COM_CheckParm("-nolan")) {
         return -1;
@@ -699,11 +1383,17 @@ i32 Datagram_Init(void) {
 #endif
     Cmd_AddCommand("test", Test_f);
     Cmd_AddCommand("test2", Test2_f);
+    Cmd_AddCommand("net_flood", Flood_f);
 
     return 0;
 }
 
 
+i32 Datagram_Extensions(void) {
+    return NET_LocalExtensions();
+}
+
+
 void Datagram_Shutdown(void) {
     UDP_Shutdown();
 }
@@ -792,9 +1482,9 @@ static void NET_REP_Reject(
 static void NET_REP_Accept(
     UDPsocket acceptsock,
     const IPaddress* addr,
-    UDPsocket newsock
+    const qsocket_t* sock
 ) {
-    IPaddress newaddr = UDP_GetSocketAddr(newsock);
+    IPaddress newaddr = UDP_GetSocketAddr(sock->socket);
 
     SZ_Clear(&net_message);
 
@@ -802,6 +1492,9 @@ static void NET_REP_Accept(
     MSG_WriteLong(&net_message, 0);
     MSG_WriteByte(&net_message, CCREP_ACCEPT);
     MSG_WriteLong(&net_message, UDP_GetSocketPort(&newaddr));
+    if (sock->extensions) {
+        MSG_WriteLong(&net_message, sock->extensions);
+    }
     // Write header.
     *((i32*) net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
 
@@ -812,7 +1505,8 @@ static void NET_REP_Accept(
 
 static qsocket_t* NET_TryConnectClient(
     UDPsocket acceptsock,
-    const IPaddress* addr
+    const IPaddress* addr,
+    const i32 extensions
 ) {
     // Allocate a QSocket.
     qsocket_t* sock = NET_NewQSocket();
@@ -833,9 +1527,11 @@ static qsocket_t* NET_TryConnectClient(
     sock->socket = newsock;
     sock->addr = *addr;
     Q_strcpy(sock->address, UDP_AddrToString(addr));
+    sock->extensions = extensions & NET_LocalExtensions();
+    UDP_EnableQueue(newsock);
 
     // Send him back the info about the server connection he has been allocated.
-    NET_REP_Accept(acceptsock, addr, newsock);
+    NET_REP_Accept(acceptsock, addr, sock);
 
     return sock;
 }
@@ -855,7 +1551,7 @@ static qboolean NET_IsAlreadyConnected(
         // Is this a duplicate connection request?
         if (net_time - s->connecttime < 2.0) {
             // Yes, so send a duplicate reply.
-            NET_REP_Accept(acceptsock, addr, s->socket);
+            NET_REP_Accept(acceptsock, addr, s);
             return true;
         }
         // It's somebody coming back in from a crash/disconnect,
@@ -866,6 +1562,44 @@ static qboolean NET_IsAlreadyConnected(
     return false;
 }
 
+/*
+====================
+NET_CheckConnectCookie
+
+False if the request must not get a connection yet. Challenge capable
+clients without a valid cookie are sent one; with net_connectcookie 2,
+stock clients are turned away.
+====================
+*/
+static qboolean NET_CheckConnectCookie(
+    UDPsocket acceptsock,
+    const IPaddress* addr,
+    const i32 extensions,
+    const i32 cookie
+) {
+    if (!net_connectcookie.value) {
+        return true;
+    }
+    if (!(extensions & NET_EXT_CHALLENGE)) {
+        if (net_connectcookie.value < 2) {
+            return true;
+        }
+        stockConnectsRejected++;
+        NET_REP_Reject(acceptsock, addr, "Server requires a newer client.\n");
+        return false;
+    }
+    // A cookie from the previous period is still good.
+    const i32 period = (i32) (net_time / NET_COOKIEPERIOD);
+    if (cookie && (cookie == NET_MakeCookie(addr, period) ||
+                   cookie == NET_MakeCookie(addr, period - 1))) {
+        cookiesAccepted++;
+        return true;
+    }
+    challengesSent++;
+    NET_REP_Challenge(acceptsock, addr, NET_MakeCookie(addr, period));
+    return false;
+}
+
 static qsocket_t* NET_REP_Connect(
     UDPsocket acceptsock,
     const IPaddress* addr
@@ -877,6 +1611,18 @@ static qsocket_t* NET_REP_Connect(
         NET_REP_Reject(acceptsock, addr, "Incompatible version.\n");
         return NULL;
     }
+    // Stock clients don't send extensions.
+    i32 extensions = MSG_ReadLong();
+    if (msg_badread) {
+        extensions = 0;
+    }
+    i32 cookie = MSG_ReadLong();
+    if (msg_badread) {
+        cookie = 0;
+    }
+    if (!NET_CheckConnectCookie(acceptsock, addr, extensions, cookie)) {
+        return NULL;
+    }
 #ifdef BAN_TEST
     // check for a ban
     if (NET_IsBanned(addr)) {
@@ -887,7 +1633,7 @@ static qsocket_t* NET_REP_Connect(
     if (NET_IsAlreadyConnected(acceptsock, addr)) {
         return NULL;
     }
-    return NET_TryConnectClient(acceptsock, addr);
+    return NET_TryConnectClient(acceptsock, addr, extensions);
 }
 
 static void NET_REP_RuleInfo(UDPsocket acceptsock, const IPaddress* addr) {
@@ -1009,24 +1755,36 @@ qsocket_t* Datagram_CheckNewConnections(void) {
         return NULL;
     }
 
-    SZ_Clear(&net_message);
+    // Keep reading past dropped and answered packets, so a flood can't
+    // hold back a real request for more than a frame, but only so many.
+    for (i32 i = 0; i < NET_MAXCTLPACKETS; i++) {
+        SZ_Clear(&net_message);
 
-    IPaddress clientaddr;
-    const i32 len = UDP_Read(acceptsock, net_message.data, net_message.maxsize, &clientaddr);
-    if (len < sizeof(i32)) {
-        return NULL;
-    }
-    net_message.cursize = len;
+        IPaddress clientaddr;
+        const i32 len = UDP_Read(acceptsock, net_message.data, net_message.maxsize, &clientaddr);
+        if (len <= 0) {
+            return NULL;
+        }
+        if (len < sizeof(i32) || !NET_AllowControlPacket(&clientaddr)) {
+            continue;
+        }
+        net_message.cursize = len;
 
-    MSG_BeginReading();
-    if (!NET_CheckControlHeader(len)) {
-        return NULL;
+        MSG_BeginReading();
+        if (!NET_CheckControlHeader(len)) {
+            continue;
+        }
+        qsocket_t* sock = NET_ControlResponse(acceptsock, &clientaddr);
+        if (sock) {
+            return sock;
+        }
     }
-    return NET_ControlResponse(acceptsock, &clientaddr);
+    return NULL;
 }
 
 
-static void NET_REQ_ServerInfo(void) {
+// Broadcasts the query if addr is NULL.
+static void NET_REQ_ServerInfo(const IPaddress* addr) {
     UDPsocket control_sock = UDP_GetControlSocket();
 
     SZ_Clear(&net_message);
@@ -1039,7 +1797,11 @@ static void NET_REQ_ServerInfo(void) {
     // Write header.
     *((i32*) net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
 
-    UDP_Broadcast(control_sock, net_message.data, net_message.cursize);
+    if (addr) {
+        UDP_Write(control_sock, net_message.data, net_message.cursize, addr);
+    } else {
+        UDP_Broadcast(control_sock, net_message.data, net_message.cursize);
+    }
 
     SZ_Clear(&net_message);
 }
@@ -1139,13 +1901,266 @@ void Datagram_SearchForHosts(qboolean xmit) {
         return;
     }
     if (xmit) {
-        NET_REQ_ServerInfo();
+        NET_REQ_ServerInfo(NULL);
     }
     NET_ReadServerInfo();
 }
 
 
-static void NET_REQ_Connect(UDPsocket sock, const IPaddress* addr) {
+/*
+================================================================================
+
+MASTER LIST
+
+Servers listed in a local file are all queried at once from the control
+socket, and the replies matched back by address as they come in. Each
+reply is kept with its round trip time, and is reused instead of asking
+again until it is older than the TTL.
+
+================================================================================
+*/
+
+#define MASTERCACHESIZE 64
+
+typedef struct {
+    char address[NET_NAMELEN]; // as written in the list
+    IPaddress addr;
+    char name[16];
+    char map[16];
+    i32 users;
+    i32 maxusers;
+    qboolean badprotocol;
+    qboolean queried; // asked in the current round, not served from cache
+    qboolean pending;
+    double queryTime; // first query of the current round
+    double replyTime; // 0 until a reply arrives
+    double rtt;
+} masterhost_t;
+
+static masterhost_t masterhosts[MASTERCACHESIZE];
+static i32 masterHostCount = 0;
+
+static masterhost_t* NET_FindMasterHost(const IPaddress* addr) {
+    for (i32 i = 0; i < masterHostCount; i++) {
+        if (UDP_AddrCompare(addr, &masterhosts[i].addr) == 0) {
+            return &masterhosts[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+====================
+Datagram_LoadMasterList
+
+Replaces the list with the addresses in the file, one per line. Hosts
+that were already listed keep their cached reply.
+Returns the number of hosts, -1 if the file can't be read.
+====================
+*/
+i32 Datagram_LoadMasterList(char* filename) {
+    static masterhost_t loaded[MASTERCACHESIZE];
+    i32 count = 0;
+
+    if (!UDP_IsInitialized()) {
+        return -1;
+    }
+    char* data = (char*) COM_LoadTempFile(filename);
+    if (!data) {
+        Con_Printf("Couldn't load %s\n", filename);
+        return -1;
+    }
+
+    while ((data = COM_Parse(data)) != NULL) {
+        if (count == MASTERCACHESIZE) {
+            Con_Printf("%s: only the first %i servers are used\n", filename,
+                       MASTERCACHESIZE);
+            break;
+        }
+        IPaddress addr;
+        if (UDP_GetAddrFromName(com_token, &addr) == -1) {
+            Con_Printf("Couldn't resolve %s\n", com_token);
+            continue;
+        }
+        masterhost_t* host = &loaded[count];
+        const masterhost_t* cached = NET_FindMasterHost(&addr);
+        if (cached) {
+            *host = *cached;
+        } else {
+            Q_memset(host, 0, sizeof(*host));
+            host->addr = addr;
+        }
+        Q_strncpy(host->address, com_token, NET_NAMELEN - 1);
+        host->address[NET_NAMELEN - 1] = 0;
+        count++;
+    }
+
+    Q_memcpy(masterhosts, loaded, count * sizeof(masterhost_t));
+    masterHostCount = count;
+    return count;
+}
+
+/*
+====================
+Datagram_QueryMasterHosts
+
+Sends a query to every host without a reply younger than ttl seconds.
+With retry, only the hosts still waiting are asked again, and their
+round trip keeps counting from the first query.
+Returns the number of queries sent.
+====================
+*/
+i32 Datagram_QueryMasterHosts(double ttl, qboolean retry) {
+    const double now = Sys_FloatTime();
+    i32 sent = 0;
+
+    for (i32 i = 0; i < masterHostCount; i++) {
+        masterhost_t* host = &masterhosts[i];
+        if (retry) {
+            if (!host->pending) {
+                continue;
+            }
+        } else {
+            host->queried = !host->replyTime || now - host->replyTime >= ttl;
+            if (!host->queried) {
+                continue;
+            }
+            host->pending = true;
+            host->queryTime = now;
+        }
+        NET_REQ_ServerInfo(&host->addr);
+        sent++;
+    }
+    return sent;
+}
+
+static void NET_ReadMasterReply(masterhost_t* host) {
+    MSG_ReadString(); // address as the server sees itself
+    Q_strncpy(host->name, MSG_ReadString(), sizeof(host->name) - 1);
+    Q_strncpy(host->map, MSG_ReadString(), sizeof(host->map) - 1);
+    host->users = MSG_ReadByte();
+    host->maxusers = MSG_ReadByte();
+    host->badprotocol = MSG_ReadByte() != NET_PROTOCOL_VERSION;
+    host->replyTime = Sys_FloatTime();
+    host->rtt = host->replyTime - host->queryTime;
+    host->pending = false;
+}
+
+/*
+====================
+Datagram_PollMasterHosts
+
+Reads the replies that have arrived.
+Returns the number of hosts still waiting for one.
+====================
+*/
+i32 Datagram_PollMasterHosts(void) {
+    UDPsocket control_sock = UDP_GetControlSocket();
+    IPaddress readaddr;
+    i32 ret;
+
+    while ((ret = UDP_Read(control_sock, net_message.data, net_message.maxsize, &readaddr)) > 0) {
+        if (ret < sizeof(i32)) {
+            continue;
+        }
+        net_message.cursize = ret;
+
+        MSG_BeginReading();
+        if (!NET_CheckControlHeader(ret)) {
+            continue;
+        }
+        if (MSG_ReadByte() != CCREP_SERVER_INFO) {
+            continue;
+        }
+        masterhost_t* host = NET_FindMasterHost(&readaddr);
+        if (host && host->pending) {
+            NET_ReadMasterReply(host);
+        }
+    }
+    SZ_Clear(&net_message);
+
+    i32 pending = 0;
+    for (i32 i = 0; i < masterHostCount; i++) {
+        if (masterhosts[i].pending) {
+            pending++;
+        }
+    }
+    return pending;
+}
+
+static i32 NET_CompareMasterHosts(const void* a, const void* b) {
+    const masterhost_t* ha = *(const masterhost_t**) a;
+    const masterhost_t* hb = *(const masterhost_t**) b;
+    if (!ha->replyTime || !hb->replyTime) {
+        return (ha->replyTime == 0) - (hb->replyTime == 0);
+    }
+    return (ha->rtt > hb->rtt) - (ha->rtt < hb->rtt);
+}
+
+// Servers speaking another protocol are marked with a '*', as in slist.
+static void NET_MasterHostName(const masterhost_t* host, char* name) {
+    if (host->badprotocol) {
+        name[0] = '*';
+        Q_strncpy(name + 1, host->name, 14);
+        name[15] = 0;
+        return;
+    }
+    Q_strcpy(name, host->name);
+}
+
+static void NET_CacheMasterHost(const masterhost_t* host) {
+    hostcache_t* cache = &hostcache[hostCacheCount++];
+
+    Q_memset(cache, 0, sizeof(*cache));
+    NET_MasterHostName(host, cache->name);
+    Q_strcpy(cache->map, host->map);
+    cache->users = host->users;
+    cache->maxusers = host->maxusers;
+    cache->driver = myDriverLevel;
+    cache->addr = host->addr;
+    Q_strncpy(cache->cname, host->address, sizeof(cache->cname) - 1);
+    NET_ResolveNameConflict(cache);
+}
+
+/*
+====================
+Datagram_PrintMasterHosts
+
+Lists the hosts fastest first, and puts the fastest ones in the host
+cache so connect and the menu can find them by name.
+====================
+*/
+void Datagram_PrintMasterHosts(void) {
+    masterhost_t* sorted[MASTERCACHESIZE];
+    char name[16];
+
+    for (i32 i = 0; i < masterHostCount; i++) {
+        sorted[i] = &masterhosts[i];
+    }
+    qsort(sorted, masterHostCount, sizeof(sorted[0]), NET_CompareMasterHosts);
+
+    Con_Printf("\nServer          Map             Users  Ping\n");
+    Con_Printf("--------------- --------------- ----- -----\n");
+    hostCacheCount = 0;
+    for (i32 i = 0; i < masterHostCount; i++) {
+        const masterhost_t* host = sorted[i];
+        if (!host->replyTime) {
+            Con_Printf("%-31.31s  no reply\n", host->address);
+            continue;
+        }
+        NET_MasterHostName(host, name);
+        Con_Printf("%-15.15s %-15.15s %2i/%2i %4.0f%s\n", name, host->map,
+                   host->users, host->maxusers, host->rtt * 1000,
+                   host->queried ? "" : " cached");
+        if (hostCacheCount < HOSTCACHESIZE) {
+            NET_CacheMasterHost(host);
+        }
+    }
+    Con_Printf("== end list ==\n\n");
+}
+
+
+static void NET_REQ_Connect(UDPsocket sock, const IPaddress* addr, i32 cookie) {
     SZ_Clear(&net_message);
 
     // save space for the header, filled in later
@@ -1153,6 +2168,8 @@ static void NET_REQ_Connect(UDPsocket sock, const IPaddress* addr) {
     MSG_WriteByte(&net_message, CCREQ_CONNECT);
     MSG_WriteString(&net_message, "QUAKE");
     MSG_WriteByte(&net_message, NET_PROTOCOL_VERSION);
+    MSG_WriteLong(&net_message, NET_LocalExtensions() | NET_EXT_CHALLENGE);
+    MSG_WriteLong(&net_message, cookie);
     // Write header.
     *((i32*) net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
 
@@ -1192,8 +2209,14 @@ static qsocket_t* NET_HandleConnectResponse(
             Con_Printf("Connection accepted\n");
             Q_memcpy(&sock->addr, sendaddr, sizeof(*sendaddr));
             UDP_SetSocketPort(&sock->addr, MSG_ReadLong());
+            // Stock servers don't answer with extensions.
+            sock->extensions = MSG_ReadLong() & NET_LocalExtensions();
+            if (msg_badread) {
+                sock->extensions = 0;
+            }
             UDP_GetNameFromAddr(sendaddr, sock->address);
             sock->lastMessageTime = SetNetTime();
+            UDP_EnableQueue(sock->socket);
             m_return_onerror = false;
             return sock;
         default:
@@ -1252,9 +2275,19 @@ static i32 NET_TryConnectServer(
     double start_time = net_time;
     i32 ret = 0;
 
+    i32 cookie = 0;
     for (i32 reps = 0; reps < 3; reps++) {
-        NET_REQ_Connect(newsock, sendaddr);
+        NET_REQ_Connect(newsock, sendaddr, cookie);
         ret = NET_WaitConnectResponse(start_time, newsock, readaddr, sendaddr);
+        if (ret > 0 && net_message.cursize > sizeof(i32) &&
+            net_message.data[sizeof(i32)] == CCREP_CHALLENGE) {
+            // Ask again with the cookie.
+            MSG_ReadByte();
+            cookie = MSG_ReadLong();
+            ret = 0;
+            start_time = SetNetTime();
+            continue;
+        }
         if (ret) {
             break;
         }
@@ -29,6 +29,10 @@
 i32 Datagram_Init(void);
 void Datagram_Listen(qboolean state);
 void Datagram_SearchForHosts(qboolean xmit);
+i32 Datagram_LoadMasterList(char* filename);
+i32 Datagram_QueryMasterHosts(double ttl, qboolean retry);
+i32 Datagram_PollMasterHosts(void);
+void Datagram_PrintMasterHosts(void);
 qsocket_t* Datagram_Connect(char* host);
 qsocket_t* Datagram_CheckNewConnections(void);
 i32 Datagram_GetMessage(qsocket_t* sock);
@@ -38,5 +42,6 @@ qboolean Datagram_CanSendMessage(qsocket_t* sock);
 qboolean Datagram_CanSendUnreliableMessage(qsocket_t* sock);
 void Datagram_Close(qsocket_t* sock);
 void Datagram_Shutdown(void);
+i32 Datagram_Extensions(void);
 
 #endif
@@ -21,6 +21,7 @@
 
 #include "net_dgrm.h"
 #include "net_loop.h"
+#include "net_sim.h"
 #include "net_udp.h"
 
 
@@ -41,6 +42,22 @@ net_driver_t net_drivers[MAX_NET_DRIVERS] = {
         Loop_Close,
         Loop_Shutdown
     },
+    {
+        "NetSim",
+        false,
+        NetSim_Init,
+        NetSim_Listen,
+        NetSim_SearchForHosts,
+        NetSim_Connect,
+        NetSim_CheckNewConnections,
+        Datagram_GetMessage,
+        Datagram_SendMessage,
+        Datagram_SendUnreliableMessage,
+        Datagram_CanSendMessage,
+        Datagram_CanSendUnreliableMessage,
+        NetSim_Close,
+        NetSim_Shutdown
+    },
     {
         "Datagram",
         false,
@@ -58,4 +75,4 @@ net_driver_t net_drivers[MAX_NET_DRIVERS] = {
         Datagram_Shutdown
     },
 };
-i32 net_numdrivers = 2;
+i32 net_numdrivers = 3;
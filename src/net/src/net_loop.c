@@ -22,7 +22,9 @@
 
 #include "net_loop.h"
 #include "client.h"
+#include "cmd.h"
 #include "console.h"
+#include "host.h"
 #include "net_socket.h"
 #include "server.h"
 #include "sys.h"
@@ -32,9 +34,40 @@ qboolean localconnectpending = false;
 qsocket_t* loop_client = NULL;
 qsocket_t* loop_server = NULL;
 
+#define LOOP_RINGSIZE     (4 * NET_MAXMESSAGE)
+#define LOOP_RELIABLEROOM (3 * NET_MAXMESSAGE)
+#define LOOP_WRAP         0xff
+
+typedef struct {
+    i32 head;
+    i32 tail;
+    i32 used; // including the held entry and skipped ends
+    i32 held; // size of the entry at head the reader is looking at
+    byte data[LOOP_RINGSIZE];
+} loopring_t;
+
+static loopring_t rings[2];
+
+static cvar_t net_loopcopy = {"net_loopcopy", "0"};
+
+// Statistic Counters
+static i32 loopMessages = 0;
+static i32 loopSendCopied = 0;
+static i32 loopReadCopied = 0;
+static i32 loopCompactCopied = 0;
+static i32 loopStartFrame = 0;
+
+
+static void Loop_ClearRing(loopring_t* ring);
+static loopring_t* Loop_GetRing(const qsocket_t* sock);
+static void Loop_Stats_f(void);
+
+
 i32 Loop_Init(void) {
     if (cls.state == ca_dedicated)
         return -1;
+    Cvar_RegisterVariable(&net_loopcopy);
+    Cmd_AddCommand("net_loopstats", Loop_Stats_f);
     return 0;
 }
 
@@ -77,8 +110,7 @@ qsocket_t* Loop_Connect(char* host) {
         }
         Q_strcpy(loop_client->address, "localhost");
     }
-    loop_client->receiveMessageLength = 0;
-    loop_client->sendMessageLength = 0;
+    Loop_ClearRing(&rings[0]);
     loop_client->canSend = true;
 
     if (!loop_server) {
@@ -88,13 +120,16 @@ qsocket_t* Loop_Connect(char* host) {
         }
         Q_strcpy(loop_server->address, "LOCAL");
     }
-    loop_server->receiveMessageLength = 0;
-    loop_server->sendMessageLength = 0;
+    Loop_ClearRing(&rings[1]);
     loop_server->canSend = true;
 
     loop_client->driverdata = (void*) loop_server;
     loop_server->driverdata = (void*) loop_client;
 
+    // Nothing goes over the wire, so the large limits always apply.
+    loop_client->extensions = NET_EXT_BIGMESSAGES;
+    loop_server->extensions = NET_EXT_BIGMESSAGES;
+
     return loop_client;
 }
 
@@ -104,40 +139,123 @@ qsocket_t* Loop_CheckNewConnections(void) {
         return NULL;
 
     localconnectpending = false;
-    loop_server->sendMessageLength = 0;
-    loop_server->receiveMessageLength = 0;
+    Loop_ClearRing(&rings[1]);
     loop_server->canSend = true;
-    loop_client->sendMessageLength = 0;
-    loop_client->receiveMessageLength = 0;
+    Loop_ClearRing(&rings[0]);
     loop_client->canSend = true;
     return loop_server;
 }
 
 
+/*
+================================================================================
+
+MESSAGE RINGS
+
+Each direction has a ring of [type, length lo, length hi, pad, data]
+entries. The sender copies a message in once. The reader gets net_message
+pointed straight at the entry, which stays reserved until the reader's
+next Loop_GetMessage. An entry never wraps; the tail of the ring is
+skipped with a LOOP_WRAP marker instead.
+
+Unreliable messages are refused once less than LOOP_RELIABLEROOM is
+free, which always leaves a contiguous run for the one reliable message
+that can be outstanding.
+
+================================================================================
+*/
+
 static i32 IntAlign(i32 value) {
     return (value + (sizeof(i32) - 1)) & (~(sizeof(i32) - 1));
 }
 
+static loopring_t* Loop_GetRing(const qsocket_t* sock) {
+    return sock == loop_client ? &rings[0] : &rings[1];
+}
 
-i32 Loop_GetMessage(qsocket_t* sock) {
-    i32 ret;
-    i32 length;
+static void Loop_ClearRing(loopring_t* ring) {
+    ring->head = 0;
+    ring->tail = 0;
+    ring->used = 0;
+    ring->held = 0;
+}
 
-    if (sock->receiveMessageLength == 0)
-        return 0;
+static void Loop_ReleaseHeld(loopring_t* ring) {
+    if (!ring->held) {
+        return;
+    }
+    ring->head += ring->held;
+    ring->used -= ring->held;
+    ring->held = 0;
+    if (ring->head == LOOP_RINGSIZE) {
+        ring->head = 0;
+    }
+}
+
+static byte* Loop_Reserve(loopring_t* ring, const i32 size) {
+    if (ring->used == 0) {
+        ring->head = 0;
+        ring->tail = 0;
+    }
+    if (ring->used > 0 && ring->tail <= ring->head) {
+        // Wrapped, the free space is between tail and head.
+        if (ring->head - ring->tail < size) {
+            return NULL;
+        }
+    } else if (LOOP_RINGSIZE - ring->tail < size) {
+        // Skip the end and start over at the front.
+        if (ring->head < size) {
+            return NULL;
+        }
+        ring->data[ring->tail] = LOOP_WRAP;
+        ring->used += LOOP_RINGSIZE - ring->tail;
+        ring->tail = 0;
+    }
+    byte* entry = ring->data + ring->tail;
+    ring->tail += size;
+    ring->used += size;
+    if (ring->tail == LOOP_RINGSIZE) {
+        ring->tail = 0;
+    }
+    return entry;
+}
+
+static void Loop_WriteEntry(byte* entry, const i32 type, const sizebuf_t* data) {
+    entry[0] = type;
+    entry[1] = data->cursize & 0xff;
+    entry[2] = data->cursize >> 8;
+    Q_memcpy(entry + 4, data->data, data->cursize);
+    loopSendCopied += data->cursize;
+}
 
-    ret = sock->receiveMessage[0];
-    length = sock->receiveMessage[1] + (sock->receiveMessage[2] << 8);
-    // alignment byte skipped here
-    SZ_Clear(&net_message);
-    SZ_Write(&net_message, &sock->receiveMessage[4], length);
 
-    length = IntAlign(length + 4);
-    sock->receiveMessageLength -= length;
+i32 Loop_GetMessage(qsocket_t* sock) {
+    loopring_t* ring = Loop_GetRing(sock);
 
-    if (sock->receiveMessageLength)
-        Q_memcpy(sock->receiveMessage, &sock->receiveMessage[length],
-                 sock->receiveMessageLength);
+    Loop_ReleaseHeld(ring);
+    if (ring->used == 0) {
+        return 0;
+    }
+    if (ring->data[ring->head] == LOOP_WRAP) {
+        ring->used -= LOOP_RINGSIZE - ring->head;
+        ring->head = 0;
+    }
+
+    const byte* entry = ring->data + ring->head;
+    const i32 ret = entry[0];
+    const i32 length = entry[1] + (entry[2] << 8);
+    ring->held = IntAlign(length + 4);
+    loopMessages++;
+
+    if (net_loopcopy.value) {
+        // The old path: copy out, then close the gap in a linear buffer.
+        SZ_Clear(&net_message);
+        SZ_Write(&net_message, (void*) (entry + 4), length);
+        loopReadCopied += length;
+        loopCompactCopied += ring->used - ring->held;
+    } else {
+        NET_SetMessageView((byte*) entry + 4, length);
+    }
 
     if (sock->driverdata && ret == 1)
         ((qsocket_t*) sock->driverdata)->canSend = true;
@@ -147,67 +265,52 @@ i32 Loop_GetMessage(qsocket_t* sock) {
 
 
 i32 Loop_SendMessage(qsocket_t* sock, sizebuf_t* data) {
-    byte* buffer;
-    i32* bufferLength;
-
     if (!sock->driverdata)
         return -1;
 
-    bufferLength = &((qsocket_t*) sock->driverdata)->receiveMessageLength;
-
-    if ((*bufferLength + data->cursize + 4) > NET_MAXMESSAGE)
+    loopring_t* ring = Loop_GetRing(sock->driverdata);
+    byte* entry = Loop_Reserve(ring, IntAlign(data->cursize + 4));
+    if (!entry)
         Sys_Error("Loop_SendMessage: overflow\n");
 
-    buffer = ((qsocket_t*) sock->driverdata)->receiveMessage + *bufferLength;
-
-    // message type
-    *buffer++ = 1;
-
-    // length
-    *buffer++ = data->cursize & 0xff;
-    *buffer++ = data->cursize >> 8;
-
-    // align
-    buffer++;
-
-    // message
-    Q_memcpy(buffer, data->data, data->cursize);
-    *bufferLength = IntAlign(*bufferLength + data->cursize + 4);
-
+    Loop_WriteEntry(entry, 1, data);
     sock->canSend = false;
     return 1;
 }
 
 
 i32 Loop_SendUnreliableMessage(qsocket_t* sock, sizebuf_t* data) {
-    byte* buffer;
-    i32* bufferLength;
-
     if (!sock->driverdata)
         return -1;
 
-    bufferLength = &((qsocket_t*) sock->driverdata)->receiveMessageLength;
-
-    if ((*bufferLength + data->cursize + sizeof(byte) + sizeof(i16)) >
-        NET_MAXMESSAGE)
+    loopring_t* ring = Loop_GetRing(sock->driverdata);
+    const i32 size = IntAlign(data->cursize + 4);
+    if (ring->used + size > LOOP_RINGSIZE - LOOP_RELIABLEROOM)
         return 0;
 
-    buffer = ((qsocket_t*) sock->driverdata)->receiveMessage + *bufferLength;
-
-    // message type
-    *buffer++ = 2;
+    byte* entry = Loop_Reserve(ring, size);
+    if (!entry)
+        return 0;
 
-    // length
-    *buffer++ = data->cursize & 0xff;
-    *buffer++ = data->cursize >> 8;
+    Loop_WriteEntry(entry, 2, data);
+    return 1;
+}
 
-    // align
-    buffer++;
 
-    // message
-    Q_memcpy(buffer, data->data, data->cursize);
-    *bufferLength = IntAlign(*bufferLength + data->cursize + 4);
-    return 1;
+static void Loop_Stats_f(void) {
+    const i32 frames = host_framecount - loopStartFrame;
+    const i32 copied = loopSendCopied + loopReadCopied + loopCompactCopied;
+    Con_Printf("%i messages in %i frames (%s)\n", loopMessages, frames,
+               net_loopcopy.value ? "copying" : "zero-copy");
+    Con_Printf("send copies    = %i\n", loopSendCopied);
+    Con_Printf("read copies    = %i\n", loopReadCopied);
+    Con_Printf("compaction     = %i\n", loopCompactCopied);
+    Con_Printf("bytes/frame    = %.0f\n", frames > 0 ? (double) copied / frames : 0);
+    loopMessages = 0;
+    loopSendCopied = 0;
+    loopReadCopied = 0;
+    loopCompactCopied = 0;
+    loopStartFrame = host_framecount;
 }
 
 
@@ -226,8 +329,7 @@ qboolean Loop_CanSendUnreliableMessage(qsocket_t* sock) {
 void Loop_Close(qsocket_t* sock) {
     if (sock->driverdata)
         ((qsocket_t*) sock->driverdata)->driverdata = NULL;
-    sock->receiveMessageLength = 0;
-    sock->sendMessageLength = 0;
+    Loop_ClearRing(Loop_GetRing(sock));
     sock->canSend = true;
     if (sock == loop_client)
         loop_client = NULL;
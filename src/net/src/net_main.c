@@ -26,6 +26,7 @@
 #include "console.h"
 #include "net_poll.h"
 #include "net_socket.h"
+#include "net_udp.h"
 #include "net_vcr.h"
 #include "server.h"
 #include "sys.h"
@@ -54,6 +55,7 @@ static qboolean listening = false;
 
 
 sizebuf_t net_message;
+static byte* net_messagebuffer;
 i32 net_activeconnections = 0;
 
 i32 messagesSent = 0;
@@ -73,6 +75,10 @@ cvar_t config_modem_clear = {"_config_modem_clear", "ATZ", true};
 cvar_t config_modem_init = {"_config_modem_init", "", true};
 cvar_t config_modem_hangup = {"_config_modem_hangup", "AT H", true};
 
+cvar_t net_masterlist = {"net_masterlist", "servers.txt", true};
+cvar_t net_masterwindow = {"net_masterwindow", "1.0"};
+cvar_t net_masterttl = {"net_masterttl", "60"};
+
 i32 vcrFile = -1;
 qboolean recording = false;
 
@@ -183,6 +189,7 @@ qsocket_t* NET_Connect(char* host) {
     i32 numdrivers = net_numdrivers;
 
     SetNetTime();
+    NET_ReclaimMessage();
 
     if (host && *host == 0)
         host = NULL;
@@ -193,6 +200,10 @@ qsocket_t* NET_Connect(char* host) {
             goto JustDoIt;
         }
 
+        if (Q_strcasecmp(host, "netsim") == 0) {
+            goto JustDoIt;
+        }
+
         if (hostCacheCount) {
             for (n = 0; n < hostCacheCount; n++)
                 if (Q_strcasecmp(host, hostcache[n].name) == 0) {
@@ -257,6 +268,7 @@ qsocket_t* NET_CheckNewConnections(void) {
     qsocket_t* ret;
 
     SetNetTime();
+    NET_ReclaimMessage();
 
     for (net_driverlevel = 0; net_driverlevel < net_numdrivers;
          net_driverlevel++) {
@@ -314,6 +326,7 @@ i32 NET_GetMessage(qsocket_t* sock) {
     if (!sock) {
         return -1;
     }
+    NET_ReclaimMessage();
     const i32 ret = NET_GetSocketMessage(sock);
     if (NET_IsSocketDisconnected(sock)) {
         return -1;
@@ -469,6 +482,61 @@ i32 NET_SendToAll(sizebuf_t* data, i32 blocktime) {
 }
 
 
+
+/*
+====================
+NET_SetMessageView
+====================
+*/
+void NET_SetMessageView(byte* data, i32 length) {
+    net_message.data = data;
+    net_message.maxsize = length;
+    net_message.cursize = length;
+}
+
+
+/*
+====================
+NET_ReclaimMessage
+====================
+*/
+void NET_ReclaimMessage(void) {
+    if (net_message.data == net_messagebuffer) {
+        return;
+    }
+    net_message.data = net_messagebuffer;
+    net_message.maxsize = NET_MAXMESSAGE;
+    net_message.cursize = 0;
+}
+
+
+void NET_BeginBatch(void) {
+    UDP_BeginBatch();
+}
+
+
+void NET_FlushBatch(void) {
+    UDP_FlushBatch();
+}
+
+
+/*
+====================
+NET_Sleep
+
+Waits on the network sockets for up to the given number of seconds.
+Returns false if it woke for data that needs a frame to be consumed.
+====================
+*/
+qboolean NET_Sleep(double seconds) {
+    const i32 ms = (i32) (seconds * 1000.0);
+    if (ms <= 0) {
+        return true;
+    }
+    return UDP_Sleep(ms);
+}
+
+
 //=============================================================================
 
 /*
@@ -512,6 +580,7 @@ void NET_Init(void) {
 
     // allocate space for network message buffer
     SZ_Alloc(&net_message, NET_MAXMESSAGE);
+    net_messagebuffer = net_message.data;
 
     Cvar_RegisterVariable(&hostname);
     Cvar_RegisterVariable(&config_com_port);
@@ -522,8 +591,12 @@ void NET_Init(void) {
     Cvar_RegisterVariable(&config_modem_clear);
     Cvar_RegisterVariable(&config_modem_init);
     Cvar_RegisterVariable(&config_modem_hangup);
+    Cvar_RegisterVariable(&net_masterlist);
+    Cvar_RegisterVariable(&net_masterwindow);
+    Cvar_RegisterVariable(&net_masterttl);
 
     Cmd_AddCommand("slist", NET_Slist_f);
+    Cmd_AddCommand("slist_master", NET_SlistMaster_f);
     Cmd_AddCommand("listen", NET_Listen_f);
     Cmd_AddCommand("maxplayers", MaxPlayers_f);
     Cmd_AddCommand("port", NET_Port_f);
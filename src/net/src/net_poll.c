@@ -22,7 +22,9 @@
 
 #include "net_poll.h"
 #include "client.h"
+#include "cmd.h"
 #include "console.h"
+#include "net_dgrm.h"
 #include "server.h"
 #include "sys.h"
 
@@ -39,17 +41,23 @@ extern cvar_t config_modem_dialtype;
 extern cvar_t config_modem_clear;
 extern cvar_t config_modem_init;
 extern cvar_t config_modem_hangup;
+extern cvar_t net_masterlist;
+extern cvar_t net_masterwindow;
+extern cvar_t net_masterttl;
 
 
 static void Slist_Send(void);
 static void Slist_Poll(void);
+static void Master_Poll(void);
 
 static double slistStartTime;
 static i32 slistLastShown;
+static qboolean masterRetried;
 
 static poll_procedure_t* pollProcedureList = NULL;
 static poll_procedure_t slistSendProcedure = {NULL, 0.0, Slist_Send};
 static poll_procedure_t slistPollProcedure = {NULL, 0.0, Slist_Poll};
+static poll_procedure_t masterPollProcedure = {NULL, 0.0, Master_Poll};
 
 qboolean slistInProgress = false;
 qboolean slistSilent = false;
@@ -138,6 +146,7 @@ void NET_Slist_f(void) {
     if (slistInProgress) {
         return;
     }
+    NET_ReclaimMessage();
     if (!slistSilent) {
         Con_Printf("Looking for Quake servers...\n");
         NET_PrintSlistHeader();
@@ -152,6 +161,37 @@ void NET_Slist_f(void) {
     hostCacheCount = 0;
 }
 
+/*
+====================
+NET_SlistMaster_f
+
+Queries every server in a list file at once, instead of broadcasting.
+slist_master [file]
+====================
+*/
+void NET_SlistMaster_f(void) {
+    if (slistInProgress) {
+        return;
+    }
+    char* filename = Cmd_Argc() > 1 ? Cmd_Argv(1) : net_masterlist.string;
+    NET_ReclaimMessage();
+    const i32 count = Datagram_LoadMasterList(filename);
+    if (count <= 0) {
+        if (count == 0) {
+            Con_Printf("No servers in %s\n", filename);
+        }
+        return;
+    }
+
+    slistInProgress = true;
+    slistStartTime = Sys_FloatTime();
+    masterRetried = false;
+
+    const i32 sent = Datagram_QueryMasterHosts(net_masterttl.value, false);
+    Con_Printf("Querying %i of %i servers from %s...\n", sent, count, filename);
+    NET_SchedulePollProcedure(&masterPollProcedure, 0.0);
+}
+
 //==============================================================================
 
 
@@ -203,10 +243,30 @@ static void Slist_Poll(void) {
     slistLocal = true;
 }
 
+// Polled on every frame, so each round trip is measured to within a frame.
+static void Master_Poll(void) {
+    const double elapsed = Sys_FloatTime() - slistStartTime;
+    const i32 pending = Datagram_PollMasterHosts();
+
+    if (pending && elapsed < net_masterwindow.value) {
+        // Ask the silent ones once more halfway through, in case of loss.
+        if (!masterRetried && elapsed > net_masterwindow.value / 2) {
+            Datagram_QueryMasterHosts(net_masterttl.value, true);
+            masterRetried = true;
+        }
+        NET_SchedulePollProcedure(&masterPollProcedure, 0.005);
+        return;
+    }
+
+    Datagram_PrintMasterHosts();
+    slistInProgress = false;
+}
+
 //==============================================================================
 
 
 void NET_Poll(void) {
+    NET_ReclaimMessage();
     if (!configRestored) {
         if (serialAvailable) {
             qboolean useModem = (config_com_modem.value == 1.0);
@@ -0,0 +1,341 @@
+/*
+ * Copyright (C) 1996-1997 Id Software, Inc.
+ * Copyright (C) Henrique Barateli, <henriquejb194@gmail.com>, et al.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+// net_sim.c -- in-process network simulator
+
+// The netsim driver connects a client to the local server over a pair of
+// simulated sockets. Both ends run the real datagram protocol, so the
+// reliable channel, fragmentation and everything above it behave as on a
+// network, while the link in between adds latency, jitter, loss,
+// duplication, reordering and a bandwidth cap. All random decisions come
+// from a generator seeded with net_sim_seed at connect time, so the same
+// traffic is hit the same way on every run.
+//
+// Start a listening server and "connect netsim" to use it.
+
+
+#include "net_sim.h"
+#include "client.h"
+#include "cmd.h"
+#include "console.h"
+#include "net_dgrm.h"
+#include "net_socket.h"
+#include "server.h"
+
+
+#define NETSIM_MAXPACKETS 256
+
+typedef struct {
+    double time; // when it reaches the other end
+    IPaddress from;
+    i32 length;
+    byte data[NET_DATAGRAMSIZE];
+} simpacket_t;
+
+typedef struct simendpoint_s {
+    qboolean active;
+    IPaddress addr;
+    struct simendpoint_s* peer;
+    // Packets on their way to this endpoint.
+    simpacket_t packets[NETSIM_MAXPACKETS];
+    i32 count;
+    double busyUntil; // link serialization, for net_sim_rate
+} simendpoint_t;
+
+static simendpoint_t endpoints[2];
+
+static qboolean connectpending = false;
+static qsocket_t* sim_client = NULL;
+static qsocket_t* sim_server = NULL;
+
+static u32 sim_random = 1;
+
+static cvar_t net_sim_latency = {"net_sim_latency", "50"};  // one way, ms
+static cvar_t net_sim_jitter = {"net_sim_jitter", "0"};    // ms
+static cvar_t net_sim_loss = {"net_sim_loss", "0"};        // 0..1
+static cvar_t net_sim_dup = {"net_sim_dup", "0"};          // 0..1
+static cvar_t net_sim_reorder = {"net_sim_reorder", "0"};  // 0..1
+static cvar_t net_sim_rate = {"net_sim_rate", "0"};        // bytes per second
+static cvar_t net_sim_seed = {"net_sim_seed", "1"};
+
+// Statistic Counters
+static i32 simPackets = 0;
+static i32 simBytes = 0;
+static i32 simLost = 0;
+static i32 simDuplicated = 0;
+static i32 simReordered = 0;
+static i32 simOverflowed = 0;
+static double simDelay = 0;
+
+
+/*
+================================================================================
+
+SIMULATED LINK
+
+================================================================================
+*/
+
+static float NetSim_Random(void) {
+    // xorshift32
+    sim_random ^= sim_random << 13;
+    sim_random ^= sim_random >> 17;
+    sim_random ^= sim_random << 5;
+    return (sim_random & 0xffffff) / (float) 0x1000000;
+}
+
+static double NetSim_DeliveryTime(simendpoint_t* to, const i32 len) {
+    double time = net_time;
+
+    if (net_sim_rate.value > 0) {
+        if (to->busyUntil > time) {
+            time = to->busyUntil;
+        }
+        time += len / net_sim_rate.value;
+        to->busyUntil = time;
+    }
+
+    time += net_sim_latency.value / 1000.0;
+    if (net_sim_jitter.value > 0) {
+        time += NetSim_Random() * net_sim_jitter.value / 1000.0;
+    }
+    if (net_sim_reorder.value > 0 && NetSim_Random() < net_sim_reorder.value) {
+        // Held back long enough for later packets to overtake it.
+        const double hold = net_sim_latency.value > 20 ? net_sim_latency.value : 20;
+        time += (0.5 + NetSim_Random()) * hold / 1000.0;
+        simReordered++;
+    }
+    return time;
+}
+
+static void NetSim_Queue(
+    simendpoint_t* to,
+    const simendpoint_t* from,
+    const byte* buf,
+    const i32 len,
+    const double time
+) {
+    if (to->count == NETSIM_MAXPACKETS) {
+        // Tail drop, like a router with a full buffer.
+        simOverflowed++;
+        return;
+    }
+    simpacket_t* packet = &to->packets[to->count++];
+    packet->time = time;
+    packet->from = from->addr;
+    packet->length = len;
+    Q_memcpy(packet->data, buf, len);
+    simDelay += time - net_time;
+}
+
+qboolean NetSim_IsSocket(UDPsocket socket) {
+    const simendpoint_t* endpoint = (const simendpoint_t*) socket;
+    return endpoint >= endpoints && endpoint < endpoints + SDL_arraysize(endpoints);
+}
+
+i32 NetSim_Write(UDPsocket socket, const byte* buf, i32 len) {
+    const simendpoint_t* from = (const simendpoint_t*) socket;
+    simendpoint_t* to = from->peer;
+    if (!to || len > NET_DATAGRAMSIZE) {
+        // Nobody listening on the other end.
+        return 1;
+    }
+
+    simPackets++;
+    simBytes += len;
+    if (NetSim_Random() < net_sim_loss.value) {
+        simLost++;
+        return 1;
+    }
+    const double time = NetSim_DeliveryTime(to, len);
+    NetSim_Queue(to, from, buf, len, time);
+    if (NetSim_Random() < net_sim_dup.value) {
+        NetSim_Queue(to, from, buf, len, NetSim_DeliveryTime(to, len));
+        simDuplicated++;
+    }
+    return 1;
+}
+
+i32 NetSim_Read(UDPsocket socket, byte* buf, i32 len, IPaddress* addr) {
+    simendpoint_t* endpoint = (simendpoint_t*) socket;
+    i32 best = -1;
+    for (i32 i = 0; i < endpoint->count; i++) {
+        if (endpoint->packets[i].time > net_time) {
+            continue;
+        }
+        if (best == -1 || endpoint->packets[i].time < endpoint->packets[best].time) {
+            best = i;
+        }
+    }
+    if (best == -1) {
+        return 0;
+    }
+
+    const simpacket_t* packet = &endpoint->packets[best];
+    const i32 size = packet->length < len ? packet->length : len;
+    Q_memcpy(buf, packet->data, size);
+    *addr = packet->from;
+    endpoint->packets[best] = endpoint->packets[--endpoint->count];
+    return size;
+}
+
+//==============================================================================
+
+
+/*
+================================================================================
+
+DRIVER
+
+================================================================================
+*/
+
+static void NetSim_Stats_f(void) {
+    Con_Printf("packets    = %i (%i bytes)\n", simPackets, simBytes);
+    Con_Printf("lost       = %i\n", simLost);
+    Con_Printf("duplicated = %i\n", simDuplicated);
+    Con_Printf("reordered  = %i\n", simReordered);
+    Con_Printf("overflowed = %i\n", simOverflowed);
+    const i32 queued = simPackets - simLost - simOverflowed + simDuplicated;
+    Con_Printf("mean delay = %.1f ms\n", queued > 0 ? simDelay / queued * 1000 : 0);
+}
+
+static void NetSim_ResetStats(void) {
+    simPackets = 0;
+    simBytes = 0;
+    simLost = 0;
+    simDuplicated = 0;
+    simReordered = 0;
+    simOverflowed = 0;
+    simDelay = 0;
+}
+
+i32 NetSim_Init(void) {
+    if (cls.state == ca_dedicated) {
+        return -1;
+    }
+    Cvar_RegisterVariable(&net_sim_latency);
+    Cvar_RegisterVariable(&net_sim_jitter);
+    Cvar_RegisterVariable(&net_sim_loss);
+    Cvar_RegisterVariable(&net_sim_dup);
+    Cvar_RegisterVariable(&net_sim_reorder);
+    Cvar_RegisterVariable(&net_sim_rate);
+    Cvar_RegisterVariable(&net_sim_seed);
+    Cmd_AddCommand("net_simstats", NetSim_Stats_f);
+    return 0;
+}
+
+void NetSim_Shutdown(void) {
+}
+
+void NetSim_Listen(qboolean state) {
+}
+
+void NetSim_SearchForHosts(qboolean xmit) {
+}
+
+static void NetSim_OpenEndpoint(simendpoint_t* endpoint, const i32 port) {
+    endpoint->active = true;
+    endpoint->peer = NULL;
+    endpoint->count = 0;
+    endpoint->busyUntil = 0;
+    SDLNet_Write32(INADDR_LOOPBACK, &endpoint->addr.host);
+    SDLNet_Write16(port, &endpoint->addr.port);
+}
+
+static qsocket_t* NetSim_NewSocket(simendpoint_t* endpoint, simendpoint_t* peer, char* name) {
+    qsocket_t* sock = NET_NewQSocket();
+    if (!sock) {
+        Con_Printf("NetSim_Connect: no qsocket available\n");
+        return NULL;
+    }
+    sock->socket = (UDPsocket) endpoint;
+    sock->addr = peer->addr;
+    sock->extensions = Datagram_Extensions();
+    Q_strcpy(sock->address, name);
+    return sock;
+}
+
+qsocket_t* NetSim_Connect(char* host) {
+    if (Q_strcasecmp(host, "netsim") != 0) {
+        return NULL;
+    }
+    if (endpoints[0].active || endpoints[1].active) {
+        Con_Printf("NetSim_Connect: already connected\n");
+        return NULL;
+    }
+
+    simendpoint_t* client = &endpoints[0];
+    simendpoint_t* server = &endpoints[1];
+    NetSim_OpenEndpoint(client, 1);
+    NetSim_OpenEndpoint(server, 2);
+
+    sim_client = NetSim_NewSocket(client, server, "netsim client");
+    sim_server = sim_client ? NetSim_NewSocket(server, client, "netsim server") : NULL;
+    if (!sim_server) {
+        if (sim_client) {
+            NET_FreeQSocket(sim_client);
+        }
+        client->active = false;
+        server->active = false;
+        return NULL;
+    }
+
+    client->peer = server;
+    server->peer = client;
+    sim_random = (u32) net_sim_seed.value;
+    if (sim_random == 0) {
+        sim_random = 1;
+    }
+    NetSim_ResetStats();
+    connectpending = true;
+    return sim_client;
+}
+
+qsocket_t* NetSim_CheckNewConnections(void) {
+    if (!connectpending) {
+        return NULL;
+    }
+    connectpending = false;
+    return sim_server;
+}
+
+void NetSim_Close(qsocket_t* sock) {
+    simendpoint_t* endpoint = (simendpoint_t*) sock->socket;
+    if (endpoint->peer) {
+        endpoint->peer->peer = NULL;
+    }
+    endpoint->active = false;
+    endpoint->peer = NULL;
+    endpoint->count = 0;
+    if (sock == sim_client) {
+        sim_client = NULL;
+        if (connectpending) {
+            // The server never picked it up.
+            connectpending = false;
+            NET_FreeQSocket(sim_server);
+            sim_server = NULL;
+            endpoints[1].active = false;
+        }
+    } else {
+        sim_server = NULL;
+    }
+}
+
+//==============================================================================
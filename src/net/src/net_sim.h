@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 1996-1997 Id Software, Inc.
+ * Copyright (C) Henrique Barateli, <henriquejb194@gmail.com>, et al.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+// net_sim.h
+
+
+#ifndef __NET_SIM__
+#define __NET_SIM__
+
+#include "quakedef.h"
+#include "net.h"
+#include <SDL_net.h>
+
+i32 NetSim_Init(void);
+void NetSim_Listen(qboolean state);
+void NetSim_SearchForHosts(qboolean xmit);
+qsocket_t* NetSim_Connect(char* host);
+qsocket_t* NetSim_CheckNewConnections(void);
+void NetSim_Close(qsocket_t* sock);
+void NetSim_Shutdown(void);
+
+// Packet I/O for the simulated sockets, routed here by net_udp.c.
+qboolean NetSim_IsSocket(UDPsocket socket);
+i32 NetSim_Read(UDPsocket socket, byte* buf, i32 len, IPaddress* addr);
+i32 NetSim_Write(UDPsocket socket, const byte* buf, i32 len);
+
+#endif
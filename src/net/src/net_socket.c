@@ -95,6 +95,19 @@ qsocket_t* NET_NewQSocket(void) {
     sock->receiveSequence = 0;
     sock->unreliableReceiveSequence = 0;
     sock->receiveMessageLength = 0;
+    sock->extensions = 0;
+    sock->sendOffset = 0;
+    sock->inFlight = 0;
+    sock->dupAcks = 0;
+    sock->retransmits = 0;
+    sock->resent = false;
+    sock->srtt = 0;
+    sock->rttvar = 0;
+    sock->rto = 1.0;
+    sock->fragmentMask = 0;
+    for (i32 i = 0; i < NET_WINDOWSIZE; i++) {
+        sock->recvWindow[i].present = false;
+    }
     return sock;
 }
 
@@ -127,6 +140,18 @@ qboolean NET_IsSocketDisconnected(const qsocket_t* sock) {
     return sock->disconnected;
 }
 
+i32 NET_GetMaxMessage(const qsocket_t* sock) {
+    return sock->extensions & NET_EXT_BIGMESSAGES ? MAX_MSGLEN_EXT : MAX_MSGLEN;
+}
+
+i32 NET_GetMaxDatagram(const qsocket_t* sock) {
+    return sock->extensions & NET_EXT_BIGMESSAGES ? MAX_DATAGRAM_EXT : MAX_DATAGRAM;
+}
+
+double NET_GetRTT(const qsocket_t* sock) {
+    return sock->srtt;
+}
+
 //==============================================================================
 
 
@@ -142,6 +167,12 @@ static void NET_PrintStats(const qsocket_t* s) {
     Con_Printf("canSend = %4u   \n", s->canSend);
     Con_Printf("sendSeq = %4u   ", s->sendSequence);
     Con_Printf("recvSeq = %4u   \n", s->receiveSequence);
+    if (s->extensions & NET_EXT_RELIABLEWINDOW) {
+        Con_Printf("inFlight = %5i bytes\n", s->inFlight);
+        Con_Printf("rtt = %4.0f ms   ", s->srtt * 1000);
+        Con_Printf("rto = %4.0f ms   \n", s->rto * 1000);
+        Con_Printf("retransmits = %i\n", s->retransmits);
+    }
     Con_Printf("\n");
 }
 
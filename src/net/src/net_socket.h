@@ -27,11 +27,31 @@
 #include "net.h"
 #include <SDL_net.h>
 
+// Reliable fragments in flight with NET_EXT_RELIABLEWINDOW.
+#define NET_WINDOWSIZE 16
+
+typedef struct {
+    i32 offset; // into sendMessage
+    i32 length;
+    qboolean eom;
+    qboolean acked;
+    qboolean resent;
+    double sendTime;
+} sendfragment_t;
+
+typedef struct {
+    qboolean present;
+    qboolean eom;
+    i32 length;
+    byte data[MAX_DATAGRAM];
+} recvfragment_t;
+
 typedef struct qsocket_s {
     struct qsocket_s* next;
     double connecttime;
     double lastMessageTime;
     double lastSendTime;
+    qboolean resent; // the packet awaiting its ACK went out more than once
 
     qboolean disconnected;
     qboolean canSend;
@@ -54,6 +74,26 @@ typedef struct qsocket_s {
 
     IPaddress addr;
     char address[NET_NAMELEN];
+
+    // Sliding window state, indexed by sequence % NET_WINDOWSIZE.
+    // ackSequence is the oldest unacknowledged fragment.
+    i32 extensions;
+    i32 sendOffset;
+    i32 inFlight;
+    i32 dupAcks;
+    i32 retransmits;
+    double srtt;
+    double rttvar;
+    double rto;
+    sendfragment_t sendWindow[NET_WINDOWSIZE];
+    recvfragment_t recvWindow[NET_WINDOWSIZE];
+
+    // Unreliable message being reassembled with NET_EXT_BIGMESSAGES.
+    u32 fragmentSequence;
+    u32 fragmentMask;
+    i32 fragmentCount;
+    i32 fragmentLength;
+    byte fragmentMessage[MAX_DATAGRAM_EXT];
 } qsocket_t;
 
 
@@ -67,6 +107,12 @@ qsocket_t* NET_NewQSocket(void);
 
 void NET_FreeQSocket(qsocket_t* sock);
 
+//
+// Points net_message at a message held in a driver's buffer instead of
+// copying it. The view lasts until the next NET_ReclaimMessage.
+//
+void NET_SetMessageView(byte* data, i32 length);
+
 qboolean NET_IsSocketDisconnected(const qsocket_t* sock);
 
 void NET_PrintSocketStats(const char* addr);
@@ -24,8 +24,10 @@
 #include "console.h"
 #include "cvar.h"
 #include "net.h"
+#include "net_sim.h"
 #include "sys.h"
 #include <SDL_net.h>
+#include <SDL_timer.h>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -39,6 +41,26 @@
 #define MAXHOSTNAMELEN 256
 #endif
 
+// One queue per connected qsocket, plus the local client's connection.
+#define UDP_MAXQUEUES (MAX_SCOREBOARD + 1)
+// The accept socket shares the set so UDP_Sleep wakes on connection requests.
+#define UDP_MAXSETSOCKETS (UDP_MAXQUEUES + 1)
+#define UDP_RECVQUEUE 32
+#define UDP_SENDQUEUE 16
+
+typedef struct {
+    UDPsocket socket;
+    qboolean error;
+    // Received packets waiting to be read, [recvhead, recvhead + recvcount).
+    // The vector is NULL terminated, as SDLNet_UDP_RecvV expects.
+    UDPpacket** recv;
+    i32 recvhead;
+    i32 recvcount;
+    // Outgoing packets held back until the batch is flushed.
+    UDPpacket** send;
+    i32 sendcount;
+} udpqueue_t;
+
 
 static qboolean initialized = false;
 
@@ -49,6 +71,18 @@ static UDPsocket accept_sock = NULL;
 static UDPsocket control_sock = NULL;
 static UDPsocket broadcast_sock = NULL;
 
+static udpqueue_t queues[UDP_MAXQUEUES];
+static SDLNet_SocketSet queue_set = NULL;
+static qboolean batching = false;
+static u32 lastpump = 0;
+
+i32 udp_pumps = 0;
+i32 udp_queuedpackets = 0;
+i32 udp_sendbatches = 0;
+i32 udp_batchedpackets = 0;
+i32 udp_sleeps = 0;
+i32 udp_wakeups = 0;
+
 
 static qboolean UDP_IsLocalAddr(const IPaddress* addr) {
     return addr->host == 0 || SDLNet_Read32(&addr->host) == INADDR_LOOPBACK;
@@ -113,6 +147,10 @@ void UDP_Init(void) {
         *colon = 0;
     }
 
+    if ((queue_set = SDLNet_AllocSocketSet(UDP_MAXSETSOCKETS)) == NULL) {
+        Sys_Error("UDP_Init: Unable to allocate socket set\n");
+    }
+
     Con_Printf("UDP Initialized\n");
     tcpipAvailable = true;
     initialized = true;
@@ -121,6 +159,11 @@ void UDP_Init(void) {
 void UDP_Shutdown(void) {
     UDP_Listen(false);
     UDP_CloseSocket(control_sock);
+    for (i32 i = 0; i < UDP_MAXQUEUES; i++) {
+        UDP_DisableQueue(queues[i].socket);
+    }
+    SDLNet_FreeSocketSet(queue_set);
+    queue_set = NULL;
     initialized = false;
 }
 
@@ -128,6 +171,9 @@ static void UDP_DisableListening(void) {
     if (accept_sock == NULL) {
         return;
     }
+    if (queue_set) {
+        SDLNet_UDP_DelSocket(queue_set, accept_sock);
+    }
     UDP_CloseSocket(accept_sock);
     accept_sock = NULL;
 }
@@ -139,6 +185,9 @@ static void UDP_EnableListening(void) {
     if ((accept_sock = UDP_OpenSocket(net_hostport)) == NULL) {
         Sys_Error("UDP_Listen: Unable to open accept socket\n");
     }
+    if (queue_set) {
+        SDLNet_UDP_AddSocket(queue_set, accept_sock);
+    }
 }
 
 void UDP_Listen(qboolean state) {
@@ -157,10 +206,14 @@ void UDP_CloseSocket(UDPsocket socket) {
     if (socket == broadcast_sock) {
         broadcast_sock = NULL;
     }
+    UDP_DisableQueue(socket);
     SDLNet_UDP_Close(socket);
 }
 
 i32 UDP_Read(UDPsocket socket, byte* buf, i32 len, IPaddress* addr) {
+    if (NetSim_IsSocket(socket)) {
+        return NetSim_Read(socket, buf, len, addr);
+    }
     UDPpacket packet = {0};
     packet.data = buf;
     packet.maxlen = len;
@@ -176,6 +229,225 @@ i32 UDP_Read(UDPsocket socket, byte* buf, i32 len, IPaddress* addr) {
     return packet.len;
 }
 
+/*
+================================================================================
+
+PACKET QUEUES
+
+Sockets belonging to a connection get a receive and a send queue. All
+receive queues are filled together: one SDLNet_CheckSockets call finds the
+sockets with pending data and only those are read, each drained with a
+single SDLNet_UDP_RecvV. Idle connections cost nothing. While a batch is
+open, writes to a queued socket are held back and sent with one
+SDLNet_UDP_SendV per socket when the batch is flushed.
+
+================================================================================
+*/
+
+static udpqueue_t* UDP_FindQueue(UDPsocket socket) {
+    if (!socket) {
+        return NULL;
+    }
+    for (i32 i = 0; i < UDP_MAXQUEUES; i++) {
+        if (queues[i].socket == socket) {
+            return &queues[i];
+        }
+    }
+    return NULL;
+}
+
+void UDP_EnableQueue(UDPsocket socket) {
+    if (!queue_set || UDP_FindQueue(socket)) {
+        return;
+    }
+    udpqueue_t* q = NULL;
+    for (i32 i = 0; i < UDP_MAXQUEUES && !q; i++) {
+        if (!queues[i].socket) {
+            q = &queues[i];
+        }
+    }
+    if (!q) {
+        // Out of queues, the socket is read and written directly.
+        return;
+    }
+    q->recv = SDLNet_AllocPacketV(UDP_RECVQUEUE, NET_DATAGRAMSIZE);
+    q->send = SDLNet_AllocPacketV(UDP_SENDQUEUE, NET_DATAGRAMSIZE);
+    if (!q->recv || !q->send || SDLNet_UDP_AddSocket(queue_set, socket) == -1) {
+        SDLNet_FreePacketV(q->recv);
+        SDLNet_FreePacketV(q->send);
+        Q_memset(q, 0, sizeof(*q));
+        return;
+    }
+    q->socket = socket;
+    q->error = false;
+    q->recvhead = 0;
+    q->recvcount = 0;
+    q->sendcount = 0;
+}
+
+static void UDP_FlushQueue(udpqueue_t* q) {
+    if (q->sendcount == 0) {
+        return;
+    }
+    if (SDLNet_UDP_SendV(q->socket, q->send, q->sendcount) < q->sendcount) {
+        // Report it on the next read, the writes already returned.
+        q->error = true;
+    }
+    udp_sendbatches++;
+    udp_batchedpackets += q->sendcount;
+    q->sendcount = 0;
+}
+
+void UDP_DisableQueue(UDPsocket socket) {
+    udpqueue_t* q = UDP_FindQueue(socket);
+    if (!q) {
+        return;
+    }
+    // Anything written before closing still goes out.
+    UDP_FlushQueue(q);
+    SDLNet_UDP_DelSocket(queue_set, socket);
+    SDLNet_FreePacketV(q->recv);
+    SDLNet_FreePacketV(q->send);
+    Q_memset(q, 0, sizeof(*q));
+}
+
+static void UDP_QueueWrite(udpqueue_t* q, byte* buf, i32 len, const IPaddress* addr) {
+    if (q->sendcount == UDP_SENDQUEUE) {
+        UDP_FlushQueue(q);
+    }
+    UDPpacket* packet = q->send[q->sendcount++];
+    Q_memcpy(packet->data, buf, len);
+    packet->len = len;
+    packet->channel = -1;
+    packet->address = *addr;
+}
+
+static void UDP_DrainQueue(udpqueue_t* q) {
+    UDPpacket* consumed[UDP_RECVQUEUE];
+    const i32 head = q->recvhead;
+
+    // Move the unread packets to the front so the free ones form a
+    // contiguous, NULL terminated tail for SDLNet_UDP_RecvV.
+    if (head > 0) {
+        Q_memcpy(consumed, q->recv, head * sizeof(*consumed));
+        Q_memmove(q->recv, q->recv + head, q->recvcount * sizeof(*consumed));
+        Q_memcpy(q->recv + q->recvcount, consumed, head * sizeof(*consumed));
+        q->recvhead = 0;
+    }
+    if (q->recvcount == UDP_RECVQUEUE) {
+        // Full, the rest waits in the socket buffer.
+        return;
+    }
+    const i32 ret = SDLNet_UDP_RecvV(q->socket, q->recv + q->recvcount);
+    if (ret == -1) {
+        if (errno != EWOULDBLOCK && errno != ECONNREFUSED) {
+            q->error = true;
+        }
+        return;
+    }
+    q->recvcount += ret;
+    udp_queuedpackets += ret;
+}
+
+static void UDP_DrainReadyQueues(void) {
+    udp_pumps++;
+    for (i32 i = 0; i < UDP_MAXQUEUES; i++) {
+        if (queues[i].socket && SDLNet_SocketReady(queues[i].socket)) {
+            UDP_DrainQueue(&queues[i]);
+        }
+    }
+}
+
+/*
+====================
+UDP_PumpQueues
+
+Fills the receive queues of every socket with pending data.
+Runs at most once per millisecond, so polling loops keep working
+without paying for a select on every call.
+====================
+*/
+void UDP_PumpQueues(void) {
+    const u32 now = SDL_GetTicks();
+    if (!queue_set || now == lastpump) {
+        return;
+    }
+    lastpump = now;
+    if (SDLNet_CheckSockets(queue_set, 0) <= 0) {
+        return;
+    }
+    UDP_DrainReadyQueues();
+}
+
+/*
+====================
+UDP_Sleep
+
+Blocks for up to ms milliseconds, or until a packet arrives on the
+accept socket or on any queued connection. Packets for queued
+connections are moved into their receive queues, so the sockets stop
+being readable and the caller can go back to sleep.
+
+Returns false if data is still pending that only a frame can consume,
+a connection request or a full receive queue.
+====================
+*/
+qboolean UDP_Sleep(i32 ms) {
+    if (!queue_set) {
+        SDL_Delay(ms);
+        return true;
+    }
+    udp_sleeps++;
+    if (SDLNet_CheckSockets(queue_set, ms) <= 0) {
+        return true;
+    }
+    udp_wakeups++;
+    UDP_DrainReadyQueues();
+    lastpump = SDL_GetTicks();
+    return SDLNet_CheckSockets(queue_set, 0) <= 0;
+}
+
+i32 UDP_ReadQueued(UDPsocket socket, byte* buf, i32 len, IPaddress* addr) {
+    udpqueue_t* q = UDP_FindQueue(socket);
+    if (!q) {
+        return UDP_Read(socket, buf, len, addr);
+    }
+    if (q->recvcount == 0) {
+        UDP_PumpQueues();
+    }
+    if (q->error) {
+        q->error = false;
+        return -1;
+    }
+    if (q->recvcount == 0) {
+        return 0;
+    }
+    const UDPpacket* packet = q->recv[q->recvhead++];
+    if (--q->recvcount == 0) {
+        q->recvhead = 0;
+    }
+    const i32 size = packet->len < len ? packet->len : len;
+    Q_memcpy(buf, packet->data, size);
+    *addr = packet->address;
+    return size;
+}
+
+void UDP_BeginBatch(void) {
+    batching = true;
+}
+
+void UDP_FlushBatch(void) {
+    for (i32 i = 0; i < UDP_MAXQUEUES; i++) {
+        if (queues[i].socket) {
+            UDP_FlushQueue(&queues[i]);
+        }
+    }
+    batching = false;
+}
+
+//==============================================================================
+
+
 static i32 UDP_MakeSocketBroadcastCapable(UDPsocket socket) {
     if (broadcast_sock != NULL) {
         Sys_Error("Attempted to use multiple broadcasts sockets\n");
@@ -192,6 +464,16 @@ i32 UDP_Broadcast(UDPsocket socket, byte* buf, i32 len) {
 }
 
 i32 UDP_Write(UDPsocket socket, byte* buf, i32 len, const IPaddress* addr) {
+    if (NetSim_IsSocket(socket)) {
+        return NetSim_Write(socket, buf, len);
+    }
+    if (batching && len <= NET_DATAGRAMSIZE) {
+        udpqueue_t* q = UDP_FindQueue(socket);
+        if (q) {
+            UDP_QueueWrite(q, buf, len, addr);
+            return 1;
+        }
+    }
     UDPpacket packet;
     packet.data = buf;
     packet.len = len;
@@ -26,6 +26,13 @@
 #include "quakedef.h"
 #include <SDL_net.h>
 
+extern i32 udp_pumps;
+extern i32 udp_queuedpackets;
+extern i32 udp_sendbatches;
+extern i32 udp_batchedpackets;
+extern i32 udp_sleeps;
+extern i32 udp_wakeups;
+
 qboolean UDP_IsInitialized(void);
 UDPsocket UDP_GetControlSocket(void);
 UDPsocket UDP_GetAcceptSocket(void);
@@ -37,6 +44,13 @@ void UDP_CloseSocket(UDPsocket socket);
 i32 UDP_Read(UDPsocket socket, byte* buf, i32 len, IPaddress* addr);
 i32 UDP_Write(UDPsocket socket, byte* buf, i32 len, const IPaddress* addr);
 i32 UDP_Broadcast(UDPsocket socket, byte* buf, i32 len);
+void UDP_EnableQueue(UDPsocket socket);
+void UDP_DisableQueue(UDPsocket socket);
+void UDP_PumpQueues(void);
+qboolean UDP_Sleep(i32 ms);
+i32 UDP_ReadQueued(UDPsocket socket, byte* buf, i32 len, IPaddress* addr);
+void UDP_BeginBatch(void);
+void UDP_FlushBatch(void);
 char* UDP_AddrToString(const IPaddress* addr);
 IPaddress UDP_GetSocketAddr(UDPsocket socket);
 void UDP_GetNameFromAddr(const IPaddress* addr, char* name);
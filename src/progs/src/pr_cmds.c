@@ -593,6 +593,7 @@ void PF_traceline(void) {
     nomonsters = G_FLOAT(OFS_PARM2);
     ent = G_EDICT(OFS_PARM3);
 
+    SV_LagRewind();
     trace = SV_Move(v1, vec3_origin, vec3_origin, v2, nomonsters, ent);
 
     pr_global_struct->trace_allsolid = trace.allsolid;
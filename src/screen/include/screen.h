@@ -37,6 +37,7 @@ void SCR_CenterPrint(char* str);
 
 void SCR_BeginLoadingPlaque(void);
 void SCR_EndLoadingPlaque(void);
+void SCR_DrawLoadingProgress(i32 done, i32 total);
 
 i32 SCR_ModalMessage(char* text);
 
@@ -430,6 +430,42 @@ void SCR_DrawLoading(void) {
              pic);
 }
 
+/*
+==============
+SCR_DrawLoadingProgress
+
+Draws the loading plaque with a progress bar under it, without running
+the refresh, so it is safe to call while a level is half loaded.
+==============
+*/
+void SCR_DrawLoadingProgress(i32 done, i32 total) {
+    qpic_t* pic;
+    vrect_t vrect;
+    i32 x, y;
+
+    if (cls.state == ca_dedicated || !scr_initialized || block_drawing)
+        return;
+    if (total <= 0)
+        return;
+
+    pic = Draw_CachePic("gfx/loading.lmp");
+    x = (vid.width - pic->width) / 2;
+    y = (vid.height - 48 - pic->height) / 2;
+
+    D_EnableBackBufferAccess();
+    Draw_Pic(x, y, pic);
+    y += pic->height + 4;
+    Draw_Fill(x, y, pic->width, 4, 0);
+    Draw_Fill(x, y, pic->width * done / total, 4, 15);
+    D_DisableBackBufferAccess();
+
+    vrect.x = 0;
+    vrect.y = 0;
+    vrect.width = vid.width;
+    vrect.height = vid.height;
+    VID_Update(&vrect);
+}
+
 
 //=============================================================================
 
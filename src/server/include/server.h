@@ -75,7 +75,7 @@ typedef struct {
     byte reliable_datagram_buf[MAX_DATAGRAM];
 
     sizebuf_t signon;
-    byte signon_buf[8192];
+    byte signon_buf[MAX_MSGLEN_EXT];
 } server_t;
 
 
@@ -98,19 +98,28 @@ typedef struct client_s {
 
     sizebuf_t message; // can be added to at any time,
                        // copied and clear once per frame
-    byte msgbuf[MAX_MSGLEN];
+    byte msgbuf[MAX_MSGLEN_EXT];
     edict_t* edict; // EDICT_NUM(clientnum+1)
     char name[32];  // for printing to other people
     i32 colors;
 
     float ping_times[NUM_PING_TIMES];
     i32 num_pings; // ping_times[num_pings%NUM_PING_TIMES]
+    double lagtime; // server time the client was shown at its last move
 
     // spawn parms are carried from level to level
     float spawn_parms[NUM_SPAWN_PARMS];
 
     // client known data for deltas
     i32 old_frags;
+
+    // bandwidth, see SV_SendClientDatagram
+    i32 rate;          // bytes per second the client asked for, 0 for any
+    double cleartime;  // when the link has drained what was sent
+    i32 chokecount;    // datagrams held back to stay under the rate
+    i32 ratebytes;     // sent since ratetime
+    double ratetime;
+    i32 bytespersec;   // measured over the last second
 } client_t;
 
 
@@ -213,6 +222,12 @@ void SV_SetIdealPitch(void);
 void SV_AddUpdates(void);
 
 void SV_ClientThink(void);
+void SV_FrictionVelocity(vec3_t vel, float friction, double frametime);
+void SV_AccelerateVelocity(vec3_t vel, vec3_t dir, float speed, double frametime);
+void SV_AirAccelerateVelocity(vec3_t vel, vec3_t wishveloc, float speed,
+                              double frametime);
+
+i32 ClipVelocity(vec3_t in, vec3_t normal, vec3_t out, float overbounce);
 
 void SV_ClientPrintf(char* fmt, ...);
 void SV_BroadcastPrintf(char* fmt, ...);
@@ -231,4 +246,17 @@ void SV_RunClients(void);
 void SV_SaveSpawnparms();
 void SV_SpawnServer(char* server);
 
+i32 SV_ClientRate(const client_t* client);
+// Bytes per second the server sends the client, 0 if unlimited.
+
+void SV_LagInit(void);
+void SV_LagClear(void);
+void SV_LagClearClient(i32 clientnum);
+void SV_LagRecord(void);
+void SV_LagBegin(client_t* client);
+void SV_LagRewind(void);
+void SV_LagEnd(void);
+// Lag compensation: while a client's PlayerPostThink runs, tracelines see
+// the other players where that client saw them.
+
 #endif
@@ -0,0 +1,309 @@
+/*
+ * Copyright (C) 1996-1997 Id Software, Inc.
+ * Copyright (C) Henrique Barateli, <henriquejb194@gmail.com>, et al.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+// sv_lag.c -- rewinds players for the traces of lagged clients
+
+
+#include "server.h"
+#include "cmd.h"
+#include "console.h"
+#include "sys.h"
+#include "world.h"
+
+
+/*
+
+Every server frame the player origins are stored in a short ring.
+While a client runs its PlayerPostThink, which is where the QuakeC fires
+its weapons, the first traceline moves the other players back to where
+that client saw them, and they are put back once the think is done.
+
+The client's view time is the server time stamp it echoes in each move,
+so a rewind never reaches past what the client was actually shown.
+
+*/
+
+// 32 frames at 72 fps, a little under half a second.
+#define LAG_FRAMES 32
+
+// Players that moved further than this between two frames teleported
+// or respawned, and are not interpolated.
+#define LAG_MAXSTEP 128
+
+typedef struct {
+    double time;
+    qboolean valid[MAX_SCOREBOARD];
+    vec3_t origin[MAX_SCOREBOARD];
+} lagframe_t;
+
+cvar_t sv_lagcomp = {"sv_lagcomp", "0", false, true};
+cvar_t sv_lagcomp_max = {"sv_lagcomp_max", "0.25"};
+
+static lagframe_t lagframes[LAG_FRAMES];
+static i32 lagcount; // total frames recorded, index is lagcount % LAG_FRAMES
+
+// The client whose think is running, and the players moved for it.
+static client_t* lag_client;
+static qboolean lag_rewound;
+static i32 lag_nummoved;
+static edict_t* lag_moved[MAX_SCOREBOARD];
+static vec3_t lag_saved[MAX_SCOREBOARD];
+static vec3_t lag_placed[MAX_SCOREBOARD];
+
+// Statistic Counters
+static i32 lag_rewinds = 0;
+static i32 lag_playersmoved = 0;
+static i32 lag_restoreskips = 0;
+static double lag_depth = 0;
+static double lag_statstime = 0;
+
+
+/*
+================
+SV_LagClear
+
+Forgets the history, on a new level.
+================
+*/
+void SV_LagClear(void) {
+    Q_memset(lagframes, 0, sizeof(lagframes));
+    lagcount = 0;
+    lag_client = NULL;
+    lag_rewound = false;
+}
+
+
+/*
+================
+SV_LagClearClient
+
+Forgets one player, so a new client in the slot isn't rewound
+to where the previous one stood.
+================
+*/
+void SV_LagClearClient(i32 clientnum) {
+    for (i32 i = 0; i < LAG_FRAMES; i++) {
+        lagframes[i].valid[clientnum] = false;
+    }
+}
+
+
+/*
+================
+SV_LagRecord
+
+Stores the player origins as they are sent out for this frame.
+================
+*/
+void SV_LagRecord(void) {
+    if (!sv_lagcomp.value) {
+        return;
+    }
+    lagframe_t* frame = &lagframes[lagcount % LAG_FRAMES];
+    frame->time = sv.time;
+
+    client_t* client = svs.clients;
+    for (i32 i = 0; i < svs.maxclients; i++, client++) {
+        const edict_t* ent = client->edict;
+        frame->valid[i] = client->active && client->spawned && ent &&
+                          !ent->free && ent->v.solid != SOLID_NOT;
+        if (frame->valid[i]) {
+            VectorCopy(ent->v.origin, frame->origin[i]);
+        }
+    }
+    lagcount++;
+}
+
+
+/*
+================
+SV_LagFindOrigin
+
+Finds where player num was at the given time, false if unknown.
+================
+*/
+static qboolean SV_LagFindOrigin(i32 num, double time, vec3_t origin) {
+    const i32 count = lagcount < LAG_FRAMES ? lagcount : LAG_FRAMES;
+
+    // Walk back from the newest frame to the first one at or before time.
+    for (i32 i = 0; i < count - 1; i++) {
+        lagframe_t* newer = &lagframes[(lagcount - 1 - i) % LAG_FRAMES];
+        lagframe_t* older = &lagframes[(lagcount - 2 - i) % LAG_FRAMES];
+        if (older->time > time) {
+            continue;
+        }
+        if (!older->valid[num] || !newer->valid[num]) {
+            return false;
+        }
+
+        vec3_t delta;
+        VectorSubtract(newer->origin[num], older->origin[num], delta);
+        if (Length(delta) > LAG_MAXSTEP) {
+            VectorCopy(older->origin[num], origin);
+            return true;
+        }
+
+        const double span = newer->time - older->time;
+        const float frac = span > 0 ? (float) ((time - older->time) / span) : 1;
+        VectorMA(older->origin[num], frac, delta, origin);
+        return true;
+    }
+    return false;
+}
+
+
+/*
+================
+SV_LagBegin
+
+Called before the client's PlayerPostThink. Nothing moves until the
+QuakeC actually traces.
+================
+*/
+void SV_LagBegin(client_t* client) {
+    lag_client = NULL;
+    lag_rewound = false;
+    if (!sv_lagcomp.value || svs.maxclients == 1 || !client->spawned) {
+        return;
+    }
+    lag_client = client;
+}
+
+
+/*
+================
+SV_LagRewind
+
+Moves the other players back to the current client's view time.
+Called by traceline, only the first call in a think does any work.
+================
+*/
+void SV_LagRewind(void) {
+    if (!lag_client || lag_rewound) {
+        return;
+    }
+    lag_rewound = true;
+    lag_nummoved = 0;
+
+    double time = lag_client->lagtime;
+    if (time < sv.time - sv_lagcomp_max.value) {
+        time = sv.time - sv_lagcomp_max.value;
+    }
+    if (time >= sv.time) {
+        return;
+    }
+
+    client_t* client = svs.clients;
+    for (i32 i = 0; i < svs.maxclients; i++, client++) {
+        if (client == lag_client || !client->active || !client->spawned) {
+            continue;
+        }
+        edict_t* ent = client->edict;
+        if (ent->free || ent->v.solid == SOLID_NOT) {
+            continue;
+        }
+        vec3_t origin;
+        if (!SV_LagFindOrigin(i, time, origin) ||
+            VectorCompare(origin, ent->v.origin)) {
+            continue;
+        }
+        lag_moved[lag_nummoved] = ent;
+        VectorCopy(ent->v.origin, lag_saved[lag_nummoved]);
+        VectorCopy(origin, lag_placed[lag_nummoved]);
+        lag_nummoved++;
+
+        VectorCopy(origin, ent->v.origin);
+        SV_LinkEdict(ent, false);
+    }
+
+    lag_rewinds++;
+    lag_playersmoved += lag_nummoved;
+    lag_depth += sv.time - time;
+}
+
+
+/*
+================
+SV_LagEnd
+
+Puts the rewound players back. A player the QuakeC moved in the
+meantime, by teleporting or respawning it, keeps its new origin.
+================
+*/
+void SV_LagEnd(void) {
+    if (lag_rewound) {
+        for (i32 i = 0; i < lag_nummoved; i++) {
+            edict_t* ent = lag_moved[i];
+            if (ent->free || !VectorCompare(ent->v.origin, lag_placed[i])) {
+                lag_restoreskips++;
+                continue;
+            }
+            VectorCopy(lag_saved[i], ent->v.origin);
+            SV_LinkEdict(ent, false);
+        }
+    }
+    lag_client = NULL;
+    lag_rewound = false;
+    lag_nummoved = 0;
+}
+
+
+/*
+================
+SV_LagStats_f
+================
+*/
+static void SV_LagStats_f(void) {
+    const double now = Sys_FloatTime();
+    const double elapsed = now - lag_statstime;
+
+    Con_Printf("lag compensation %s, %i of %i frames stored\n",
+               sv_lagcomp.value ? "on" : "off",
+               lagcount < LAG_FRAMES ? lagcount : LAG_FRAMES, LAG_FRAMES);
+    if (elapsed > 0) {
+        Con_Printf("%i rewinds in %.1f seconds, %.1f/s\n", lag_rewinds,
+                   elapsed, lag_rewinds / elapsed);
+    }
+    if (lag_rewinds) {
+        Con_Printf("%.1f players moved per rewind, %.0f ms average depth\n",
+                   (double) lag_playersmoved / lag_rewinds,
+                   lag_depth * 1000.0 / lag_rewinds);
+    }
+    Con_Printf("%i players kept where the QuakeC moved them\n",
+               lag_restoreskips);
+
+    lag_rewinds = 0;
+    lag_playersmoved = 0;
+    lag_restoreskips = 0;
+    lag_depth = 0;
+    lag_statstime = now;
+}
+
+
+/*
+================
+SV_LagInit
+================
+*/
+void SV_LagInit(void) {
+    Cvar_RegisterVariable(&sv_lagcomp);
+    Cvar_RegisterVariable(&sv_lagcomp_max);
+    Cmd_AddCommand("sv_lagstats", SV_LagStats_f);
+    lag_statstime = Sys_FloatTime();
+}
@@ -23,6 +23,7 @@
 #include "server.h"
 #include "cmd.h"
 #include "console.h"
+#include "jobs.h"
 #include "sound.h"
 #include "sys.h"
 #include "world.h"
@@ -53,6 +54,7 @@ void SV_Init(void) {
     extern cvar_t sv_accelerate;
     extern cvar_t sv_idealpitchscale;
     extern cvar_t sv_aim;
+    extern cvar_t sv_maxrate;
 
     Cvar_RegisterVariable(&sv_maxvelocity);
     Cvar_RegisterVariable(&sv_gravity);
@@ -64,6 +66,9 @@ void SV_Init(void) {
     Cvar_RegisterVariable(&sv_idealpitchscale);
     Cvar_RegisterVariable(&sv_aim);
     Cvar_RegisterVariable(&sv_nostep);
+    Cvar_RegisterVariable(&sv_maxrate);
+
+    SV_LagInit();
 
     for (i = 0; i < MAX_MODELS; i++)
         sprintf(localmodels[i], "*%i", i);
@@ -267,13 +272,14 @@ void SV_ConnectClient(i32 clientnum) {
         Q_memcpy(spawn_parms, client->spawn_parms, sizeof(spawn_parms));
     Q_memset(client, 0, sizeof(*client));
     client->netconnection = netconnection;
+    SV_LagClearClient(clientnum);
 
     Q_strcpy(client->name, "unconnected");
     client->active = true;
     client->spawned = false;
     client->edict = ent;
     client->message.data = client->msgbuf;
-    client->message.maxsize = sizeof(client->msgbuf);
+    client->message.maxsize = NET_GetMaxMessage(netconnection);
     client->message.allowoverflow = true; // we can catch it
 
     if (sv.loadgame)
@@ -404,18 +410,166 @@ byte* SV_FatPVS(vec3_t org) {
 //=============================================================================
 
 
+#define SV_MINRATE     1000 // bytes per second
+#define SV_RATEPACKETS 20   // datagram size aims for this many a second
+#define SV_MINPACKET   256
+
+cvar_t sv_maxrate = {"sv_maxrate", "0", false, true};
+
+/*
+=============
+SV_ClientRate
+=============
+*/
+i32 SV_ClientRate(const client_t* client) {
+    i32 rate = client->rate;
+    const i32 maxrate = (i32) sv_maxrate.value;
+    if (maxrate > 0 && (rate <= 0 || rate > maxrate)) {
+        rate = maxrate;
+    }
+    if (rate > 0 && rate < SV_MINRATE) {
+        rate = SV_MINRATE;
+    }
+    return rate;
+}
+
+/*
+=============
+SV_RateChoked
+
+True while the client's link is still busy with what was sent before.
+=============
+*/
+static qboolean SV_RateChoked(const client_t* client) {
+    return SV_ClientRate(client) && client->cleartime > realtime;
+}
+
+/*
+=============
+SV_RateSent
+=============
+*/
+static void SV_RateSent(client_t* client, const i32 bytes) {
+    client->ratebytes += bytes;
+    if (realtime - client->ratetime >= 1.0) {
+        client->bytespersec = (i32) (client->ratebytes / (realtime - client->ratetime));
+        client->ratebytes = 0;
+        client->ratetime = realtime;
+    }
+
+    const i32 rate = SV_ClientRate(client);
+    if (rate) {
+        if (client->cleartime < realtime) {
+            client->cleartime = realtime;
+        }
+        client->cleartime += (double) bytes / rate;
+    }
+}
+
+/*
+=============
+SV_EntityUpdateBits
+=============
+*/
+static i32 SV_EntityUpdateBits(const edict_t* ent, const i32 e) {
+    i32 i;
+    float miss;
+    i32 bits = 0;
+
+    for (i = 0; i < 3; i++) {
+        miss = ent->v.origin[i] - ent->baseline.origin[i];
+        if (miss < -0.1 || miss > 0.1)
+            bits |= U_ORIGIN1 << i;
+    }
+
+    if (ent->v.angles[0] != ent->baseline.angles[0])
+        bits |= U_ANGLE1;
+
+    if (ent->v.angles[1] != ent->baseline.angles[1])
+        bits |= U_ANGLE2;
+
+    if (ent->v.angles[2] != ent->baseline.angles[2])
+        bits |= U_ANGLE3;
+
+    if (ent->v.movetype == MOVETYPE_STEP)
+        bits |= U_NOLERP; // don't mess up the step animation
+
+    if (ent->baseline.colormap != ent->v.colormap)
+        bits |= U_COLORMAP;
+
+    if (ent->baseline.skin != ent->v.skin)
+        bits |= U_SKIN;
+
+    if (ent->baseline.frame != ent->v.frame)
+        bits |= U_FRAME;
+
+    if (ent->baseline.effects != ent->v.effects)
+        bits |= U_EFFECTS;
+
+    if (ent->baseline.modelindex != ent->v.modelindex)
+        bits |= U_MODEL;
+
+    if (e >= 256)
+        bits |= U_LONGENTITY;
+
+    if (bits >= 256)
+        bits |= U_MOREBITS;
+
+    return bits;
+}
+
+/*
+=============
+SV_WriteEntityUpdate
+=============
+*/
+static void SV_WriteEntityUpdate(sizebuf_t* msg, const edict_t* ent, const i32 e,
+                                 const i32 bits) {
+    MSG_WriteByte(msg, bits | U_SIGNAL);
+
+    if (bits & U_MOREBITS)
+        MSG_WriteByte(msg, bits >> 8);
+    if (bits & U_LONGENTITY)
+        MSG_WriteShort(msg, e);
+    else
+        MSG_WriteByte(msg, e);
+
+    if (bits & U_MODEL)
+        MSG_WriteByte(msg, ent->v.modelindex);
+    if (bits & U_FRAME)
+        MSG_WriteByte(msg, ent->v.frame);
+    if (bits & U_COLORMAP)
+        MSG_WriteByte(msg, ent->v.colormap);
+    if (bits & U_SKIN)
+        MSG_WriteByte(msg, ent->v.skin);
+    if (bits & U_EFFECTS)
+        MSG_WriteByte(msg, ent->v.effects);
+    if (bits & U_ORIGIN1)
+        MSG_WriteCoord(msg, ent->v.origin[0]);
+    if (bits & U_ANGLE1)
+        MSG_WriteAngle(msg, ent->v.angles[0]);
+    if (bits & U_ORIGIN2)
+        MSG_WriteCoord(msg, ent->v.origin[1]);
+    if (bits & U_ANGLE2)
+        MSG_WriteAngle(msg, ent->v.angles[1]);
+    if (bits & U_ORIGIN3)
+        MSG_WriteCoord(msg, ent->v.origin[2]);
+    if (bits & U_ANGLE3)
+        MSG_WriteAngle(msg, ent->v.angles[2]);
+}
+
 /*
 =============
 SV_WriteEntitiesToClient
 
+Every visible entity goes in every datagram: the client drops whatever
+a datagram leaves out.
 =============
 */
 void SV_WriteEntitiesToClient(edict_t* clent, sizebuf_t* msg) {
     i32 e, i;
-    i32 bits;
     byte* pvs;
     vec3_t org;
-    float miss;
     edict_t* ent;
 
     // find the client's PVS
@@ -446,82 +600,7 @@ void SV_WriteEntitiesToClient(edict_t* clent, sizebuf_t* msg) {
             return;
         }
 
-        // send an update
-        bits = 0;
-
-        for (i = 0; i < 3; i++) {
-            miss = ent->v.origin[i] - ent->baseline.origin[i];
-            if (miss < -0.1 || miss > 0.1)
-                bits |= U_ORIGIN1 << i;
-        }
-
-        if (ent->v.angles[0] != ent->baseline.angles[0])
-            bits |= U_ANGLE1;
-
-        if (ent->v.angles[1] != ent->baseline.angles[1])
-            bits |= U_ANGLE2;
-
-        if (ent->v.angles[2] != ent->baseline.angles[2])
-            bits |= U_ANGLE3;
-
-        if (ent->v.movetype == MOVETYPE_STEP)
-            bits |= U_NOLERP; // don't mess up the step animation
-
-        if (ent->baseline.colormap != ent->v.colormap)
-            bits |= U_COLORMAP;
-
-        if (ent->baseline.skin != ent->v.skin)
-            bits |= U_SKIN;
-
-        if (ent->baseline.frame != ent->v.frame)
-            bits |= U_FRAME;
-
-        if (ent->baseline.effects != ent->v.effects)
-            bits |= U_EFFECTS;
-
-        if (ent->baseline.modelindex != ent->v.modelindex)
-            bits |= U_MODEL;
-
-        if (e >= 256)
-            bits |= U_LONGENTITY;
-
-        if (bits >= 256)
-            bits |= U_MOREBITS;
-
-        //
-        // write the message
-        //
-        MSG_WriteByte(msg, bits | U_SIGNAL);
-
-        if (bits & U_MOREBITS)
-            MSG_WriteByte(msg, bits >> 8);
-        if (bits & U_LONGENTITY)
-            MSG_WriteShort(msg, e);
-        else
-            MSG_WriteByte(msg, e);
-
-        if (bits & U_MODEL)
-            MSG_WriteByte(msg, ent->v.modelindex);
-        if (bits & U_FRAME)
-            MSG_WriteByte(msg, ent->v.frame);
-        if (bits & U_COLORMAP)
-            MSG_WriteByte(msg, ent->v.colormap);
-        if (bits & U_SKIN)
-            MSG_WriteByte(msg, ent->v.skin);
-        if (bits & U_EFFECTS)
-            MSG_WriteByte(msg, ent->v.effects);
-        if (bits & U_ORIGIN1)
-            MSG_WriteCoord(msg, ent->v.origin[0]);
-        if (bits & U_ANGLE1)
-            MSG_WriteAngle(msg, ent->v.angles[0]);
-        if (bits & U_ORIGIN2)
-            MSG_WriteCoord(msg, ent->v.origin[1]);
-        if (bits & U_ANGLE2)
-            MSG_WriteAngle(msg, ent->v.angles[1]);
-        if (bits & U_ORIGIN3)
-            MSG_WriteCoord(msg, ent->v.origin[2]);
-        if (bits & U_ANGLE3)
-            MSG_WriteAngle(msg, ent->v.angles[2]);
+        SV_WriteEntityUpdate(msg, ent, e, SV_EntityUpdateBits(ent, e));
     }
 }
 
@@ -678,13 +757,30 @@ SV_SendClientDatagram
 =======================
 */
 qboolean SV_SendClientDatagram(client_t* client) {
-    byte buf[MAX_DATAGRAM];
+    byte buf[MAX_DATAGRAM_EXT];
     sizebuf_t msg;
 
+    if (SV_RateChoked(client)) {
+        client->chokecount++;
+        return true;
+    }
+
     msg.data = buf;
-    msg.maxsize = sizeof(buf);
+    msg.maxsize = NET_GetMaxDatagram(client->netconnection);
     msg.cursize = 0;
 
+    // aim for a steady stream of small datagrams on a slow link. The
+    // entities can't be split across datagrams, so a bigger one is sent
+    // whole and holds back the ones after it for longer instead.
+    i32 budget = msg.maxsize;
+    const i32 rate = SV_ClientRate(client);
+    if (rate) {
+        const i32 size = rate / SV_RATEPACKETS;
+        if (size < budget) {
+            budget = size > SV_MINPACKET ? size : SV_MINPACKET;
+        }
+    }
+
     MSG_WriteByte(&msg, svc_time);
     MSG_WriteFloat(&msg, sv.time);
 
@@ -694,7 +790,7 @@ qboolean SV_SendClientDatagram(client_t* client) {
     SV_WriteEntitiesToClient(client->edict, &msg);
 
     // copy the server datagram if there is space
-    if (msg.cursize + sv.datagram.cursize < msg.maxsize)
+    if (msg.cursize + sv.datagram.cursize < budget)
         SZ_Write(&msg, sv.datagram.data, sv.datagram.cursize);
 
     // send the datagram
@@ -702,6 +798,7 @@ qboolean SV_SendClientDatagram(client_t* client) {
         SV_DropClient(true); // if the message couldn't send, kick off
         return false;
     }
+    SV_RateSent(client, msg.cursize);
 
     return true;
 }
@@ -774,6 +871,9 @@ SV_SendClientMessages
 void SV_SendClientMessages(void) {
     i32 i;
 
+    // hold back the packets and send them all at the end
+    NET_BeginBatch();
+
     // update frags, names, etc
     SV_UpdateToReliableMessages();
 
@@ -821,6 +921,7 @@ void SV_SendClientMessages(void) {
                                     &host_client->message) == -1)
                     SV_DropClient(
                         true); // if the message couldn't send, kick off
+                SV_RateSent(host_client, host_client->message.cursize);
                 SZ_Clear(&host_client->message);
                 host_client->last_message = realtime;
                 host_client->sendsignon = false;
@@ -829,6 +930,8 @@ void SV_SendClientMessages(void) {
     }
 
 
+    NET_FlushBatch();
+
     // clear muzzle flashes
     SV_CleanupEnts();
 }
@@ -976,6 +1079,7 @@ This is called at the start of each level
 extern float scr_centertime_off;
 
 void SV_SpawnServer(char* server) {
+    static jobgroup_t precache_jobs;
     edict_t* ent;
     i32 i;
 
@@ -1013,6 +1117,7 @@ void SV_SpawnServer(char* server) {
     Host_ClearMemory();
 
     Q_memset(&sv, 0, sizeof(sv));
+    SV_LagClear();
 
     Q_strcpy(sv.name, server);
 
@@ -1093,7 +1198,13 @@ void SV_SpawnServer(char* server) {
     // serverflags are for cross level information (sigils)
     pr_global_struct->serverflags = svs.serverflags;
 
+    // alias models precached by the spawn functions are decoded on the
+    // job threads while the rest of the entities are parsed
+    Jobs_Wait(&precache_jobs);
+    Jobs_ClearGroup(&precache_jobs);
+    Mod_BeginPrecaching(&precache_jobs);
     ED_LoadFromFile(sv.worldmodel->entities);
+    Mod_EndPrecaching();
 
     sv.active = true;
 
@@ -912,7 +912,9 @@ void SV_Physics_Client(edict_t* ent, i32 num) {
 
     pr_global_struct->time = sv.time;
     pr_global_struct->self = EDICT_TO_PROG(ent);
+    SV_LagBegin(&svs.clients[num - 1]);
     PR_ExecuteProgram(pr_global_struct->PlayerPostThink);
+    SV_LagEnd();
 }
 
 //============================================================================
@@ -1144,4 +1146,6 @@ void SV_Physics(void) {
         pr_global_struct->force_retouch--;
 
     sv.time += host_frametime;
+
+    SV_LagRecord();
 }
@@ -120,6 +120,31 @@ void SV_SetIdealPitch(void) {
 }
 
 
+/*
+==================
+SV_FrictionVelocity
+
+Ground friction, shared with the client's movement prediction.
+==================
+*/
+void SV_FrictionVelocity(vec3_t vel, float friction, double frametime) {
+    const float speed = sqrt(vel[0] * vel[0] + vel[1] * vel[1]);
+    if (!speed)
+        return;
+
+    const float control = speed < sv_stopspeed.value ? sv_stopspeed.value : speed;
+    float newspeed = speed - frametime * control * friction;
+
+    if (newspeed < 0)
+        newspeed = 0;
+    newspeed /= speed;
+
+    vel[0] = vel[0] * newspeed;
+    vel[1] = vel[1] * newspeed;
+    vel[2] = vel[2] * newspeed;
+}
+
+
 /*
 ==================
 SV_UserFriction
@@ -128,7 +153,7 @@ SV_UserFriction
 */
 void SV_UserFriction(void) {
     float* vel;
-    float speed, newspeed, control;
+    float speed;
     vec3_t start, stop;
     float friction;
     trace_t trace;
@@ -152,17 +177,7 @@ void SV_UserFriction(void) {
     else
         friction = sv_friction.value;
 
-    // apply friction
-    control = speed < sv_stopspeed.value ? sv_stopspeed.value : speed;
-    newspeed = speed - host_frametime * control * friction;
-
-    if (newspeed < 0)
-        newspeed = 0;
-    newspeed /= speed;
-
-    vel[0] = vel[0] * newspeed;
-    vel[1] = vel[1] * newspeed;
-    vel[2] = vel[2] * newspeed;
+    SV_FrictionVelocity(vel, friction, host_frametime);
 }
 
 /*
@@ -192,40 +207,51 @@ void SV_Accelerate(vec3_t wishvel) {
         velocity[i] += accelspeed * pushvec[i];
 }
 #endif
-void SV_Accelerate(void) {
+// The Velocity variants take the state explicitly, so the client's
+// movement prediction runs the same math.
+void SV_AccelerateVelocity(vec3_t vel, vec3_t dir, float speed, double frametime) {
     i32 i;
     float addspeed, accelspeed, currentspeed;
 
-    currentspeed = DotProduct(velocity, wishdir);
-    addspeed = wishspeed - currentspeed;
+    currentspeed = DotProduct(vel, dir);
+    addspeed = speed - currentspeed;
     if (addspeed <= 0)
         return;
-    accelspeed = sv_accelerate.value * host_frametime * wishspeed;
+    accelspeed = sv_accelerate.value * frametime * speed;
     if (accelspeed > addspeed)
         accelspeed = addspeed;
 
     for (i = 0; i < 3; i++)
-        velocity[i] += accelspeed * wishdir[i];
+        vel[i] += accelspeed * dir[i];
 }
 
-void SV_AirAccelerate(vec3_t wishveloc) {
+void SV_AirAccelerateVelocity(vec3_t vel, vec3_t wishveloc, float speed,
+                              double frametime) {
     i32 i;
     float addspeed, wishspd, accelspeed, currentspeed;
 
     wishspd = VectorNormalize(wishveloc);
     if (wishspd > 30)
         wishspd = 30;
-    currentspeed = DotProduct(velocity, wishveloc);
+    currentspeed = DotProduct(vel, wishveloc);
     addspeed = wishspd - currentspeed;
     if (addspeed <= 0)
         return;
     //	accelspeed = sv_accelerate.value * host_frametime;
-    accelspeed = sv_accelerate.value * wishspeed * host_frametime;
+    accelspeed = sv_accelerate.value * speed * frametime;
     if (accelspeed > addspeed)
         accelspeed = addspeed;
 
     for (i = 0; i < 3; i++)
-        velocity[i] += accelspeed * wishveloc[i];
+        vel[i] += accelspeed * wishveloc[i];
+}
+
+void SV_Accelerate(void) {
+    SV_AccelerateVelocity(velocity, wishdir, wishspeed, host_frametime);
+}
+
+void SV_AirAccelerate(vec3_t wishveloc) {
+    SV_AirAccelerateVelocity(velocity, wishveloc, wishspeed, host_frametime);
 }
 
 
@@ -425,8 +451,9 @@ void SV_ReadClientMove(usercmd_t* move) {
     i32 bits;
 
     // read ping time
+    host_client->lagtime = MSG_ReadFloat();
     host_client->ping_times[host_client->num_pings % NUM_PING_TIMES] =
-        sv.time - MSG_ReadFloat();
+        sv.time - host_client->lagtime;
     host_client->num_pings++;
 
     // read current angles
@@ -520,6 +547,8 @@ qboolean SV_ReadClientMessage(void) {
                         ret = 1;
                     else if (Q_strncasecmp(s, "color", 5) == 0)
                         ret = 1;
+                    else if (Q_strncasecmp(s, "rate", 4) == 0)
+                        ret = 1;
                     else if (Q_strncasecmp(s, "kill", 4) == 0)
                         ret = 1;
                     else if (Q_strncasecmp(s, "pause", 5) == 0)
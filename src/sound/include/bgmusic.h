@@ -31,5 +31,6 @@ void BGMusic_Pause(void);
 void BGMusic_Resume(void);
 void BGMusic_Shutdown(void);
 void BGMusic_Update(void);
+i32 BGMusic_DecodeTime(void); // microseconds per second
 
 #endif
@@ -24,6 +24,7 @@
 
 #include "quakedef.h"
 #include "cvar.h"
+#include "jobs.h"
 #include "mathlib.h"
 #include "zone.h"
 
@@ -37,11 +38,6 @@ typedef struct {
     i32 right;
 } portable_samplepair_t;
 
-typedef struct sfx_s {
-    char name[MAX_QPATH];
-    cache_user_t cache;
-} sfx_t;
-
 // !!! if this is changed, it much be changed in asm_i386.h too !!!
 typedef struct {
     i32 length;
@@ -52,6 +48,13 @@ typedef struct {
     byte data[1]; // variable sized
 } sfxcache_t;
 
+typedef struct sfx_s {
+    char name[MAX_QPATH];
+    cache_user_t cache;
+    qboolean streamed;     // too big to cache, see snd_streamsize
+    sfxcache_t streaminfo; // the file's header, no data
+} sfx_t;
+
 typedef struct {
     qboolean gamealive;
     qboolean soundalive;
@@ -105,13 +108,15 @@ void S_ExtraUpdate(void);
 sfx_t* S_PrecacheSound(char* sample);
 void S_TouchSound(char* sample);
 void S_ClearPrecache(void);
-void S_BeginPrecaching(void);
+void S_BeginPrecaching(jobgroup_t* jobs);
 void S_EndPrecaching(void);
 void S_PaintChannels(i32 endtime);
 void S_InitPaintChannels(void);
+void S_InitResampler(void);
+void S_UpdateResampleCache(void);
 
 // picks a channel based on priorities, empty slots, number of channels
-channel_t* SND_PickChannel(i32 entnum, i32 entchannel);
+channel_t* SND_PickChannel(i32 entnum, i32 entchannel, i32 priority);
 
 // spatializes a channel
 void SND_Spatialize(channel_t* ch);
@@ -132,14 +137,14 @@ void SNDDMA_Shutdown(void);
 // User-setable variables
 // ====================================================================
 
-#define MAX_CHANNELS         128
-#define MAX_DYNAMIC_CHANNELS 8
+#define MAX_CHANNELS         256
+#define MAX_DYNAMIC_CHANNELS 64 // snd_dynamicvoices of them are used
 #define MAX_RAW_SAMPLES      8192
 
 
 extern channel_t channels[MAX_CHANNELS];
-// 0 to MAX_DYNAMIC_CHANNELS-1	= normal entity sounds
-// MAX_DYNAMIC_CHANNELS to MAX_DYNAMIC_CHANNELS + NUM_AMBIENTS -1 = water, etc
+// 0 to NUM_AMBIENTS - 1 = water, etc
+// NUM_AMBIENTS to NUM_AMBIENTS + MAX_DYNAMIC_CHANNELS - 1 = normal entity sounds
 // MAX_DYNAMIC_CHANNELS + NUM_AMBIENTS to total_channels = static sounds
 
 extern i32 total_channels;
@@ -152,8 +157,8 @@ extern i32 total_channels;
 
 extern qboolean fakedma;
 extern i32 fakedma_updates;
-extern i32 paintedtime;
-extern i32 s_rawend;
+extern volatile i32 paintedtime; // written by the mixer
+extern volatile i32 s_rawend;    // written by the game thread
 extern portable_samplepair_t s_rawsamples[MAX_RAW_SAMPLES];
 extern vec3_t listener_origin;
 extern vec3_t listener_forward;
@@ -168,6 +173,8 @@ extern cvar_t snd_mixspeed;
 extern cvar_t snd_filterquality;
 //extern cvar_t sfxvolume;
 extern cvar_t loadas8bit;
+extern cvar_t snd_resamplecache;
+extern cvar_t snd_streamsize;
 extern cvar_t bgmvolume;
 extern cvar_t sfxvolume;
 extern channel_t snd_channels[MAX_CHANNELS];
@@ -178,6 +185,7 @@ extern i32 snd_blocked;
 
 void S_LocalSound(char* s);
 sfxcache_t* S_LoadSound(sfx_t* s);
+qboolean S_QueueLoadSound(sfx_t* s);
 
 wavinfo_t GetWavinfo(char* name, byte* wav, i32 wavlength);
 
@@ -25,7 +25,11 @@
 #include "console.h"
 #include "snd_codec.h"
 #include "sound.h"
+#include <SDL_atomic.h>
+#include <SDL_mutex.h>
 #include <SDL_stdinc.h>
+#include <SDL_thread.h>
+#include <SDL_timer.h>
 
 
 #define MUSIC_DIRNAME "music"
@@ -72,6 +76,193 @@ static float cdvolume;
 static byte remap[100];
 
 
+/*
+===============================================================================
+
+DECODE THREAD
+
+The stream is decoded ahead on its own thread into music_ring, in the
+file's format, and rewound there when looping so the loop has no gap.
+BGMusic_UpdateStream only moves samples from the ring to S_RawSamples.
+Without the thread (-nosoundthread) the ring is filled from
+BGMusic_UpdateStream instead.
+
+===============================================================================
+*/
+
+#define MUSIC_RING_SIZE (1 << 18) // bytes, 1.5s of 16 bit stereo at 44.1kHz
+#define DECODE_PERIOD   50        // ms the decoder sleeps on a full ring
+
+typedef enum {
+    DECODE_RUNNING,
+    DECODE_FINISHED, // at the end of a track that doesn't loop
+    DECODE_FAILED
+} decodestatus_t;
+
+// The decoder only writes ring_write, the main thread only ring_read.
+static byte music_ring[MUSIC_RING_SIZE];
+static i32 ring_read;
+static i32 ring_write;
+static SDL_atomic_t ring_used; // bytes
+
+static SDL_Thread* decode_thread;
+static SDL_sem* decode_wake;
+static SDL_atomic_t decode_quit;
+static SDL_atomic_t decode_status;
+static qboolean decode_loop;
+static qboolean did_rewind;
+static byte decode_buffer[16384];
+
+static byte raw_audio_buffer[16384];
+
+// Statistic Counters
+static u64 decode_ticks;         // spent decoding since decode_second
+static u64 decode_second;        // start of the second being counted
+static SDL_atomic_t decode_usec; // spent decoding over the last second
+
+
+static void BGMusic_WriteRing(const byte* data, i32 size) {
+    const i32 first = SDL_min(size, MUSIC_RING_SIZE - ring_write);
+    Q_memcpy(music_ring + ring_write, data, first);
+    Q_memcpy(music_ring, data + first, size - first);
+    ring_write = (ring_write + size) & (MUSIC_RING_SIZE - 1);
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicAdd(&ring_used, size);
+}
+
+static i32 BGMusic_ReadRing(byte* data, i32 size) {
+    size = SDL_min(size, SDL_AtomicGet(&ring_used));
+    SDL_MemoryBarrierAcquire();
+
+    const i32 first = SDL_min(size, MUSIC_RING_SIZE - ring_read);
+    Q_memcpy(data, music_ring + ring_read, first);
+    Q_memcpy(data + first, music_ring, size - first);
+    ring_read = (ring_read + size) & (MUSIC_RING_SIZE - 1);
+    SDL_AtomicAdd(&ring_used, -size);
+    return size;
+}
+
+static qboolean BGMusic_EndOfFile() {
+    if (!decode_loop) {
+        return false;
+    }
+    // Try to loop music.
+    if (did_rewind) {
+        Con_Printf("Stream keeps returning EOF.\n");
+        return false;
+    }
+    i32 rewind_res = S_CodecRewindStream(bgmstream);
+    if (rewind_res != 0) {
+        Con_Printf("Stream seek error (%i), stopping.\n", rewind_res);
+        return false;
+    }
+    did_rewind = true;
+    return true;
+}
+
+/*
+=================
+BGMusic_Decode
+
+Decodes one buffer into the ring, which must have room for it.
+=================
+*/
+static void BGMusic_Decode(void) {
+    const snd_info_t* info = &bgmstream->info;
+    const i32 frame_size = info->width * info->channels;
+    const i32 size = sizeof(decode_buffer) / frame_size * frame_size;
+
+    i32 bytes_read = S_CodecReadStream(bgmstream, size, decode_buffer);
+    if (bytes_read > 0) {
+        // Data: add to the ring, in whole frames.
+        BGMusic_WriteRing(decode_buffer, bytes_read - bytes_read % frame_size);
+        did_rewind = false;
+        return;
+    }
+    if (bytes_read == 0) {
+        if (!BGMusic_EndOfFile()) {
+            SDL_AtomicSet(&decode_status, DECODE_FINISHED);
+        }
+        return;
+    }
+    // Some read error.
+    Con_Printf("Stream read error (%i), stopping.\n", bytes_read);
+    SDL_AtomicSet(&decode_status, DECODE_FAILED);
+}
+
+static void BGMusic_CountDecodeTime(void) {
+    const u64 now = SDL_GetPerformanceCounter();
+    if (now - decode_second < SDL_GetPerformanceFrequency()) {
+        return;
+    }
+    const u64 usec = decode_ticks * 1000000 / (now - decode_second);
+    SDL_AtomicSet(&decode_usec, (int) usec);
+    decode_ticks = 0;
+    decode_second = now;
+}
+
+static void BGMusic_FillRing(void) {
+    while (SDL_AtomicGet(&decode_status) == DECODE_RUNNING
+           && !SDL_AtomicGet(&decode_quit)
+           && MUSIC_RING_SIZE - SDL_AtomicGet(&ring_used)
+                  >= (i32) sizeof(decode_buffer)) {
+        const u64 start = SDL_GetPerformanceCounter();
+        BGMusic_Decode();
+        decode_ticks += SDL_GetPerformanceCounter() - start;
+    }
+    BGMusic_CountDecodeTime();
+}
+
+static int BGMusic_DecodeThread(void* unused) {
+    while (!SDL_AtomicGet(&decode_quit)) {
+        BGMusic_FillRing();
+        SDL_SemWaitTimeout(decode_wake, DECODE_PERIOD);
+    }
+    return 0;
+}
+
+static void BGMusic_StartDecoder(qboolean looping) {
+    ring_read = ring_write = 0;
+    SDL_AtomicSet(&ring_used, 0);
+    SDL_AtomicSet(&decode_status, DECODE_RUNNING);
+    SDL_AtomicSet(&decode_quit, 0);
+    decode_loop = looping;
+    did_rewind = false;
+    decode_ticks = 0;
+    decode_second = SDL_GetPerformanceCounter();
+
+    if (!decode_wake) {
+        return;
+    }
+    decode_thread = SDL_CreateThread(BGMusic_DecodeThread, "bgmusic", NULL);
+    if (!decode_thread) {
+        Con_DPrintf("Decoding music on the main thread: %s\n",
+                    SDL_GetError());
+    }
+}
+
+static void BGMusic_StopDecoder(void) {
+    if (decode_thread) {
+        SDL_AtomicSet(&decode_quit, 1);
+        SDL_SemPost(decode_wake);
+        SDL_WaitThread(decode_thread, NULL);
+        decode_thread = NULL;
+    }
+    SDL_AtomicSet(&decode_usec, 0);
+}
+
+/*
+=================
+BGMusic_DecodeTime
+
+Microseconds spent decoding music over the last second.
+=================
+*/
+i32 BGMusic_DecodeTime(void) {
+    return SDL_AtomicGet(&decode_usec);
+}
+
+
 static void CD_f(void) {
     char* command;
     i32 ret;
@@ -216,6 +407,8 @@ void BGMusic_Play(byte track, qboolean looping) {
     bgmstream = S_CodecOpenStreamType(tmp, type, playLooping);
     if (!bgmstream) {
         Con_Printf("Couldn't handle music file %s\n", tmp);
+    } else {
+        BGMusic_StartDecoder(looping);
     }
 
     playLooping = looping;
@@ -235,6 +428,7 @@ void BGMusic_Stop() {
     if (!playing) {
         return;
     }
+    BGMusic_StopDecoder();
     bgmstream->status = STREAM_NONE;
     S_CodecCloseStream(bgmstream);
     bgmstream = NULL;
@@ -287,6 +481,10 @@ i32 BGMusic_Init() {
     Cmd_AddCommand("cd", CD_f);
     Con_Printf("CD Audio Initialized\n");
 
+    if (!COM_CheckParm("-nosoundthread")) {
+        decode_wake = SDL_CreateSemaphore(0);
+    }
+
     music_handler_t* handlers = NULL;
     playLooping = true;
 
@@ -316,52 +514,12 @@ void BGMusic_Shutdown() {
     BGMusic_Stop();
     // Sever our connections to midi_drv and snd_codec.
     music_handlers = NULL;
-}
-
-
-static qboolean did_rewind = false;
-static byte raw_audio_buffer[16384];
-
-static qboolean BGMusic_EndOfFile() {
-    if (!playLooping) {
-        return false;
+    if (decode_wake) {
+        SDL_DestroySemaphore(decode_wake);
+        decode_wake = NULL;
     }
-    // Try to loop music.
-    if (did_rewind) {
-        Con_Printf("Stream keeps returning EOF.\n");
-        return false;
-    }
-    i32 rewind_res = S_CodecRewindStream(bgmstream);
-    if (rewind_res != 0) {
-        Con_Printf("Stream seek error (%i), stopping.\n", rewind_res);
-        return false;
-    }
-    did_rewind = true;
-    return true;
 }
 
-static qboolean BGMusic_ReadStream(i32 file_samples, i32 file_size) {
-    const snd_info_t* info = &bgmstream->info;
-
-    i32 bytes_read = S_CodecReadStream(bgmstream, file_size, raw_audio_buffer);
-    if (bytes_read < file_size) {
-        file_samples = bytes_read / (info->width * info->channels);
-    }
-
-    if (bytes_read > 0) {
-        // Data: add to raw buffer.
-        S_RawSamples(file_samples, info->rate, info->width, info->channels,
-                     raw_audio_buffer, bgmvolume.value);
-        did_rewind = false;
-        return true;
-    }
-    if (bytes_read == 0) {
-        return BGMusic_EndOfFile();
-    }
-    // Some read error.
-    Con_Printf("Stream read error (%i), stopping.\n", bytes_read);
-    return false;
-}
 
 static void BGMusic_GetStreamInfo(i32* file_samples, i32* file_size) {
     const snd_info_t* info = &bgmstream->info;
@@ -383,6 +541,8 @@ static void BGMusic_GetStreamInfo(i32* file_samples, i32* file_size) {
 }
 
 static void BGMusic_UpdateStream() {
+    const snd_info_t* info = &bgmstream->info;
+
     if (bgmstream->status != STREAM_PLAY) {
         return;
     }
@@ -391,7 +551,9 @@ static void BGMusic_UpdateStream() {
         return;
     }
 
-    did_rewind = false;
+    if (!decode_thread) {
+        BGMusic_FillRing();
+    }
     if (s_rawend < paintedtime) {
         // See how many samples should be copied into the raw buffer.
         s_rawend = paintedtime;
@@ -401,13 +563,24 @@ static void BGMusic_UpdateStream() {
         i32 file_size;
         BGMusic_GetStreamInfo(&file_samples, &file_size);
         if (!file_samples || !file_size) {
-            return;
+            break;
         }
-        qboolean keep_playing = BGMusic_ReadStream(file_samples, file_size);
-        if (!keep_playing) {
-            BGMusic_Stop();
-            return;
+        i32 bytes = BGMusic_ReadRing(raw_audio_buffer, file_size);
+        if (!bytes) {
+            // The decoder is behind, or done once the ring is empty.
+            if (SDL_AtomicGet(&decode_status) != DECODE_RUNNING
+                && !SDL_AtomicGet(&ring_used)) {
+                BGMusic_Stop();
+                return;
+            }
+            break;
         }
+        S_RawSamples(bytes / (info->width * info->channels), info->rate,
+                     info->width, info->channels, raw_audio_buffer,
+                     bgmvolume.value);
+    }
+    if (decode_thread) {
+        SDL_SemPost(decode_wake);
     }
 }
 
@@ -77,13 +77,7 @@ void S_CodecShutdown() {
     codecs = NULL;
 }
 
-/*
-=================
-S_CodecOpenStream
-=================
-*/
-snd_stream_t* S_CodecOpenStreamType(const char* filename, u32 type,
-                                    qboolean loop) {
+static snd_codec_t* S_CodecFindType(const char* filename, u32 type) {
     if (type == CODECTYPE_NONE) {
         Con_Printf("Bad type for %s\n", filename);
         return NULL;
@@ -100,9 +94,12 @@ snd_stream_t* S_CodecOpenStreamType(const char* filename, u32 type,
         Con_Printf("Unknown type for %s\n", filename);
         return NULL;
     }
-    snd_stream_t* stream = S_CodecUtilOpen(filename, codec, loop);
+    return codec;
+}
+
+static snd_stream_t* S_CodecStartStream(snd_stream_t* stream) {
     if (stream) {
-        if (codec->codec_open(stream)) {
+        if (stream->codec->codec_open(stream)) {
             stream->status = STREAM_PLAY;
         } else {
             S_CodecUtilClose(&stream);
@@ -111,6 +108,44 @@ snd_stream_t* S_CodecOpenStreamType(const char* filename, u32 type,
     return stream;
 }
 
+/*
+=================
+S_CodecOpenStream
+=================
+*/
+snd_stream_t* S_CodecOpenStreamType(const char* filename, u32 type,
+                                    qboolean loop) {
+    snd_codec_t* codec = S_CodecFindType(filename, type);
+    if (!codec) {
+        return NULL;
+    }
+    return S_CodecStartStream(S_CodecUtilOpen(filename, codec, loop));
+}
+
+/*
+=================
+S_CodecOpenSoundType
+=================
+*/
+snd_stream_t* S_CodecOpenSoundType(const char* filename, u32 type,
+                                   qboolean loop) {
+    snd_codec_t* codec = S_CodecFindType(filename, type);
+    if (!codec) {
+        return NULL;
+    }
+
+    FILE* handle;
+    char name[MAX_QPATH];
+    Q_strncpy(name, filename, MAX_QPATH);
+    const long length = COM_FOpenFile(name, &handle);
+    if (length == -1) {
+        Con_DPrintf("Couldn't open %s\n", filename);
+        return NULL;
+    }
+    return S_CodecStartStream(
+        S_CodecUtilOpenFile(filename, codec, handle, length, loop));
+}
+
 void S_CodecCloseStream(snd_stream_t* stream) {
     stream->status = STREAM_NONE;
     stream->codec->codec_close(stream);
@@ -135,7 +170,6 @@ i32 S_CodecReadStream(snd_stream_t* stream, i32 bytes, void* buffer) {
 
 snd_stream_t* S_CodecUtilOpen(const char* filename, snd_codec_t* codec,
                               qboolean loop) {
-    snd_stream_t* stream;
     FILE* handle;
 
     /* Try to open the file */
@@ -145,6 +179,13 @@ snd_stream_t* S_CodecUtilOpen(const char* filename, snd_codec_t* codec,
         return NULL;
     }
 
+    return S_CodecUtilOpenFile(filename, codec, handle, length, loop);
+}
+
+snd_stream_t* S_CodecUtilOpenFile(const char* filename, snd_codec_t* codec,
+                                  FILE* handle, long length, qboolean loop) {
+    snd_stream_t* stream;
+
     /* Allocate a stream, Z_Malloc zeroes its content */
     stream = (snd_stream_t*) Z_Malloc(sizeof(snd_stream_t));
     stream->codec = codec;
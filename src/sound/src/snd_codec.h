@@ -65,6 +65,11 @@ snd_stream_t* S_CodecOpenStreamType(const char* filename, u32 type,
                                     qboolean loop);
 /* Decides according to the required type. */
 
+snd_stream_t* S_CodecOpenSoundType(const char* filename, u32 type,
+                                   qboolean loop);
+/* Like S_CodecOpenStreamType, but the file may also be
+	 * inside a pak file, as game sounds are. */
+
 snd_stream_t* S_CodecOpenStreamAny(const char* filename, qboolean loop);
 /* Decides according to file extension. if the
 	 * name has no extension, try all available. */
@@ -80,6 +85,8 @@ i32 S_CodecJumpToOrder(snd_stream_t* stream, i32 to);
 
 snd_stream_t* S_CodecUtilOpen(const char* filename, snd_codec_t* codec,
                               qboolean loop);
+snd_stream_t* S_CodecUtilOpenFile(const char* filename, snd_codec_t* codec,
+                                  FILE* handle, long length, qboolean loop);
 void S_CodecUtilClose(snd_stream_t** stream);
 
 
@@ -21,13 +21,18 @@
 
 
 #include "sound.h"
+#include "bgmusic.h"
 #include "client.h"
 #include "cmd.h"
 #include "console.h"
 #include "host.h"
 #include "model.h"
 #include "snd_codec.h"
+#include "snd_sfxstream.h"
+#include "snd_thread.h"
 #include "sys.h"
+#include <SDL_stdinc.h>
+#include <math.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -35,8 +40,6 @@
 static void S_Play(void);
 static void S_PlayVol(void);
 static void S_SoundList(void);
-static void S_Update_(void);
-static void GetSoundtime(void);
 void S_StopAllSounds(qboolean clear);
 static void S_StopAllSoundsC(void);
 
@@ -61,10 +64,7 @@ float voicevolumescale = 1; //for audio ducking while speaking
 
 #define sound_nominal_clip_dist 1000.0
 
-i32 soundtime;   // sample PAIRS
-i32 paintedtime; // sample PAIRS
-
-i32 s_rawend;
+volatile i32 s_rawend;
 portable_samplepair_t s_rawsamples[MAX_RAW_SAMPLES];
 
 
@@ -74,11 +74,27 @@ static i32 num_sfx;
 
 static sfx_t* ambient_sfx[NUM_AMBIENTS];
 
+// What the mixer was last told about each channel. A channel is restarted
+// when its serial moves on, even if it plays the same sfx.
+typedef struct {
+    sfx_t* sfx;
+    i32 leftvol;
+    i32 rightvol;
+    i32 serial;
+    qboolean waiting; // for a stream, already reported
+} sentchannel_t;
+
+static sentchannel_t sent[MAX_CHANNELS];
+static i32 serials[MAX_CHANNELS];
+static mixsettings_t sent_settings;
+
+// The mixer's copies of the sound data, by known_sfx index.
+static sfxcache_t* mixdata[MAX_SFX];
+
 static qboolean sound_started = false;
 
 cvar_t bgmvolume = {"bgmvolume", "1", true};
 cvar_t sfxvolume = {"volume", "0.7", true};
-static float old_sfxvolume = -1.0f;
 
 cvar_t precache = {"precache", "1", false};
 cvar_t loadas8bit = {"loadas8bit", "0", false};
@@ -102,6 +118,8 @@ static cvar_t ambient_fade = {"ambient_fade", "100", false};
 static cvar_t snd_noextraupdate = {"snd_noextraupdate", "0", false};
 static cvar_t snd_show = {"snd_show", "0", false};
 static cvar_t _snd_mixahead = {"_snd_mixahead", "0.1", true};
+static cvar_t snd_dynamicvoices = {"snd_dynamicvoices", "32", true};
+static cvar_t snd_occlusion = {"snd_occlusion", "0", true};
 
 
 static void S_SoundInfo_f(void) {
@@ -116,13 +134,15 @@ static void S_SoundInfo_f(void) {
     Con_Printf("%5d samplepos\n", shm->samplepos);
     Con_Printf("%5d submission_chunk\n", shm->submission_chunk);
     Con_Printf("%5d total_channels\n", total_channels);
+    Con_Printf("%5d painted, %d virtual voices\n", snd_paintedvoices,
+               snd_virtualvoices);
+    Con_Printf("%5d of %d sound streams, %d samples underrun\n",
+               S_NumSfxStreams(), MAX_SFX_STREAMS, snd_streamunderruns);
     Con_Printf("%p dma buffer\n", shm->buffer);
-}
-
-
-static void SND_UpdateSfxVolume() {
-    old_sfxvolume = sfxvolume.value;
-    SND_InitScaletable();
+    Con_Printf("mixing on the %s thread\n",
+               S_MixerThreaded() ? "mixer" : "main");
+    S_MixerPrintStats();
+    Con_Printf("%5d us per second decoding music\n", BGMusic_DecodeTime());
 }
 
 static void SND_UpdateFilterQuality() {
@@ -133,6 +153,38 @@ static void SND_UpdateFilterQuality() {
     old_filterquality = snd_filterquality.value;
 }
 
+/*
+================
+S_UpdateMixSettings
+
+Sends the cvars the mixer depends on when they change.
+================
+*/
+static void S_UpdateMixSettings(void) {
+    if (snd_filterquality.value != old_filterquality) {
+        SND_UpdateFilterQuality();
+    }
+
+    mixsettings_t settings;
+    settings.volume = sfxvolume.value;
+    settings.mixahead = _snd_mixahead.value;
+    settings.filterquality = (i32) snd_filterquality.value;
+    settings.lowpass = sndspeed.value == 11025 && shm->speed == 44100;
+    if (settings.volume == sent_settings.volume
+        && settings.mixahead == sent_settings.mixahead
+        && settings.filterquality == sent_settings.filterquality
+        && settings.lowpass == sent_settings.lowpass) {
+        return;
+    }
+    sent_settings = settings;
+
+    mixcmd_t cmd;
+    Q_memset(&cmd, 0, sizeof(cmd));
+    cmd.type = MIX_SETTINGS;
+    cmd.settings = settings;
+    S_MixerCommand(&cmd);
+}
+
 /*
 ================
 S_Startup
@@ -149,8 +201,14 @@ void S_Startup(void) {
     }
     Con_Printf("Audio: %d bit, %s, %d Hz\n", shm->samplebits,
                (shm->channels == 2) ? "stereo" : "mono", shm->speed);
-    GetSoundtime();
-    paintedtime = soundtime;
+
+    S_MixerInit();
+    Q_memset(sent, 0, sizeof(sent));
+    sent_settings.volume = -1.0f;
+    S_UpdateMixSettings();
+    if (S_MixerThreaded()) {
+        Con_Printf("Audio: mixing on a separate thread\n");
+    }
 }
 
 
@@ -175,7 +233,6 @@ static void S_InitVariables() {
         Con_Printf("loading all sounds as 8bit\n");
     }
 
-    SND_UpdateSfxVolume();
     SND_UpdateFilterQuality();
 }
 
@@ -198,6 +255,8 @@ static void S_RegisterConsoleVars(void) {
     Cvar_RegisterVariable(&snd_noextraupdate);
     Cvar_RegisterVariable(&snd_show);
     Cvar_RegisterVariable(&_snd_mixahead);
+    Cvar_RegisterVariable(&snd_dynamicvoices);
+    Cvar_RegisterVariable(&snd_occlusion);
 
     Cvar_RegisterVariable(&sndspeed);
     Cvar_RegisterVariable(&snd_mixspeed);
@@ -221,6 +280,9 @@ void S_Init(void) {
     S_RegisterConsoleVars();
     S_AddCommands();
     S_InitVariables();
+    S_InitPaintChannels();
+    S_InitResampler();
+    S_InitSfxStreams();
     known_sfx = (sfx_t*) Hunk_AllocName(MAX_SFX * sizeof(sfx_t), "sfx_t");
     num_sfx = 0;
     snd_initialized = true;
@@ -248,6 +310,10 @@ void S_Shutdown(void) {
     if (!sound_started)
         return;
 
+    // Hand the sample copies back before the mixer goes away.
+    S_StopAllSounds(false);
+    S_MixerShutdown();
+
     sound_started = 0;
     snd_blocked = 0;
 
@@ -328,15 +394,82 @@ sfx_t* S_PrecacheSound(char* name) {
     sfx = S_FindName(name);
 
     // cache it in
-    if (precache.value)
+    if (precache.value && !S_QueueLoadSound(sfx))
         S_LoadSound(sfx);
 
     return sfx;
 }
 
+/*
+==================
+S_MixerData
+
+Returns the mixer's copy of the sound, making it on first use.
+The copy stays until S_StopAllSounds gives it back.
+==================
+*/
+static sfxcache_t* S_MixerData(sfx_t* sfx) {
+    const i32 num = sfx - known_sfx;
+    if (mixdata[num]) {
+        return mixdata[num];
+    }
+
+    const sfxcache_t* sc = S_LoadSound(sfx);
+    if (sfx->streamed) {
+        // only the header, the voices read from their own streams
+        mixdata[num] = Q_malloc(sizeof(sfxcache_t));
+        if (!mixdata[num]) {
+            Con_Printf("S_MixerData: out of memory for %s\n", sfx->name);
+            return NULL;
+        }
+        S_SfxStreamInfo(sfx, mixdata[num]);
+        return mixdata[num];
+    }
+    if (!sc) {
+        return NULL;
+    }
+    const size_t size =
+        sizeof(sfxcache_t) + sc->length * sc->width * (sc->stereo + 1);
+    mixdata[num] = Q_malloc(size);
+    if (!mixdata[num]) {
+        Con_Printf("S_MixerData: out of memory for %s\n", sfx->name);
+        return NULL;
+    }
+    Q_memcpy(mixdata[num], sc, size);
+    return mixdata[num];
+}
+
 
 //=============================================================================
 
+static i32 S_DynamicVoices(void) {
+    const i32 count = (i32) snd_dynamicvoices.value;
+    if (count < 8)
+        return 8;
+    if (count > MAX_DYNAMIC_CHANNELS)
+        return MAX_DYNAMIC_CHANNELS;
+    return count;
+}
+
+/*
+=================
+S_ChannelPriority
+
+What a spatialized channel is worth keeping: the player's own sounds above
+all, then sounds on an entity channel, then the loudest.
+=================
+*/
+static i32 S_ChannelPriority(const channel_t* ch) {
+    i32 priority = ch->leftvol > ch->rightvol ? ch->leftvol : ch->rightvol;
+    if (priority > 255)
+        priority = 255;
+    if (ch->entnum == cl.viewentity)
+        priority += 512;
+    if (ch->entchannel != 0)
+        priority += 32;
+    return priority;
+}
+
 /*
 =================
 SND_PickChannel
@@ -344,31 +477,35 @@ SND_PickChannel
 picks a channel based on priorities, empty slots, number of channels
 =================
 */
-channel_t* SND_PickChannel(i32 entnum, i32 entchannel) {
+channel_t* SND_PickChannel(i32 entnum, i32 entchannel, i32 priority) {
     i32 ch_idx;
     i32 first_to_die;
     i32 life_left;
+    i32 lowest;
+    const i32 last = NUM_AMBIENTS + S_DynamicVoices();
 
-    // Check for replacement sound, or find the best one to replace
+    // Check for replacement sound, or find the least worth keeping
     first_to_die = -1;
     life_left = 0x7fffffff;
-    for (ch_idx = NUM_AMBIENTS; ch_idx < NUM_AMBIENTS + MAX_DYNAMIC_CHANNELS; ch_idx++) {
+    lowest = 0x7fffffff;
+    for (ch_idx = NUM_AMBIENTS; ch_idx < last; ch_idx++) {
+        const channel_t* ch = &snd_channels[ch_idx];
         if (entchannel != 0 // channel 0 never overrides
-            && snd_channels[ch_idx].entnum == entnum
-            && (snd_channels[ch_idx].entchannel == entchannel || entchannel == -1))
+            && ch->entnum == entnum
+            && (ch->entchannel == entchannel || entchannel == -1))
         { // always override sound from same entity
             first_to_die = ch_idx;
+            lowest = -1;
             break;
         }
 
-        // don't let monster sounds override player sounds
-        if (snd_channels[ch_idx].entnum == cl.viewentity
-            && entnum != cl.viewentity
-            && snd_channels[ch_idx].sfx)
-            continue;
-
-        if (snd_channels[ch_idx].end - paintedtime < life_left) {
-            life_left = snd_channels[ch_idx].end - paintedtime;
+        // a free channel is worth nothing, among equals the one
+        // closest to its end goes first
+        const i32 ch_priority = ch->sfx ? S_ChannelPriority(ch) : -1;
+        if (ch_priority < lowest
+            || (ch_priority == lowest && ch->end - paintedtime < life_left)) {
+            lowest = ch_priority;
+            life_left = ch->end - paintedtime;
             first_to_die = ch_idx;
         }
     }
@@ -376,60 +513,214 @@ channel_t* SND_PickChannel(i32 entnum, i32 entchannel) {
     if (first_to_die == -1)
         return NULL;
 
+    // everything playing matters more, don't steal
+    if (lowest > priority)
+        return NULL;
+
     if (snd_channels[first_to_die].sfx)
         snd_channels[first_to_die].sfx = NULL;
 
     return &snd_channels[first_to_die];
 }
 
+/*
+===============================================================================
+
+SPATIALIZATION
+
+S_Update spatializes every channel in one pass over arrays of their fields,
+a loop without branches that the compiler can vectorize. With snd_occlusion
+set, a sound in a leaf the listener's leaf can't see is turned down by that
+fraction; at 1 it is silent, and so goes virtual.
+
+===============================================================================
+*/
+
+typedef struct {
+    float x[MAX_CHANNELS];
+    float y[MAX_CHANNELS];
+    float z[MAX_CHANNELS];
+    float dist_mult[MAX_CHANNELS];
+    float volume[MAX_CHANNELS]; // master_vol, ducked and occluded
+    i32 left[MAX_CHANNELS];
+    i32 right[MAX_CHANNELS];
+} spatialbatch_t;
+
+static spatialbatch_t batch;
+static channel_t* batch_channels[MAX_CHANNELS];
+
+// What the listener's leaf can see, as of the last S_Update.
+static byte listener_pvs[MAX_MAP_LEAFS / 8];
+static model_t* pvs_model; // NULL when occlusion is off
+
+// The leaf each channel plays in, found again when its serial moves on.
+static mleaf_t* chan_leafs[MAX_CHANNELS];
+static i32 chan_leafserials[MAX_CHANNELS];
+static model_t* chan_leafmodel;
+
+// Statistic Counters
+static i32 snd_occluded; // channels turned down by the last S_Update
+
+
+static void S_UpdateListenerPVS(void) {
+    pvs_model = NULL;
+    if (snd_occlusion.value <= 0 || !cl.worldmodel) {
+        return;
+    }
+    // the row is only good until the next Mod_LeafPVS
+    mleaf_t* leaf = Mod_PointInLeaf(listener_origin, cl.worldmodel);
+    Q_memcpy(listener_pvs, Mod_LeafPVS(leaf, cl.worldmodel),
+             (cl.worldmodel->numleafs + 7) >> 3);
+    pvs_model = cl.worldmodel;
+}
+
+static mleaf_t* S_ChannelLeaf(i32 i) {
+    if (chan_leafmodel != cl.worldmodel) {
+        Q_memset(chan_leafserials, 0, sizeof(chan_leafserials));
+        chan_leafmodel = cl.worldmodel;
+    }
+    if (chan_leafserials[i] != serials[i]) {
+        chan_leafs[i] = Mod_PointInLeaf(snd_channels[i].origin, cl.worldmodel);
+        chan_leafserials[i] = serials[i];
+    }
+    return chan_leafs[i];
+}
+
 /*
 =================
-SND_Spatialize
+S_Occlusion
 
-spatializes a channel
+The volume left to a sound in leaf. Leaf 0 is solid, which sounds on the
+floor or in a wall often start in, so it counts as seen.
 =================
 */
-void SND_Spatialize(channel_t* ch) {
-    vec_t dot;
-    vec_t dist;
-    vec_t lscale, rscale, scale;
-    vec3_t source_vec;
+static float S_Occlusion(const mleaf_t* leaf) {
+    if (!pvs_model || pvs_model != cl.worldmodel || !leaf
+        || leaf == cl.worldmodel->leafs) {
+        return 1;
+    }
+    const i32 num = leaf - cl.worldmodel->leafs - 1;
+    if (listener_pvs[num >> 3] & (1 << (num & 7))) {
+        return 1;
+    }
+    return 1 - SDL_clamp(snd_occlusion.value, 0, 1);
+}
 
+// The channels that aren't placed in the world, false for the rest.
+static qboolean S_SpatializeFixed(channel_t* ch) {
     if (ch->entchannel == -2) {
         ch->leftvol = ch->master_vol; //voip comes out full volume
         ch->rightvol = ch->master_vol;
-        return;
+        return true;
     }
     // anything coming from the view entity will always be full volume
     if (ch->entnum == cl.viewentity) {
         ch->leftvol = ch->master_vol * voicevolumescale;
         ch->rightvol = ch->master_vol * voicevolumescale;
+        return true;
+    }
+    return false;
+}
+
+static void S_BatchChannel(i32 n, const channel_t* ch, float occlusion) {
+    batch.x[n] = ch->origin[0];
+    batch.y[n] = ch->origin[1];
+    batch.z[n] = ch->origin[2];
+    batch.dist_mult[n] = ch->dist_mult;
+    batch.volume[n] = ch->master_vol * voicevolumescale * occlusion;
+}
+
+/*
+=================
+S_SpatializeBatch
+
+Stereo separation and distance attenuation for the first count entries.
+=================
+*/
+static void S_SpatializeBatch(i32 count) {
+    const float ox = listener_origin[0];
+    const float oy = listener_origin[1];
+    const float oz = listener_origin[2];
+    const float rx = listener_right[0];
+    const float ry = listener_right[1];
+    const float rz = listener_right[2];
+    const float separation = shm->channels == 1 ? 0 : 1;
+
+    for (i32 i = 0; i < count; i++) {
+        const float vx = batch.x[i] - ox;
+        const float vy = batch.y[i] - oy;
+        const float vz = batch.z[i] - oz;
+        const float dist_mult = batch.dist_mult[i];
+        const float lengthsq = vx * vx + vy * vy + vz * vz;
+        const float length = sqrtf(lengthsq);
+
+        // a sound right on the listener comes from the middle
+        const float ilength = length > 0 ? 1 / length : 0;
+        const float dot = (rx * vx + ry * vy + rz * vz) * ilength * separation;
+
+        // past its clip distance a channel is silent, and goes virtual
+        const float audible = lengthsq * dist_mult * dist_mult < 1;
+        const float gain = (1 - length * dist_mult) * batch.volume[i] * audible;
+
+        const i32 right = (i32) (gain * (1 + dot));
+        const i32 left = (i32) (gain * (1 - dot));
+        batch.right[i] = right < 0 ? 0 : right;
+        batch.left[i] = left < 0 ? 0 : left;
+    }
+}
+
+/*
+=================
+SND_Spatialize
+
+spatializes a channel
+=================
+*/
+void SND_Spatialize(channel_t* ch) {
+    if (S_SpatializeFixed(ch)) {
         return;
     }
 
-    // calculate stereo seperation and distance attenuation
-    VectorSubtract(ch->origin, listener_origin, source_vec);
-    dist = VectorNormalize(source_vec) * ch->dist_mult;
-    dot = DotProduct(listener_right, source_vec);
+    const mleaf_t* leaf = NULL;
+    if (pvs_model && pvs_model == cl.worldmodel) {
+        leaf = Mod_PointInLeaf(ch->origin, cl.worldmodel);
+    }
+    S_BatchChannel(0, ch, S_Occlusion(leaf));
+    S_SpatializeBatch(1);
+    ch->leftvol = batch.left[0];
+    ch->rightvol = batch.right[0];
+}
 
-    if (shm->channels == 1) {
-        rscale = 1.0;
-        lscale = 1.0;
-    } else {
-        rscale = 1.0 + dot;
-        lscale = 1.0 - dot;
+/*
+=================
+S_SpatializeChannels
+
+Spatializes the channels that play, from first on, in one batch.
+=================
+*/
+static void S_SpatializeChannels(i32 first) {
+    i32 count = 0;
+
+    snd_occluded = 0;
+    for (i32 i = first; i < total_channels; i++) {
+        channel_t* ch = &snd_channels[i];
+        if (!ch->sfx || S_SpatializeFixed(ch)) {
+            continue;
+        }
+        const float occlusion = pvs_model ? S_Occlusion(S_ChannelLeaf(i)) : 1;
+        if (occlusion < 1) {
+            snd_occluded++;
+        }
+        batch_channels[count] = ch;
+        S_BatchChannel(count++, ch, occlusion);
     }
 
-    // add in distance effect
-    scale = (1.0 - dist) * rscale;
-    ch->rightvol = (i32) (ch->master_vol * scale * voicevolumescale);
-    if (ch->rightvol < 0)
-        ch->rightvol = 0;
+    S_SpatializeBatch(count);
 
-    scale = (1.0 - dist) * lscale;
-    ch->leftvol = (i32) (ch->master_vol * scale * voicevolumescale);
-    if (ch->leftvol < 0)
-        ch->leftvol = 0;
+    for (i32 i = 0; i < count; i++) {
+        batch_channels[i]->leftvol = batch.left[i];
+        batch_channels[i]->rightvol = batch.right[i];
+    }
 }
 
 
@@ -440,6 +731,7 @@ void SND_Spatialize(channel_t* ch) {
 void S_StartSound(i32 entnum, i32 entchannel, sfx_t* sfx, vec3_t origin,
                   float fvol, float attenuation) {
     channel_t *target_chan, *check;
+    channel_t newchan;
     sfxcache_t* sc;
     i32 ch_idx;
     i32 skip;
@@ -453,30 +745,32 @@ void S_StartSound(i32 entnum, i32 entchannel, sfx_t* sfx, vec3_t origin,
     if (nosound.value)
         return;
 
-    // pick a channel to play on
-    target_chan = SND_PickChannel(entnum, entchannel);
+    // spatialize, to know what the sound is worth
+    Q_memset(&newchan, 0, sizeof(newchan));
+    VectorCopy(origin, newchan.origin);
+    newchan.dist_mult = attenuation / sound_nominal_clip_dist;
+    newchan.master_vol = (i32) (fvol * 255);
+    newchan.entnum = entnum;
+    newchan.entchannel = entchannel;
+    SND_Spatialize(&newchan);
+
+    // pick a channel to play on, a sound that isn't audible yet still
+    // plays on a virtual voice in case it comes within range
+    target_chan = SND_PickChannel(entnum, entchannel,
+                                  S_ChannelPriority(&newchan));
     if (!target_chan)
         return;
-
-    // spatialize
-    Q_memset(target_chan, 0, sizeof(*target_chan));
-    VectorCopy(origin, target_chan->origin);
-    target_chan->dist_mult = attenuation / sound_nominal_clip_dist;
-    target_chan->master_vol = (i32) (fvol * 255);
-    target_chan->entnum = entnum;
-    target_chan->entchannel = entchannel;
-    SND_Spatialize(target_chan);
-
-    if (!target_chan->leftvol && !target_chan->rightvol)
-        return; // not audible at all
+    *target_chan = newchan;
 
     // new channel
-    sc = S_LoadSound(sfx);
+    sc = S_MixerData(sfx);
     if (!sc) {
         target_chan->sfx = NULL;
         return; // couldn't load the sound's data
     }
 
+    ch_idx = target_chan - snd_channels;
+    serials[ch_idx]++;
     target_chan->sfx = sfx;
     target_chan->pos = 0.0;
     target_chan->end = paintedtime + sc->length;
@@ -488,7 +782,9 @@ void S_StartSound(i32 entnum, i32 entchannel, sfx_t* sfx, vec3_t origin,
          ch_idx++, check++) {
         if (check == target_chan)
             continue;
-        if (check->sfx == sfx && !check->pos) {
+        // not sent to the mixer yet means started this frame
+        if (check->sfx == sfx && !check->pos
+            && sent[ch_idx].serial != serials[ch_idx]) {
             /*
 			skip = rand () % (i32)(0.1 * shm->speed);
 			if (skip >= target_chan->end)
@@ -510,7 +806,7 @@ void S_StartSound(i32 entnum, i32 entchannel, sfx_t* sfx, vec3_t origin,
 void S_StopSound(i32 entnum, i32 entchannel) {
     i32 i;
 
-    for (i = 0; i < MAX_DYNAMIC_CHANNELS; i++) {
+    for (i = NUM_AMBIENTS; i < NUM_AMBIENTS + MAX_DYNAMIC_CHANNELS; i++) {
         if (snd_channels[i].entnum == entnum
             && snd_channels[i].entchannel == entchannel) {
             snd_channels[i].end = 0;
@@ -522,6 +818,7 @@ void S_StopSound(i32 entnum, i32 entchannel) {
 
 void S_StopAllSounds(qboolean clear) {
     i32 i;
+    mixcmd_t cmd;
     if (!sound_started)
         return;
 
@@ -532,9 +829,25 @@ void S_StopAllSounds(qboolean clear) {
             snd_channels[i].sfx = NULL;
 
     Q_memset(snd_channels, 0, MAX_CHANNELS * sizeof(channel_t));
+    Q_memset(sent, 0, sizeof(sent));
+
+    // The voices go first, so the mixer is done with the copies it frees.
+    Q_memset(&cmd, 0, sizeof(cmd));
+    cmd.type = MIX_STOPALL;
+    S_MixerCommand(&cmd);
+    cmd.type = MIX_FREE;
+    for (i = 0; i < MAX_SFX; i++) {
+        if (mixdata[i]) {
+            cmd.data.sc = mixdata[i];
+            S_MixerCommand(&cmd);
+            mixdata[i] = NULL;
+        }
+    }
 
     if (clear)
         S_ClearBuffer();
+    else
+        S_MixerFlush();
 }
 
 static void S_StopAllSoundsC(void) {
@@ -542,27 +855,18 @@ static void S_StopAllSoundsC(void) {
 }
 
 void S_ClearBuffer(void) {
-    if (!sound_started || !shm) {
-        return;
-    }
+    mixcmd_t cmd;
 
-    SNDDMA_LockBuffer();
-    if (!shm->buffer) {
+    if (!sound_started || !shm) {
         return;
     }
 
     s_rawend = 0;
 
-    int clear;
-    if (shm->samplebits == 8 && !shm->signed8) {
-        clear = 0x80;
-    } else {
-        clear = 0;
-    }
-
-    Q_memset(shm->buffer, clear, shm->samples * shm->samplebits / 8);
-
-    SNDDMA_Submit();
+    Q_memset(&cmd, 0, sizeof(cmd));
+    cmd.type = MIX_CLEARBUFFER;
+    S_MixerCommand(&cmd);
+    S_MixerFlush();
 }
 
 
@@ -586,7 +890,7 @@ void S_StaticSound(sfx_t* sfx, vec3_t origin, float vol, float attenuation) {
     ss = &snd_channels[total_channels];
     total_channels++;
 
-    sc = S_LoadSound(sfx);
+    sc = S_MixerData(sfx);
     if (!sc)
         return;
 
@@ -595,6 +899,7 @@ void S_StaticSound(sfx_t* sfx, vec3_t origin, float vol, float attenuation) {
         return;
     }
 
+    serials[ss - snd_channels]++;
     ss->sfx = sfx;
     VectorCopy(origin, ss->origin);
     ss->master_vol = (i32) vol;
@@ -677,8 +982,11 @@ void S_RawSamples(
     float scale;
     i32 intVolume;
 
-    if (s_rawend < paintedtime)
-        s_rawend = paintedtime;
+    // The mixer may be reading below s_rawend, so write ahead of it and
+    // publish the new end once the samples are in.
+    i32 rawend = s_rawend;
+    if (rawend < paintedtime)
+        rawend = paintedtime;
 
     scale = (float) rate / shm->speed;
     intVolume = (i32) (256 * volume);
@@ -688,8 +996,8 @@ void S_RawSamples(
             src = i * scale;
             if (src >= samples)
                 break;
-            dst = s_rawend & (MAX_RAW_SAMPLES - 1);
-            s_rawend++;
+            dst = rawend & (MAX_RAW_SAMPLES - 1);
+            rawend++;
             s_rawsamples[dst].left = ((i16*) data)[src * 2] * intVolume;
             s_rawsamples[dst].right = ((i16*) data)[src * 2 + 1] * intVolume;
         }
@@ -698,8 +1006,8 @@ void S_RawSamples(
             src = i * scale;
             if (src >= samples)
                 break;
-            dst = s_rawend & (MAX_RAW_SAMPLES - 1);
-            s_rawend++;
+            dst = rawend & (MAX_RAW_SAMPLES - 1);
+            rawend++;
             s_rawsamples[dst].left = ((i16*) data)[src] * intVolume;
             s_rawsamples[dst].right = ((i16*) data)[src] * intVolume;
         }
@@ -710,8 +1018,8 @@ void S_RawSamples(
             src = i * scale;
             if (src >= samples)
                 break;
-            dst = s_rawend & (MAX_RAW_SAMPLES - 1);
-            s_rawend++;
+            dst = rawend & (MAX_RAW_SAMPLES - 1);
+            rawend++;
             //	s_rawsamples [dst].left = ((i8*) data)[src * 2] * intVolume;
             //	s_rawsamples [dst].right = ((i8*) data)[src * 2 + 1] * intVolume;
             s_rawsamples[dst].left =
@@ -726,14 +1034,137 @@ void S_RawSamples(
             src = i * scale;
             if (src >= samples)
                 break;
-            dst = s_rawend & (MAX_RAW_SAMPLES - 1);
-            s_rawend++;
+            dst = rawend & (MAX_RAW_SAMPLES - 1);
+            rawend++;
             //	s_rawsamples [dst].left = ((i8*) data)[src] * intVolume;
             //	s_rawsamples [dst].right = ((i8*) data)[src] * intVolume;
             s_rawsamples[dst].left = (((byte*) data)[src] - 128) * intVolume;
             s_rawsamples[dst].right = (((byte*) data)[src] - 128) * intVolume;
         }
     }
+
+    SDL_MemoryBarrierRelease();
+    s_rawend = rawend;
+}
+
+static void S_SendChannel(mixcmdtype_t type, i32 i, const channel_t* ch) {
+    mixcmd_t cmd;
+
+    Q_memset(&cmd, 0, sizeof(cmd));
+    cmd.type = type;
+    cmd.voice = i;
+    cmd.data.leftvol = ch->leftvol;
+    cmd.data.rightvol = ch->rightvol;
+    S_MixerCommand(&cmd);
+
+    sent[i].leftvol = ch->leftvol;
+    sent[i].rightvol = ch->rightvol;
+}
+
+/*
+============
+S_ExpireChannel
+
+The mixer ends and loops its voices by itself, this keeps the channel's
+end in step for SND_PickChannel.
+============
+*/
+static void S_ExpireChannel(i32 i, channel_t* ch, i32 now) {
+    if (ch->end > now) {
+        return;
+    }
+    const sfxcache_t* sc = mixdata[ch->sfx - known_sfx];
+    const i32 looplength = sc->length - sc->loopstart;
+    if (sc->loopstart >= 0 && looplength > 0) {
+        ch->end = now + looplength - (now - ch->end) % looplength;
+    } else {
+        // the voice runs out on its own, no need to stop it
+        ch->sfx = NULL;
+        sent[i].sfx = NULL;
+    }
+}
+
+/*
+============
+S_SyncChannels
+
+Sends the mixer whatever changed in the channels since the last frame.
+============
+*/
+static void S_SyncChannels(void) {
+    const i32 now = paintedtime;
+
+    for (i32 i = 0; i < total_channels; i++) {
+        channel_t* ch = &snd_channels[i];
+        sentchannel_t* s = &sent[i];
+
+        if (ch->sfx && ch->sfx == s->sfx && s->serial == serials[i]) {
+            S_ExpireChannel(i, ch, now);
+        }
+
+        if (!ch->sfx) {
+            if (s->sfx) {
+                S_SendChannel(MIX_STOP, i, ch);
+                s->sfx = NULL;
+            }
+            s->waiting = false;
+            continue;
+        }
+
+        if (ch->sfx != s->sfx || s->serial != serials[i]) {
+            mixcmd_t cmd;
+            Q_memset(&cmd, 0, sizeof(cmd));
+            cmd.data.sc = S_MixerData(ch->sfx);
+            if (cmd.data.sc && ch->sfx->streamed) {
+                if (S_NumSfxStreams() < MAX_SFX_STREAMS) {
+                    cmd.data.stream = S_OpenSfxStream(ch->sfx, ch->pos);
+                } else if (cmd.data.sc->loopstart >= 0) {
+                    // a looped sound waits for a stream to come free
+                    if (!s->waiting) {
+                        Con_DPrintf("No free stream for %s, waiting\n",
+                                    ch->sfx->name);
+                        s->waiting = true;
+                    }
+                    if (s->sfx) {
+                        S_SendChannel(MIX_STOP, i, ch);
+                        s->sfx = NULL;
+                    }
+                    continue;
+                } else {
+                    Con_DPrintf("No free stream for %s\n", ch->sfx->name);
+                }
+                if (!cmd.data.stream) {
+                    cmd.data.sc = NULL;
+                }
+            }
+            s->waiting = false;
+            if (!cmd.data.sc) {
+                ch->sfx = NULL;
+                if (s->sfx) {
+                    S_SendChannel(MIX_STOP, i, ch);
+                    s->sfx = NULL;
+                }
+                continue;
+            }
+            cmd.type = MIX_START;
+            cmd.voice = i;
+            cmd.data.leftvol = ch->leftvol;
+            cmd.data.rightvol = ch->rightvol;
+            cmd.data.pos = ch->pos;
+            cmd.data.end = ch->end - now;
+            S_MixerCommand(&cmd);
+
+            s->sfx = ch->sfx;
+            s->serial = serials[i];
+            s->leftvol = ch->leftvol;
+            s->rightvol = ch->rightvol;
+            continue;
+        }
+
+        if (ch->leftvol != s->leftvol || ch->rightvol != s->rightvol) {
+            S_SendChannel(MIX_VOLUME, i, ch);
+        }
+    }
 }
 
 /*
@@ -753,12 +1184,11 @@ void S_Update(vec3_t origin, vec3_t forward, vec3_t right, vec3_t up) {
         return;
     }
 
-    if (sfxvolume.value != old_sfxvolume) {
-        SND_UpdateSfxVolume();
-    }
-    if (snd_filterquality.value != old_filterquality) {
-        SND_UpdateFilterQuality();
+    if (S_MixerWrapped()) {
+        S_StopAllSounds(true);
     }
+    S_UpdateMixSettings();
+    S_UpdateResampleCache();
 
     VectorCopy(origin, listener_origin);
     VectorCopy(forward, listener_forward);
@@ -771,11 +1201,13 @@ void S_Update(vec3_t origin, vec3_t forward, vec3_t right, vec3_t up) {
     combine = NULL;
 
     // update spatialization for static and dynamic sounds
+    S_UpdateListenerPVS();
+    S_SpatializeChannels(NUM_AMBIENTS);
+
     ch = snd_channels + NUM_AMBIENTS;
     for (i = NUM_AMBIENTS; i < total_channels; i++, ch++) {
         if (!ch->sfx)
             continue;
-        SND_Spatialize(ch); // respatialize channel
         if (!ch->leftvol && !ch->rightvol)
             continue;
 
@@ -824,36 +1256,19 @@ void S_Update(vec3_t origin, vec3_t forward, vec3_t right, vec3_t up) {
             }
         }
 
-        Con_Printf("----(%i)----\n", total);
+        Con_Printf("----(%i)---- %i painted, %i virtual, %i occluded\n",
+                   total, snd_paintedvoices, snd_virtualvoices, snd_occluded);
     }
 
-    // mix some sound
-    S_Update_();
-}
-
-static void GetSoundtime(void) {
-    static i32 buffers;
-    static i32 oldsamplepos;
+    S_UpdateSfxStreams();
+    S_SyncChannels();
 
-    i32 fullsamples = shm->samples / shm->channels;
-
-    // It is possible to miscount buffers if it has
-    // wrapped twice between calls to S_Update.
-    i32 samplepos = SNDDMA_GetDMAPos();
-
-    if (samplepos < oldsamplepos) {
-        // Buffer wrapped.
-        buffers++;
-        if (paintedtime > 0x40000000) {
-            // Time to chop things off to avoid 32 bit limits.
-            buffers = 0;
-            paintedtime = fullsamples;
-            S_StopAllSounds(true);
-        }
+    // mix some sound
+    if (S_MixerThreaded()) {
+        S_MixerFlush();
+    } else {
+        S_MixerUpdate();
     }
-    oldsamplepos = samplepos;
-
-    soundtime = buffers * fullsamples + samplepos / shm->channels;
 }
 
 void S_ExtraUpdate(void) {
@@ -861,40 +1276,15 @@ void S_ExtraUpdate(void) {
         // don't pollute timings
         return;
     }
-    S_Update_();
-}
-
-static void S_Update_(void) {
-    u32 endtime;
-    i32 samps;
-
-    if (!sound_started || (snd_blocked > 0)) {
+    if (S_MixerThreaded()) {
+        // the mixer keeps up by itself
         return;
     }
-
-    SNDDMA_LockBuffer();
-    if (!shm->buffer) {
+    if (!sound_started || (snd_blocked > 0)) {
         return;
     }
-
-    // Updates DMA time.
-    GetSoundtime();
-
-    // Check to make sure that we haven't overshot.
-    if (paintedtime < soundtime) {
-        //Con_Printf("S_Update_ : overflow\n");
-        paintedtime = soundtime;
-    }
-
-    // mix ahead of current position
-    endtime = soundtime + _snd_mixahead.value * shm->speed;
-    samps = shm->samples >> (shm->channels - 1);
-    if (endtime - soundtime > samps)
-        endtime = soundtime + samps;
-
-    S_PaintChannels((i32) endtime);
-
-    SNDDMA_Submit();
+    S_UpdateSfxStreams();
+    S_MixerUpdate();
 }
 
 /*
@@ -951,6 +1341,13 @@ static void S_SoundList(void) {
 
     i32 total = 0;
     for (sfx = known_sfx, i = 0; i < num_sfx; i++, sfx++) {
+        if (sfx->streamed) {
+            const sfxcache_t* info = &sfx->streaminfo;
+            Con_SafePrintf("%c(stream) %6i : %s\n",
+                           info->loopstart >= 0 ? 'L' : ' ',
+                           info->length * info->width, sfx->name);
+            continue;
+        }
         const sfxcache_t* sc = (sfxcache_t*) Cache_Check(&sfx->cache);
         if (!sc) {
             continue;
@@ -989,10 +1386,3 @@ void S_LocalSound(char* name) {
 void S_ClearPrecache(void) {
 }
 
-
-void S_BeginPrecaching(void) {
-}
-
-
-void S_EndPrecaching(void) {
-}
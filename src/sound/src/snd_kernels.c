@@ -0,0 +1,529 @@
+/*
+ * Copyright (C) 1996-1997 Id Software, Inc.
+ * Copyright (C) Henrique Barateli, <henriquejb194@gmail.com>, et al.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+// snd_kernels.c -- inner loops of the software mixer
+
+
+#include "snd_kernels.h"
+#include "console.h"
+#include <SDL_stdinc.h>
+#include <string.h>
+
+
+#define CLIP_MIN (-32768 * 256)
+#define CLIP_MAX (32767 * 256)
+
+
+/*
+===============================================================================
+
+SCALAR REFERENCE
+
+===============================================================================
+*/
+
+static void PaintStereo8_C(portable_samplepair_t* paint, const byte* sfx,
+                           i32 count, i32 lscale, i32 rscale) {
+    for (i32 i = 0; i < count; i++) {
+        const i32 data = (i8) sfx[i];
+        paint[i].left += data * lscale;
+        paint[i].right += data * rscale;
+    }
+}
+
+static void PaintStereo16_C(portable_samplepair_t* paint, const i16* sfx,
+                            i32 count, i32 leftvol, i32 rightvol) {
+    for (i32 i = 0; i < count; i++) {
+        const i32 data = sfx[i];
+        paint[i].left += data * leftvol;
+        paint[i].right += data * rightvol;
+    }
+}
+
+static void AddMusic_C(portable_samplepair_t* paint,
+                       const portable_samplepair_t* music, i32 count) {
+    for (i32 i = 0; i < count; i++) {
+        paint[i].left += music[i].left / 2;
+        paint[i].right += music[i].right / 2;
+    }
+}
+
+static void ClipSamples_C(portable_samplepair_t* paint, i32 count) {
+    for (i32 i = 0; i < count; i++) {
+        paint[i].left = SDL_clamp(paint[i].left, CLIP_MIN, CLIP_MAX) / 2;
+        paint[i].right = SDL_clamp(paint[i].right, CLIP_MIN, CLIP_MAX) / 2;
+    }
+}
+
+static i16 Saturate16(i32 val) {
+    val /= 256;
+    if (val > 0x7fff)
+        return 0x7fff;
+    if (val < (i16) 0x8000)
+        return (i16) 0x8000;
+    return (i16) val;
+}
+
+static void TransferStereo16_C(i16* out, const portable_samplepair_t* paint,
+                               const portable_samplepair_t* music, i32 count,
+                               qboolean clip) {
+    for (i32 i = 0; i < count; i++) {
+        i32 left = paint[i].left;
+        i32 right = paint[i].right;
+        if (clip) {
+            left = SDL_clamp(left, CLIP_MIN, CLIP_MAX) / 2;
+            right = SDL_clamp(right, CLIP_MIN, CLIP_MAX) / 2;
+            if (music) {
+                left += music[i].left / 2;
+                right += music[i].right / 2;
+            }
+        }
+        out[2 * i] = Saturate16(left);
+        out[2 * i + 1] = Saturate16(right);
+    }
+}
+
+
+/*
+===============================================================================
+
+VECTOR KERNELS
+
+Four 32-bit lanes, a stereo pair in every two. Integer division in C
+rounds towards zero, so the halving and the final shift add the sign
+bits in first.
+
+===============================================================================
+*/
+
+#if defined(SND_SSE)
+
+static inline __m128i Mul32(__m128i a, __m128i b) {
+#if defined(__SSE4_1__)
+    return _mm_mullo_epi32(a, b);
+#else
+    const __m128i even = _mm_mul_epu32(a, b);
+    const __m128i odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+#endif
+}
+
+static inline __m128i Clip32(__m128i x) {
+    const __m128i lo = _mm_set1_epi32(CLIP_MIN);
+    const __m128i hi = _mm_set1_epi32(CLIP_MAX);
+#if defined(__SSE4_1__)
+    return _mm_min_epi32(_mm_max_epi32(x, lo), hi);
+#else
+    __m128i mask = _mm_cmpgt_epi32(x, hi);
+    x = _mm_or_si128(_mm_and_si128(mask, hi), _mm_andnot_si128(mask, x));
+    mask = _mm_cmplt_epi32(x, lo);
+    return _mm_or_si128(_mm_and_si128(mask, lo), _mm_andnot_si128(mask, x));
+#endif
+}
+
+static inline __m128i Half(__m128i x) {
+    return _mm_srai_epi32(_mm_add_epi32(x, _mm_srli_epi32(x, 31)), 1);
+}
+
+static inline __m128i Div256(__m128i x) {
+    const __m128i bias = _mm_srli_epi32(_mm_srai_epi32(x, 31), 24);
+    return _mm_srai_epi32(_mm_add_epi32(x, bias), 8);
+}
+
+static inline __m128i Load(const portable_samplepair_t* p) {
+    return _mm_loadu_si128((const __m128i*) p);
+}
+
+static inline void Store(portable_samplepair_t* p, __m128i x) {
+    _mm_storeu_si128((__m128i*) p, x);
+}
+
+// Adds 4 samples, one per lane of data, times vol to 4 pairs.
+static inline void PaintFour(portable_samplepair_t* paint, __m128i data,
+                             __m128i vol) {
+    Store(paint, _mm_add_epi32(Load(paint), Mul32(_mm_unpacklo_epi32(data, data), vol)));
+    Store(paint + 2, _mm_add_epi32(Load(paint + 2), Mul32(_mm_unpackhi_epi32(data, data), vol)));
+}
+
+static i32 PaintStereo8_V(portable_samplepair_t* paint, const byte* sfx,
+                          i32 count, i32 lscale, i32 rscale) {
+    const __m128i vol = _mm_set_epi32(rscale, lscale, rscale, lscale);
+    i32 i = 0;
+    for (; i + 4 <= count; i += 4) {
+        i32 bytes;
+        memcpy(&bytes, sfx + i, sizeof(bytes));
+        __m128i data = _mm_cvtsi32_si128(bytes);
+        data = _mm_unpacklo_epi8(data, data);
+        data = _mm_srai_epi32(_mm_unpacklo_epi16(data, data), 24);
+        PaintFour(paint + i, data, vol);
+    }
+    return i;
+}
+
+static i32 PaintStereo16_V(portable_samplepair_t* paint, const i16* sfx,
+                           i32 count, i32 leftvol, i32 rightvol) {
+    const __m128i vol = _mm_set_epi32(rightvol, leftvol, rightvol, leftvol);
+    i32 i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i data = _mm_loadl_epi64((const __m128i*) (sfx + i));
+        data = _mm_srai_epi32(_mm_unpacklo_epi16(data, data), 16);
+        PaintFour(paint + i, data, vol);
+    }
+    return i;
+}
+
+static i32 AddMusic_V(portable_samplepair_t* paint,
+                      const portable_samplepair_t* music, i32 count) {
+    i32 i = 0;
+    for (; i + 2 <= count; i += 2) {
+        Store(paint + i, _mm_add_epi32(Load(paint + i), Half(Load(music + i))));
+    }
+    return i;
+}
+
+static i32 ClipSamples_V(portable_samplepair_t* paint, i32 count) {
+    i32 i = 0;
+    for (; i + 2 <= count; i += 2) {
+        Store(paint + i, Half(Clip32(Load(paint + i))));
+    }
+    return i;
+}
+
+static i32 TransferStereo16_V(i16* out, const portable_samplepair_t* paint,
+                              const portable_samplepair_t* music, i32 count,
+                              qboolean clip) {
+    i32 i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i a = Load(paint + i);
+        __m128i b = Load(paint + i + 2);
+        if (clip) {
+            a = Half(Clip32(a));
+            b = Half(Clip32(b));
+            if (music) {
+                a = _mm_add_epi32(a, Half(Load(music + i)));
+                b = _mm_add_epi32(b, Half(Load(music + i + 2)));
+            }
+        }
+        // packs saturates to 16 bits like Saturate16
+        _mm_storeu_si128((__m128i*) (out + 2 * i), _mm_packs_epi32(Div256(a), Div256(b)));
+    }
+    return i;
+}
+
+#elif defined(SND_NEON)
+
+static inline int32x4_t Clip32(int32x4_t x) {
+    return vminq_s32(vmaxq_s32(x, vdupq_n_s32(CLIP_MIN)), vdupq_n_s32(CLIP_MAX));
+}
+
+static inline int32x4_t Half(int32x4_t x) {
+    const uint32x4_t sign = vshrq_n_u32(vreinterpretq_u32_s32(x), 31);
+    return vshrq_n_s32(vaddq_s32(x, vreinterpretq_s32_u32(sign)), 1);
+}
+
+static inline int32x4_t Div256(int32x4_t x) {
+    const uint32x4_t bias = vshrq_n_u32(vreinterpretq_u32_s32(vshrq_n_s32(x, 31)), 24);
+    return vshrq_n_s32(vaddq_s32(x, vreinterpretq_s32_u32(bias)), 8);
+}
+
+static inline int32x4_t Load(const portable_samplepair_t* p) {
+    return vld1q_s32((const i32*) p);
+}
+
+static inline void Store(portable_samplepair_t* p, int32x4_t x) {
+    vst1q_s32((i32*) p, x);
+}
+
+// Adds 4 samples, one per lane of data, times vol to 4 pairs.
+static inline void PaintFour(portable_samplepair_t* paint, int32x4_t data,
+                             int32x4_t vol) {
+    const int32x4x2_t pairs = vzipq_s32(data, data);
+    Store(paint, vmlaq_s32(Load(paint), pairs.val[0], vol));
+    Store(paint + 2, vmlaq_s32(Load(paint + 2), pairs.val[1], vol));
+}
+
+static inline int32x4_t Volume(i32 left, i32 right) {
+    const i32 vol[4] = {left, right, left, right};
+    return vld1q_s32(vol);
+}
+
+static i32 PaintStereo8_V(portable_samplepair_t* paint, const byte* sfx,
+                          i32 count, i32 lscale, i32 rscale) {
+    const int32x4_t vol = Volume(lscale, rscale);
+    i32 i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const int16x8_t data = vmovl_s8(vld1_s8((const i8*) (sfx + i)));
+        PaintFour(paint + i, vmovl_s16(vget_low_s16(data)), vol);
+        PaintFour(paint + i + 4, vmovl_s16(vget_high_s16(data)), vol);
+    }
+    return i;
+}
+
+static i32 PaintStereo16_V(portable_samplepair_t* paint, const i16* sfx,
+                           i32 count, i32 leftvol, i32 rightvol) {
+    const int32x4_t vol = Volume(leftvol, rightvol);
+    i32 i = 0;
+    for (; i + 4 <= count; i += 4) {
+        PaintFour(paint + i, vmovl_s16(vld1_s16(sfx + i)), vol);
+    }
+    return i;
+}
+
+static i32 AddMusic_V(portable_samplepair_t* paint,
+                      const portable_samplepair_t* music, i32 count) {
+    i32 i = 0;
+    for (; i + 2 <= count; i += 2) {
+        Store(paint + i, vaddq_s32(Load(paint + i), Half(Load(music + i))));
+    }
+    return i;
+}
+
+static i32 ClipSamples_V(portable_samplepair_t* paint, i32 count) {
+    i32 i = 0;
+    for (; i + 2 <= count; i += 2) {
+        Store(paint + i, Half(Clip32(Load(paint + i))));
+    }
+    return i;
+}
+
+static i32 TransferStereo16_V(i16* out, const portable_samplepair_t* paint,
+                              const portable_samplepair_t* music, i32 count,
+                              qboolean clip) {
+    i32 i = 0;
+    for (; i + 4 <= count; i += 4) {
+        int32x4_t a = Load(paint + i);
+        int32x4_t b = Load(paint + i + 2);
+        if (clip) {
+            a = Half(Clip32(a));
+            b = Half(Clip32(b));
+            if (music) {
+                a = vaddq_s32(a, Half(Load(music + i)));
+                b = vaddq_s32(b, Half(Load(music + i + 2)));
+            }
+        }
+        // vqmovn saturates to 16 bits like Saturate16
+        vst1q_s16(out + 2 * i, vcombine_s16(vqmovn_s32(Div256(a)), vqmovn_s32(Div256(b))));
+    }
+    return i;
+}
+
+#endif
+
+
+/*
+===============================================================================
+
+DISPATCH
+
+The vector kernels return how far they got, the scalar ones do the rest.
+
+===============================================================================
+*/
+
+#if defined(SND_SSE) || defined(SND_NEON)
+#define SND_VECTOR
+#endif
+
+void SND_PaintStereo8(portable_samplepair_t* paint, const byte* sfx,
+                      i32 count, i32 lscale, i32 rscale) {
+    i32 done = 0;
+#ifdef SND_VECTOR
+    done = PaintStereo8_V(paint, sfx, count, lscale, rscale);
+#endif
+    PaintStereo8_C(paint + done, sfx + done, count - done, lscale, rscale);
+}
+
+void SND_PaintStereo16(portable_samplepair_t* paint, const i16* sfx,
+                       i32 count, i32 leftvol, i32 rightvol) {
+    i32 done = 0;
+#ifdef SND_VECTOR
+    done = PaintStereo16_V(paint, sfx, count, leftvol, rightvol);
+#endif
+    PaintStereo16_C(paint + done, sfx + done, count - done, leftvol, rightvol);
+}
+
+void SND_AddMusic(portable_samplepair_t* paint,
+                  const portable_samplepair_t* music, i32 count) {
+    i32 done = 0;
+#ifdef SND_VECTOR
+    done = AddMusic_V(paint, music, count);
+#endif
+    AddMusic_C(paint + done, music + done, count - done);
+}
+
+void SND_ClipSamples(portable_samplepair_t* paint, i32 count) {
+    i32 done = 0;
+#ifdef SND_VECTOR
+    done = ClipSamples_V(paint, count);
+#endif
+    ClipSamples_C(paint + done, count - done);
+}
+
+void SND_TransferStereo16(i16* out, const portable_samplepair_t* paint,
+                          const portable_samplepair_t* music, i32 count,
+                          qboolean clip) {
+    i32 done = 0;
+#ifdef SND_VECTOR
+    done = TransferStereo16_V(out, paint, music, count, clip);
+#endif
+    TransferStereo16_C(out + 2 * done, paint + done, music ? music + done : NULL,
+                       count - done, clip);
+}
+
+const char* SND_KernelName(void) {
+#if defined(SND_AVX)
+    return "avx";
+#elif defined(SND_SSE)
+    return "sse2";
+#elif defined(SND_NEON)
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
+
+
+/*
+===============================================================================
+
+BIT EXACTNESS CHECK
+
+===============================================================================
+*/
+
+#define CHECK_SAMPLES 1031 // odd, so every kernel has a scalar tail
+#define CHECK_ROUNDS  64
+
+static u32 check_seed;
+
+static i32 CheckRandom(void) {
+    check_seed = check_seed * 1664525 + 1013904223;
+    return (i32) check_seed;
+}
+
+// Values well past the clip points, some right at them, and never so
+// big that painting on top of them overflows.
+static i32 CheckSample(void) {
+    static const i32 edges[] = {
+        0, 1, -1, 2, -2, 255, -255, 256, -256, 257, -257,
+        CLIP_MAX, CLIP_MAX + 1, CLIP_MIN, CLIP_MIN - 1,
+    };
+    const i32 r = CheckRandom();
+    if ((r & 7) == 0) {
+        return edges[(u32) CheckRandom() % (sizeof(edges) / sizeof(edges[0]))];
+    }
+    return CheckRandom() >> (2 + (r & 7));
+}
+
+static void CheckFill(portable_samplepair_t* buf, i32 count) {
+    for (i32 i = 0; i < count; i++) {
+        buf[i].left = CheckSample();
+        buf[i].right = CheckSample();
+    }
+}
+
+static qboolean CheckSame(const char* name, const void* a, const void* b,
+                          size_t size, i32 round) {
+    if (Q_memcmp(a, b, size) == 0) {
+        return true;
+    }
+    Con_Printf("%s differs in round %i\n", name, round);
+    return false;
+}
+
+/*
+==================
+SND_KernelCheck_f
+
+Runs every kernel and its scalar reference on the same random data,
+which must come out identical.
+==================
+*/
+void SND_KernelCheck_f(void) {
+    static portable_samplepair_t ref[CHECK_SAMPLES];
+    static portable_samplepair_t vec[CHECK_SAMPLES];
+    static portable_samplepair_t music[CHECK_SAMPLES];
+    static i16 sfx16[CHECK_SAMPLES];
+    static byte sfx8[CHECK_SAMPLES];
+    static i16 out_ref[2 * CHECK_SAMPLES];
+    static i16 out_vec[2 * CHECK_SAMPLES];
+    i32 failed = 0;
+
+    check_seed = 1;
+    for (i32 round = 0; round < CHECK_ROUNDS; round++) {
+        // Odd offsets and lengths reach every tail and misalignment.
+        const i32 start = round % 4;
+        const i32 count = CHECK_SAMPLES - start - (CheckRandom() & 63);
+        const i32 lvol = CheckRandom() % 32768;
+        const i32 rvol = CheckRandom() % 32768;
+
+        for (i32 i = 0; i < CHECK_SAMPLES; i++) {
+            sfx16[i] = (i16) CheckRandom();
+            sfx8[i] = (byte) CheckRandom();
+        }
+        CheckFill(ref, CHECK_SAMPLES);
+        CheckFill(music, CHECK_SAMPLES);
+
+        Q_memcpy(vec, ref, sizeof(ref));
+        PaintStereo8_C(ref + start, sfx8 + start, count, lvol, rvol);
+        SND_PaintStereo8(vec + start, sfx8 + start, count, lvol, rvol);
+        failed += !CheckSame("paint8", ref, vec, sizeof(ref), round);
+
+        Q_memcpy(vec, ref, sizeof(ref));
+        PaintStereo16_C(ref + start, sfx16 + start, count, lvol, rvol);
+        SND_PaintStereo16(vec + start, sfx16 + start, count, lvol, rvol);
+        failed += !CheckSame("paint16", ref, vec, sizeof(ref), round);
+
+        Q_memcpy(vec, ref, sizeof(ref));
+        AddMusic_C(ref + start, music + start, count);
+        SND_AddMusic(vec + start, music + start, count);
+        failed += !CheckSame("music", ref, vec, sizeof(ref), round);
+
+        for (i32 clip = 0; clip < 3; clip++) {
+            const portable_samplepair_t* src = clip == 2 ? music + start : NULL;
+            Q_memset(out_ref, 0, sizeof(out_ref));
+            Q_memset(out_vec, 0, sizeof(out_vec));
+            TransferStereo16_C(out_ref, ref + start, src, count, clip > 0);
+            SND_TransferStereo16(out_vec, ref + start, src, count, clip > 0);
+            failed += !CheckSame("transfer16", out_ref, out_vec, sizeof(out_ref), round);
+        }
+
+        // The fused transfer must match the separate passes.
+        Q_memcpy(vec, ref, sizeof(ref));
+        Q_memset(out_ref, 0, sizeof(out_ref));
+        Q_memset(out_vec, 0, sizeof(out_vec));
+        TransferStereo16_C(out_ref, ref + start, music + start, count, true);
+        SND_ClipSamples(vec + start, count);
+        SND_AddMusic(vec + start, music + start, count);
+        SND_TransferStereo16(out_vec, vec + start, NULL, count, false);
+        failed += !CheckSame("fused transfer16", out_ref, out_vec, sizeof(out_ref), round);
+
+        Q_memcpy(vec, ref, sizeof(ref));
+        ClipSamples_C(ref + start, count);
+        SND_ClipSamples(vec + start, count);
+        failed += !CheckSame("clip", ref, vec, sizeof(ref), round);
+    }
+
+    if (failed) {
+        Con_Printf("%s mixer kernels: %i failures\n", SND_KernelName(), failed);
+    } else {
+        Con_Printf("%s mixer kernels match the scalar ones\n", SND_KernelName());
+    }
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 1996-1997 Id Software, Inc.
+ * Copyright (C) Henrique Barateli, <henriquejb194@gmail.com>, et al.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+// snd_kernels.h -- inner loops of the software mixer
+
+#ifndef _SND_KERNELS_H_
+#define _SND_KERNELS_H_
+
+
+#include "sound.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define SND_AVX
+#define SND_SSE
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#if defined(__SSE4_1__)
+#include <smmintrin.h>
+#endif
+#define SND_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SND_NEON
+#endif
+
+
+// Every kernel has a scalar version the vector one must match bit for bit,
+// see snd_kernelcheck.
+
+void SND_PaintStereo8(portable_samplepair_t* paint, const byte* sfx,
+                      i32 count, i32 lscale, i32 rscale);
+// Adds (i8) sfx[i] times the scales, as snd_scaletable would.
+
+void SND_PaintStereo16(portable_samplepair_t* paint, const i16* sfx,
+                       i32 count, i32 leftvol, i32 rightvol);
+
+void SND_AddMusic(portable_samplepair_t* paint,
+                  const portable_samplepair_t* music, i32 count);
+// Adds music 6dB down to match sfx.
+
+void SND_ClipSamples(portable_samplepair_t* paint, i32 count);
+// Clips to 0dB and takes 6dB off, leaving headroom for filter and music.
+
+void SND_TransferStereo16(i16* out, const portable_samplepair_t* paint,
+                          const portable_samplepair_t* music, i32 count,
+                          qboolean clip);
+// Converts to 16 bits with saturation. With clip the paint is first put
+// through SND_ClipSamples and music, unless NULL, through SND_AddMusic.
+
+const char* SND_KernelName(void);
+void SND_KernelCheck_f(void);
+
+#endif
@@ -21,27 +21,149 @@
 
 
 #include "sound.h"
+#include "cmd.h"
 #include "console.h"
 #include "sys.h"
+#include <SDL_timer.h>
+#include <math.h>
+#include <stdlib.h>
 #include <string.h>
 
 
+// KB of converted sounds kept outside the zone cache, see S_KeepConverted.
+// A sound that is playing is held three times: in the zone cache, here and
+// in the mixer's copy, so the default can cost up to 32MB on top of both.
+cvar_t snd_resamplecache = {"snd_resamplecache", "32768", true};
+static float old_resamplecache = -1.0f;
+
+/*
+===============================================================================
+
+RESAMPLING
+
+Sounds not at the device rate are converted with a windowed sinc, low passed
+below the lower of the two Nyquist frequencies, into 16 bit samples unless
+loadas8bit is set.
+
+===============================================================================
+*/
+
+#define SINC_ZEROS 8   // zero crossings on each side of the kernel
+#define SINC_RES   256 // table entries per zero crossing
+
+static float sinc_table[SINC_ZEROS * SINC_RES + 2];
+
+static void S_InitSincTable(void) {
+    sinc_table[0] = 1;
+    for (i32 i = 1; i < SINC_ZEROS * SINC_RES; i++) {
+        const double x = (double) i / SINC_RES;
+        const double sinc = sin(M_PI * x) / (M_PI * x);
+        // Blackman window, centered, zero at SINC_ZEROS.
+        double window = 0.42;
+        window += 0.5 * cos(M_PI * x / SINC_ZEROS);
+        window += 0.08 * cos(2 * M_PI * x / SINC_ZEROS);
+        sinc_table[i] = (float) (sinc * window);
+    }
+    sinc_table[SINC_ZEROS * SINC_RES] = 0;
+    sinc_table[SINC_ZEROS * SINC_RES + 1] = 0;
+}
+
+// x in zero crossings, >= 0
+static float S_SincKernel(double x) {
+    const double pos = x * SINC_RES;
+    const i32 i = (i32) pos;
+    if (i >= SINC_ZEROS * SINC_RES) {
+        return 0;
+    }
+    const float frac = (float) (pos - i);
+    return sinc_table[i] + frac * (sinc_table[i + 1] - sinc_table[i]);
+}
+
+// Input sample n as 16 bits, following the loop past the end.
+static i32 S_FetchSample(const byte* data, i32 width, i32 n, i32 count,
+                         i32 loopstart) {
+    if (n < 0) {
+        return 0;
+    }
+    if (n >= count) {
+        if (loopstart < 0 || loopstart >= count) {
+            return 0;
+        }
+        n = loopstart + (n - count) % (count - loopstart);
+    }
+    if (width == 2) {
+        return LittleShort(((i16*) data)[n]);
+    }
+    return (i32) ((byte) (data[n]) - 128) << 8;
+}
+
 /*
 ================
-ResampleSfx
+S_ResampleSinc
+
+sc->length and sc->speed are the output's, incount and inloop the input's.
 ================
 */
-void ResampleSfx(sfx_t* sfx, i32 inrate, i32 inwidth, byte* data) {
+static void S_ResampleSinc(sfxcache_t* sc, i32 inrate, i32 inwidth,
+                           i32 incount, i32 inloop, const byte* data) {
+    const double step = (double) inrate / sc->speed;
+    // cutoff as a fraction of the input Nyquist frequency
+    const double f_c = step > 1 ? 1 / step : 1;
+    const i32 half = (i32) ceil(SINC_ZEROS / f_c);
+
+    for (i32 i = 0; i < sc->length; i++) {
+        const double t = i * step;
+        const i32 center = (i32) t;
+        float sum = 0;
+        float weights = 0;
+        for (i32 n = center - half + 1; n <= center + half; n++) {
+            const float w = S_SincKernel(fabs(t - n) * f_c);
+            sum += w * S_FetchSample(data, inwidth, n, incount, inloop);
+            weights += w;
+        }
+
+        // normalized, so the DC gain doesn't ripple with the phase
+        i32 sample = (i32) floor(sum / weights + 0.5);
+        if (sample > 32767)
+            sample = 32767;
+        else if (sample < -32768)
+            sample = -32768;
+
+        if (sc->width == 2)
+            ((i16*) sc->data)[i] = sample;
+        else
+            ((i8*) sc->data)[i] = sample >> 8;
+    }
+}
+
+// Interpolated samples need the extra bits, even from 8 bit sources.
+static i32 S_ResampledWidth(i32 inrate, i32 inwidth) {
+    if (loadas8bit.value) {
+        return 1;
+    }
+    if (inrate != shm->speed) {
+        return 2;
+    }
+    return inwidth;
+}
+
+/*
+================
+S_ResampleSfxCache
+
+Converts raw wav data into an sfxcache_t whose header has been filled in
+by S_InitSfxCache. Only touches its arguments, so it can run on a job thread.
+================
+*/
+static void S_ResampleSfxCache(sfxcache_t* sc, i32 inrate, i32 inwidth,
+                               byte* data) {
     i32 outcount;
     i32 srcsample;
     float stepscale;
     i32 i;
     i32 sample, samplefrac, fracstep;
-    sfxcache_t* sc;
-
-    sc = Cache_Check(&sfx->cache);
-    if (!sc)
-        return;
+    const i32 incount = sc->length;
+    const i32 inloop = sc->loopstart;
 
     stepscale = (float) inrate / shm->speed; // this is usually 0.5, 1, or 2
 
@@ -51,20 +173,19 @@ void ResampleSfx(sfx_t* sfx, i32 inrate, i32 inwidth, byte* data) {
         sc->loopstart = sc->loopstart / stepscale;
 
     sc->speed = shm->speed;
-    if (loadas8bit.value)
-        sc->width = 1;
-    else
-        sc->width = inwidth;
+    sc->width = S_ResampledWidth(inrate, inwidth);
     sc->stereo = 0;
 
     // resample / decimate to the current source rate
 
-    if (stepscale == 1 && inwidth == 1 && sc->width == 1) {
+    if (stepscale != 1) {
+        S_ResampleSinc(sc, inrate, inwidth, incount, inloop, data);
+    } else if (inwidth == 1 && sc->width == 1) {
         // fast special case
         for (i = 0; i < outcount; i++)
             ((i8*) sc->data)[i] = (i32) ((byte) (data[i]) - 128);
     } else {
-        // general case
+        // only the width changes
         samplefrac = 0;
         fracstep = stepscale * 256;
         for (i = 0; i < outcount; i++) {
@@ -82,8 +203,188 @@ void ResampleSfx(sfx_t* sfx, i32 inrate, i32 inwidth, byte* data) {
     }
 }
 
+/*
+================
+ResampleSfx
+================
+*/
+void ResampleSfx(sfx_t* sfx, i32 inrate, i32 inwidth, byte* data) {
+    sfxcache_t* sc;
+
+    sc = Cache_Check(&sfx->cache);
+    if (!sc)
+        return;
+
+    S_ResampleSfxCache(sc, inrate, inwidth, data);
+}
+
+
+/*
+===============================================================================
+
+CONVERTED SAMPLES
+
+Converted sounds are also kept outside the zone cache, keyed by name and
+device rate, so a sound evicted from the cache is copied back in instead of
+being read and resampled again. Up to snd_resamplecache kilobytes are kept,
+the least recently used going first.
+
+===============================================================================
+*/
+
+#define MAX_CONVERTED 512
+
+typedef struct {
+    char name[MAX_QPATH];
+    i32 speed;      // device rate it was converted to
+    qboolean as8bit; // loadas8bit when converted
+    i32 size;
+    i32 lastused;
+    sfxcache_t* sc; // Q_malloc'ed
+} convertedsfx_t;
+
+static convertedsfx_t converted[MAX_CONVERTED];
+static i32 num_converted;
+static i32 converted_bytes;
+static i32 converted_clock;
+
+
+static void S_DropConverted(i32 i) {
+    converted_bytes -= converted[i].size;
+    Q_free(converted[i].sc);
+    converted[i] = converted[--num_converted];
+}
+
+static void S_DropOldestConverted(void) {
+    i32 oldest = 0;
+    for (i32 i = 1; i < num_converted; i++) {
+        if (converted[i].lastused < converted[oldest].lastused)
+            oldest = i;
+    }
+    S_DropConverted(oldest);
+}
+
+static convertedsfx_t* S_FindConverted(const char* name) {
+    const qboolean as8bit = loadas8bit.value != 0;
+    for (i32 i = 0; i < num_converted; i++) {
+        convertedsfx_t* c = &converted[i];
+        if (c->speed == shm->speed && c->as8bit == as8bit
+            && !Q_strcmp(c->name, name)) {
+            c->lastused = ++converted_clock;
+            return c;
+        }
+    }
+    return NULL;
+}
+
+/*
+================
+S_KeepConverted
+
+Takes ownership of sc, a Q_malloc'ed copy of a converted sound.
+================
+*/
+static void S_KeepConverted(const char* name, sfxcache_t* sc, i32 size) {
+    const i32 limit = (i32) (snd_resamplecache.value * 1024);
+    if (size > limit || S_FindConverted(name)) {
+        Q_free(sc);
+        return;
+    }
+
+    while (num_converted == MAX_CONVERTED || converted_bytes + size > limit) {
+        S_DropOldestConverted();
+    }
+
+    convertedsfx_t* c = &converted[num_converted++];
+    Q_strncpy(c->name, name, sizeof(c->name));
+    c->speed = shm->speed;
+    c->as8bit = loadas8bit.value != 0;
+    c->size = size;
+    c->lastused = ++converted_clock;
+    c->sc = sc;
+    converted_bytes += size;
+}
+
+// Copies a converted sound back into the zone cache, if we kept it.
+static sfxcache_t* S_CacheConverted(sfx_t* s) {
+    const convertedsfx_t* c = S_FindConverted(s->name);
+    if (!c) {
+        return NULL;
+    }
+    sfxcache_t* sc = Cache_Alloc(&s->cache, c->size, s->name);
+    if (sc) {
+        Q_memcpy(sc, c->sc, c->size);
+    }
+    return sc;
+}
+
+/*
+================
+S_UpdateResampleCache
+
+A lowered snd_resamplecache frees memory right away, not on the next
+sound kept.
+================
+*/
+void S_UpdateResampleCache(void) {
+    if (snd_resamplecache.value == old_resamplecache) {
+        return;
+    }
+    old_resamplecache = snd_resamplecache.value;
+
+    const i32 limit = (i32) (snd_resamplecache.value * 1024);
+    while (num_converted && converted_bytes > limit) {
+        S_DropOldestConverted();
+    }
+}
+
+/*
+================
+S_InitResampler
+================
+*/
+static void S_LoadReport_f(void);
+
+void S_InitResampler(void) {
+    S_InitSincTable();
+    Cvar_RegisterVariable(&snd_resamplecache);
+    Cmd_AddCommand("snd_loadreport", S_LoadReport_f);
+}
+
 //=============================================================================
 
+/*
+==============
+S_SfxCacheSize
+
+Returns the size of the sfxcache_t needed to hold the resampled sound
+==============
+*/
+static i32 S_SfxCacheSize(const wavinfo_t* info) {
+    float stepscale;
+    i32 len;
+
+    stepscale = (float) info->rate / shm->speed;
+    len = info->samples / stepscale;
+
+    len = len * S_ResampledWidth(info->rate, info->width) * info->channels;
+
+    return len + sizeof(sfxcache_t);
+}
+
+static void S_InitSfxCache(sfxcache_t* sc, const wavinfo_t* info) {
+    sc->length = info->samples;
+    sc->loopstart = info->loopstart;
+    sc->speed = info->rate;
+    sc->width = info->width;
+    sc->stereo = info->channels;
+}
+
+// Sounds this big are played from disk, see snd_sfxstream.c.
+static qboolean S_IsStreamed(i32 size) {
+    return snd_streamsize.value > 0 && size > snd_streamsize.value * 1024;
+}
+
 /*
 ==============
 S_LoadSound
@@ -93,8 +394,6 @@ sfxcache_t* S_LoadSound(sfx_t* s) {
     char namebuffer[256];
     byte* data;
     wavinfo_t info;
-    i32 len;
-    float stepscale;
     sfxcache_t* sc;
     byte stackbuf[1 * 1024]; // avoid dirtying the cache heap
 
@@ -103,6 +402,13 @@ sfxcache_t* S_LoadSound(sfx_t* s) {
     if (sc)
         return sc;
 
+    if (s->streamed)
+        return NULL;
+
+    sc = S_CacheConverted(s);
+    if (sc)
+        return sc;
+
     //Con_Printf ("S_LoadSound: %x\n", (i32)stackbuf);
     // load it in
     Q_strcpy(namebuffer, "sound/");
@@ -123,27 +429,288 @@ sfxcache_t* S_LoadSound(sfx_t* s) {
         return NULL;
     }
 
-    stepscale = (float) info.rate / shm->speed;
-    len = info.samples / stepscale;
-
-    len = len * info.width * info.channels;
+    const i32 size = S_SfxCacheSize(&info);
+    if (S_IsStreamed(size)) {
+        S_InitSfxCache(&s->streaminfo, &info);
+        s->streamed = true;
+        return NULL;
+    }
 
-    sc = Cache_Alloc(&s->cache, len + sizeof(sfxcache_t), s->name);
+    sc = Cache_Alloc(&s->cache, size, s->name);
     if (!sc)
         return NULL;
 
-    sc->length = info.samples;
-    sc->loopstart = info.loopstart;
-    sc->speed = info.rate;
-    sc->width = info.width;
-    sc->stereo = info.channels;
+    S_InitSfxCache(sc, &info);
+    S_ResampleSfxCache(sc, sc->speed, sc->width, data + info.dataofs);
 
-    ResampleSfx(s, sc->speed, sc->width, data + info.dataofs);
+    sfxcache_t* copy = Q_malloc(size);
+    if (copy) {
+        Q_memcpy(copy, sc, size);
+        S_KeepConverted(s->name, copy, size);
+    }
 
     return sc;
 }
 
 
+/*
+===============================================================================
+
+BACKGROUND LOADING
+
+Between S_BeginPrecaching and S_EndPrecaching, sounds are read on the main
+thread but parsed and resampled on the job threads into private buffers. The
+results are moved into the cache in precache order, so the cache layout does
+not depend on how the threads were scheduled.
+
+===============================================================================
+*/
+
+#define MAX_PENDING_SFX 512
+
+typedef struct {
+    sfx_t* sfx;
+    byte* file; // Q_malloc'ed wav file
+    i32 filelen;
+    sfxcache_t* sc; // Q_malloc'ed, filled in by the job
+    i32 size;
+    qboolean streamed; // too big, only streaminfo was filled in
+    qboolean nomem; // no room for sc, loaded synchronously instead
+    sfxcache_t streaminfo;
+    u64 readticks; // time spent on the main thread
+    u64 decodeticks; // time spent on the job
+} sfxjob_t;
+
+typedef struct {
+    sfx_t* sfx;
+    i32 size;
+    float readms;
+    float decodems;
+} sfxloadtime_t;
+
+static jobgroup_t* snd_precache_jobs;
+static sfxjob_t snd_pending[MAX_PENDING_SFX];
+static i32 snd_numpending;
+
+// Statistic Counters
+static sfxloadtime_t snd_loadtimes[MAX_PENDING_SFX];
+static i32 snd_numloadtimes;
+static u64 snd_precachestart;
+static float snd_precachems;
+
+
+static float S_TicksToMs(u64 ticks) {
+    return (float) (ticks * 1000.0 / SDL_GetPerformanceFrequency());
+}
+
+static void S_DecodeJob(void* data) {
+    sfxjob_t* job = data;
+    const u64 start = SDL_GetPerformanceCounter();
+
+    const wavinfo_t info = GetWavinfo(job->sfx->name, job->file, job->filelen);
+    if (info.channels > 1) {
+        Con_Printf("%s is a stereo sample\n", job->sfx->name);
+    } else if (info.channels == 1) {
+        job->size = S_SfxCacheSize(&info);
+        if (S_IsStreamed(job->size)) {
+            S_InitSfxCache(&job->streaminfo, &info);
+            job->streamed = true;
+            job->decodeticks = SDL_GetPerformanceCounter() - start;
+            return;
+        }
+        job->sc = Q_malloc(job->size);
+        if (job->sc) {
+            S_InitSfxCache(job->sc, &info);
+            S_ResampleSfxCache(job->sc, info.rate, info.width,
+                               job->file + info.dataofs);
+        } else {
+            job->nomem = true;
+        }
+    }
+
+    job->decodeticks = SDL_GetPerformanceCounter() - start;
+}
+
+static void S_FreeJob(sfxjob_t* job) {
+    Q_free(job->file);
+    Q_free(job->sc);
+    job->file = NULL;
+    job->sc = NULL;
+}
+
+/*
+==============
+S_QueueLoadSound
+
+Returns false if the sound can't be loaded in the background
+==============
+*/
+qboolean S_QueueLoadSound(sfx_t* s) {
+    char namebuffer[256];
+    sfxjob_t* job;
+    i32 i;
+
+    if (!snd_precache_jobs || snd_numpending == MAX_PENDING_SFX)
+        return false;
+
+    if (s->streamed || Cache_Check(&s->cache) || S_CacheConverted(s))
+        return true;
+
+    for (i = 0; i < snd_numpending; i++) {
+        if (snd_pending[i].sfx == s)
+            return true;
+    }
+
+    Q_strcpy(namebuffer, "sound/");
+    Q_strcat(namebuffer, s->name);
+
+    // the file system isn't thread safe, so only the read happens here
+    const u64 start = SDL_GetPerformanceCounter();
+    job = &snd_pending[snd_numpending];
+    job->file = COM_LoadMallocFile(namebuffer);
+    if (!job->file) {
+        Con_Printf("Couldn't load %s\n", namebuffer);
+        return true;
+    }
+
+    job->sfx = s;
+    job->filelen = com_filesize;
+    job->sc = NULL;
+    job->size = 0;
+    job->streamed = false;
+    job->nomem = false;
+    job->readticks = SDL_GetPerformanceCounter() - start;
+    job->decodeticks = 0;
+
+    snd_numpending++;
+    Jobs_Submit(snd_precache_jobs, S_DecodeJob, job);
+
+    return true;
+}
+
+static void S_DiscardPending(void) {
+    if (!snd_numpending)
+        return;
+
+    Jobs_Wait(snd_precache_jobs);
+    for (i32 i = 0; i < snd_numpending; i++)
+        S_FreeJob(&snd_pending[i]);
+    snd_numpending = 0;
+}
+
+void S_BeginPrecaching(jobgroup_t* jobs) {
+    S_DiscardPending();
+    snd_precache_jobs = jobs;
+    snd_precachestart = SDL_GetPerformanceCounter();
+    snd_numloadtimes = 0;
+}
+
+static const sfxloadtime_t* S_RecordLoadTime(const sfxjob_t* job) {
+    sfxloadtime_t* t = &snd_loadtimes[snd_numloadtimes++];
+    t->sfx = job->sfx;
+    t->size = job->size;
+    t->readms = S_TicksToMs(job->readticks);
+    t->decodems = S_TicksToMs(job->decodeticks);
+    return t;
+}
+
+/*
+==============
+S_EndPrecaching
+
+Waits for every queued sound, so nothing is still loading once the level
+starts.
+==============
+*/
+void S_EndPrecaching(void) {
+    const sfxloadtime_t* t;
+    sfxjob_t* job;
+    sfxcache_t* sc;
+    float readms = 0;
+    float decodems = 0;
+
+    if (!snd_precache_jobs)
+        return;
+
+    Jobs_Wait(snd_precache_jobs);
+    for (i32 i = 0; i < snd_numpending; i++) {
+        job = &snd_pending[i];
+        t = S_RecordLoadTime(job);
+        readms += t->readms;
+        decodems += t->decodems;
+        if (job->streamed) {
+            job->sfx->streaminfo = job->streaminfo;
+            job->sfx->streamed = true;
+        }
+        if (job->nomem) {
+            // straight into the cache, without the private buffer
+            S_FreeJob(job);
+            S_LoadSound(job->sfx);
+            continue;
+        }
+        if (!job->sc) {
+            S_FreeJob(job);
+            continue;
+        }
+        sc = Cache_Alloc(&job->sfx->cache, job->size, job->sfx->name);
+        if (sc)
+            Q_memcpy(sc, job->sc, job->size);
+        S_KeepConverted(job->sfx->name, job->sc, job->size);
+        job->sc = NULL;
+        S_FreeJob(job);
+    }
+    snd_precachems =
+        S_TicksToMs(SDL_GetPerformanceCounter() - snd_precachestart);
+    if (snd_numpending) {
+        Con_DPrintf("Loaded %i sounds in %.1f ms (%.1f ms read, %.1f ms "
+                    "decoded on %i workers)\n",
+                    snd_numpending, snd_precachems, readms, decodems,
+                    Jobs_NumWorkers());
+    }
+    snd_numpending = 0;
+    snd_precache_jobs = NULL;
+}
+
+static i32 S_CompareLoadTimes(const void* a, const void* b) {
+    const sfxloadtime_t* ta = a;
+    const sfxloadtime_t* tb = b;
+    const float da = ta->readms + ta->decodems;
+    const float db = tb->readms + tb->decodems;
+    return (da < db) - (da > db);
+}
+
+/*
+==============
+S_LoadReport_f
+
+Lists the sounds loaded by the last precache, slowest first
+==============
+*/
+static void S_LoadReport_f(void) {
+    static sfxloadtime_t sorted[MAX_PENDING_SFX];
+    float total = 0;
+    i32 i;
+
+    if (!snd_numloadtimes) {
+        Con_Printf("No sounds were loaded in the background\n");
+        return;
+    }
+
+    Q_memcpy(sorted, snd_loadtimes, snd_numloadtimes * sizeof(*sorted));
+    qsort(sorted, snd_numloadtimes, sizeof(*sorted), S_CompareLoadTimes);
+
+    Con_Printf("    read  decode    size name\n");
+    for (i = 0; i < snd_numloadtimes; i++) {
+        const sfxloadtime_t* t = &sorted[i];
+        Con_Printf("%6.2fms %6.2fms %7i %s\n", t->readms, t->decodems,
+                   t->size, t->sfx->name);
+        total += t->readms + t->decodems;
+    }
+    Con_Printf("%i sounds, %.1f ms of work in %.1f ms\n", snd_numloadtimes,
+               total, snd_precachems);
+}
+
+
 /*
 ===============================================================================
 
@@ -153,74 +720,77 @@ WAV loading
 */
 
 
-byte* data_p;
-byte* iff_end;
-byte* last_chunk;
-byte* iff_data;
-i32 iff_chunk_len;
+// GetWavinfo runs on the job threads, so the parse state is kept per call
+typedef struct {
+    byte* data_p;
+    byte* iff_end;
+    byte* last_chunk;
+    byte* iff_data;
+    i32 iff_chunk_len;
+} wavparse_t;
 
 
-i16 GetLittleShort(void) {
+static i16 GetLittleShort(wavparse_t* wp) {
     i16 val = 0;
-    val = *data_p;
-    val = val + (*(data_p + 1) << 8);
-    data_p += 2;
+    val = *wp->data_p;
+    val = val + (*(wp->data_p + 1) << 8);
+    wp->data_p += 2;
     return val;
 }
 
-i32 GetLittleLong(void) {
+static i32 GetLittleLong(wavparse_t* wp) {
     i32 val = 0;
-    val = *data_p;
-    val = val + (*(data_p + 1) << 8);
-    val = val + (*(data_p + 2) << 16);
-    val = val + (*(data_p + 3) << 24);
-    data_p += 4;
+    val = *wp->data_p;
+    val = val + (*(wp->data_p + 1) << 8);
+    val = val + (*(wp->data_p + 2) << 16);
+    val = val + (*(wp->data_p + 3) << 24);
+    wp->data_p += 4;
     return val;
 }
 
-void FindNextChunk(char* name) {
+static void FindNextChunk(wavparse_t* wp, char* name) {
     while (1) {
-        data_p = last_chunk;
+        wp->data_p = wp->last_chunk;
 
-        if (data_p >= iff_end) { // didn't find the chunk
-            data_p = NULL;
+        if (wp->data_p >= wp->iff_end) { // didn't find the chunk
+            wp->data_p = NULL;
             return;
         }
 
-        data_p += 4;
-        iff_chunk_len = GetLittleLong();
-        if (iff_chunk_len < 0) {
-            data_p = NULL;
+        wp->data_p += 4;
+        wp->iff_chunk_len = GetLittleLong(wp);
+        if (wp->iff_chunk_len < 0) {
+            wp->data_p = NULL;
             return;
         }
-        //if (iff_chunk_len > 1024 * 1024)
+        //if (wp->iff_chunk_len > 1024 * 1024)
         //    Sys_Error("FindNextChunk: %i length is past the 1 meg sanity limit",
-        //              iff_chunk_len);
-        data_p -= 8;
-        last_chunk = data_p + 8 + ((iff_chunk_len + 1) & ~1);
-        if (!Q_strncmp(data_p, name, 4))
+        //              wp->iff_chunk_len);
+        wp->data_p -= 8;
+        wp->last_chunk = wp->data_p + 8 + ((wp->iff_chunk_len + 1) & ~1);
+        if (!Q_strncmp(wp->data_p, name, 4))
             return;
     }
 }
 
-void FindChunk(char* name) {
-    last_chunk = iff_data;
-    FindNextChunk(name);
+static void FindChunk(wavparse_t* wp, char* name) {
+    wp->last_chunk = wp->iff_data;
+    FindNextChunk(wp, name);
 }
 
 
-void DumpChunks(void) {
+void DumpChunks(wavparse_t* wp) {
     char str[5];
 
     str[4] = 0;
-    data_p = iff_data;
+    wp->data_p = wp->iff_data;
     do {
-        Q_memcpy(str, data_p, 4);
-        data_p += 4;
-        iff_chunk_len = GetLittleLong();
-        Con_Printf("%p : %s (%d)\n", (data_p - 4), str, iff_chunk_len);
-        data_p += (iff_chunk_len + 1) & ~1;
-    } while (data_p < iff_end);
+        Q_memcpy(str, wp->data_p, 4);
+        wp->data_p += 4;
+        wp->iff_chunk_len = GetLittleLong(wp);
+        Con_Printf("%p : %s (%d)\n", (wp->data_p - 4), str, wp->iff_chunk_len);
+        wp->data_p += (wp->iff_chunk_len + 1) & ~1;
+    } while (wp->data_p < wp->iff_end);
 }
 
 /*
@@ -229,6 +799,8 @@ GetWavinfo
 ============
 */
 wavinfo_t GetWavinfo(char* name, byte* wav, i32 wavlength) {
+    wavparse_t parse;
+    wavparse_t* wp = &parse;
     wavinfo_t info;
     i32 i;
     i32 format;
@@ -239,52 +811,52 @@ wavinfo_t GetWavinfo(char* name, byte* wav, i32 wavlength) {
     if (!wav)
         return info;
 
-    iff_data = wav;
-    iff_end = wav + wavlength;
+    wp->iff_data = wav;
+    wp->iff_end = wav + wavlength;
 
     // find "RIFF" chunk
-    FindChunk("RIFF");
-    if (!(data_p && !Q_strncmp(data_p + 8, "WAVE", 4))) {
+    FindChunk(wp, "RIFF");
+    if (!(wp->data_p && !Q_strncmp(wp->data_p + 8, "WAVE", 4))) {
         Con_Printf("Missing RIFF/WAVE chunks\n");
         return info;
     }
 
     // get "fmt " chunk
-    iff_data = data_p + 12;
-    // DumpChunks ();
+    wp->iff_data = wp->data_p + 12;
+    // DumpChunks (wp);
 
-    FindChunk("fmt ");
-    if (!data_p) {
+    FindChunk(wp, "fmt ");
+    if (!wp->data_p) {
         Con_Printf("Missing fmt chunk\n");
         return info;
     }
-    data_p += 8;
-    format = GetLittleShort();
+    wp->data_p += 8;
+    format = GetLittleShort(wp);
     if (format != WAV_FORMAT_PCM) {
         Con_Printf("Microsoft PCM format only\n");
         return info;
     }
 
-    info.channels = GetLittleShort();
-    info.rate = GetLittleLong();
-    data_p += 4 + 2;
-    info.width = GetLittleShort() / 8;
+    info.channels = GetLittleShort(wp);
+    info.rate = GetLittleLong(wp);
+    wp->data_p += 4 + 2;
+    info.width = GetLittleShort(wp) / 8;
 
     // get cue chunk
-    FindChunk("cue ");
-    if (data_p) {
-        data_p += 32;
-        info.loopstart = GetLittleLong();
+    FindChunk(wp, "cue ");
+    if (wp->data_p) {
+        wp->data_p += 32;
+        info.loopstart = GetLittleLong(wp);
         //		Con_Printf("loopstart=%d\n", sfx->loopstart);
 
         // if the next chunk is a LIST chunk, look for a cue length marker
-        FindNextChunk("LIST");
-        if (data_p) {
+        FindNextChunk(wp, "LIST");
+        if (wp->data_p) {
             if (!Q_strncmp(
-                    data_p + 28, "mark",
+                    wp->data_p + 28, "mark",
                     4)) { // this is not a proper parse, but it works with cooledit...
-                data_p += 24;
-                i = GetLittleLong(); // samples in loop
+                wp->data_p += 24;
+                i = GetLittleLong(wp); // samples in loop
                 info.samples = info.loopstart + i;
                 //				Con_Printf("looped length: %i\n", i);
             }
@@ -293,22 +865,26 @@ wavinfo_t GetWavinfo(char* name, byte* wav, i32 wavlength) {
         info.loopstart = -1;
 
     // find data chunk
-    FindChunk("data");
-    if (!data_p) {
+    FindChunk(wp, "data");
+    if (!wp->data_p) {
         Con_Printf("Missing data chunk\n");
         return info;
     }
 
-    data_p += 4;
-    samples = GetLittleLong() / info.width;
+    wp->data_p += 4;
+    samples = GetLittleLong(wp) / info.width;
 
     if (info.samples) {
-        if (samples < info.samples)
-            Sys_Error("Sound %s has a bad loop length", name);
+        if (samples < info.samples) {
+            // not fatal, this can run on a job thread
+            Con_Printf("Sound %s has a bad loop length\n", name);
+            Q_memset(&info, 0, sizeof(info));
+            return info;
+        }
     } else
         info.samples = samples;
 
-    info.dataofs = data_p - wav;
+    info.dataofs = wp->data_p - wav;
 
     return info;
 }
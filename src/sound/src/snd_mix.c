@@ -21,6 +21,12 @@
 
 
 #include "sound.h"
+#include "cmd.h"
+#include "console.h"
+#include "snd_kernels.h"
+#include "snd_thread.h"
+#include "sys.h"
+#include <SDL_atomic.h>
 #include <SDL_stdinc.h>
 #include <stdlib.h>
 
@@ -28,68 +34,67 @@
 #define PAINTBUFFER_SIZE 2048
 portable_samplepair_t paintbuffer[PAINTBUFFER_SIZE];
 i32 snd_scaletable[32][256];
-i32 *snd_p, snd_linear_count;
-i16* snd_out;
 
 static i32 snd_vol;
 
+// Statistic Counters
+volatile i32 snd_paintedvoices;
+volatile i32 snd_virtualvoices;
+static i32 rawend; // s_rawend as of this S_PaintChannels
+
+#define FILTER_MAXQUALITY 5
+#define FILTER_MAXM       (102 + FILTER_MAXQUALITY * 24)
+#define FILTER_MAXTAPS    ((FILTER_MAXM + 17) / 16 * 4)
+// frames of input held at 11025Hz, enough for a full paintbuffer
+#define FILTER_HISTORY    (FILTER_MAXTAPS + PAINTBUFFER_SIZE / 4 + 1)
+
 typedef struct {
-    float* memory;  // kernelsize floats
-    float* kernel;  // kernelsize floats
-    i32 kernelsize; // M+1, rounded up to be a multiple of 16
+    float* history; // FILTER_HISTORY stereo frames, the last taps of them old
+    float* phases;  // 4 subkernels of taps stereo pairs, one per parity
+    i32 taps;       // per subkernel, kernelsize / 4
     i32 M;          // M value used to make kernel, even
-    i32 parity;     // 0-3
+    i32 parity;     // position of the next input sample, 0-3
     float f_c;      // cutoff frequency, [0..1], fraction of sample rate
 } filter_t;
 
+static filter_t lowpass;
 
-static void Snd_WriteLinearBlastStereo16(void) {
-    i32 i;
-    i32 val;
-
-    for (i = 0; i < snd_linear_count; i += 2) {
-        val = snd_p[i] / 256;
-        if (val > 0x7fff)
-            snd_out[i] = 0x7fff;
-        else if (val < (i16) 0x8000)
-            snd_out[i] = (i16) 0x8000;
-        else
-            snd_out[i] = val;
-
-        val = snd_p[i + 1] / 256;
-        if (val > 0x7fff)
-            snd_out[i + 1] = 0x7fff;
-        else if (val < (i16) 0x8000)
-            snd_out[i + 1] = (i16) 0x8000;
-        else
-            snd_out[i + 1] = val;
-    }
-}
 
-static void S_TransferStereo16(i32 endtime) {
-    i32 lpos;
-    i32 lpaintedtime;
+/*
+==============
+S_TransferStereo16
 
-    snd_p = (i32*) paintbuffer;
-    lpaintedtime = paintedtime;
+With mixmusic, the paint is clipped and the music added on the way out,
+instead of by S_ClipSamples and S_PaintMusic.
+==============
+*/
+static void S_TransferStereo16(i32 endtime, qboolean mixmusic) {
+    const portable_samplepair_t* paint = paintbuffer;
+    i32 lpaintedtime = paintedtime;
 
     while (lpaintedtime < endtime) {
         // handle recirculating buffer issues
-        lpos = lpaintedtime & ((shm->samples >> 1) - 1);
-
-        snd_out = (i16*) shm->buffer + (lpos << 1);
-
-        snd_linear_count = (shm->samples >> 1) - lpos;
-        if (lpaintedtime + snd_linear_count > endtime)
-            snd_linear_count = endtime - lpaintedtime;
-
-        snd_linear_count <<= 1;
+        const i32 lpos = lpaintedtime & ((shm->samples >> 1) - 1);
+        i16* out = (i16*) shm->buffer + (lpos << 1);
+
+        i32 count = (shm->samples >> 1) - lpos;
+        if (lpaintedtime + count > endtime)
+            count = endtime - lpaintedtime;
+
+        // the music ring wraps too, and may run out
+        const portable_samplepair_t* music = NULL;
+        if (mixmusic && lpaintedtime < rawend) {
+            const i32 s = lpaintedtime & (MAX_RAW_SAMPLES - 1);
+            count = SDL_min(count, MAX_RAW_SAMPLES - s);
+            count = SDL_min(count, rawend - lpaintedtime);
+            music = &s_rawsamples[s];
+        }
 
         // write a linear blast of samples
-        Snd_WriteLinearBlastStereo16();
+        SND_TransferStereo16(out, paint, music, count, mixmusic);
 
-        snd_p += snd_linear_count;
-        lpaintedtime += (snd_linear_count >> 1);
+        paint += count;
+        lpaintedtime += count;
     }
 }
 
@@ -99,7 +104,7 @@ static void S_TransferPaintBuffer(i32 endtime) {
     i32* p;
 
     if (shm->samplebits == 16 && shm->channels == 2) {
-        S_TransferStereo16(endtime);
+        S_TransferStereo16(endtime, false);
         return;
     }
 
@@ -212,25 +217,119 @@ static float* S_MakeWindowedKernel(i32 kernelsize, i32 M, float f_c) {
     return kernel;
 }
 
+static qboolean S_AllocFilter(filter_t* filter) {
+    const size_t historysize = 2 * FILTER_HISTORY * sizeof(float);
+    const size_t phasessize = 4 * 2 * FILTER_MAXTAPS * sizeof(float);
+    filter->history = (float*) SDL_SIMDAlloc(historysize);
+    filter->phases = (float*) SDL_SIMDAlloc(phasessize);
+    filter->M = 0;
+    if (!filter->history || !filter->phases) {
+        SDL_SIMDFree(filter->history);
+        SDL_SIMDFree(filter->phases);
+        filter->history = filter->phases = NULL;
+        return false;
+    }
+    return true;
+}
+
+static void S_FreeFilter(filter_t* filter) {
+    SDL_SIMDFree(filter->history);
+    SDL_SIMDFree(filter->phases);
+    filter->history = filter->phases = NULL;
+}
+
+/*
+==============
+S_UpdateFilter
+
+Splits the kernel into the 4 subkernels S_ApplyFilter picks from by
+parity, with each tap doubled so left and right share one inner product.
+==============
+*/
 static void S_UpdateFilter(filter_t* filter, i32 M, float f_c) {
     if (filter->f_c == f_c && filter->M == M) {
         // No need to update if cutoff frequency and
         // filter length are unchanged.
         return;
     }
-    if (filter->memory != NULL) {
-        Q_free(filter->memory);
-    }
-    if (filter->kernel != NULL) {
-        Q_free(filter->kernel);
+    // M + 1 rounded up to the next multiple of 16
+    const i32 kernelsize = (M + 1) + 16 - ((M + 1) % 16);
+    float* kernel = S_MakeWindowedKernel(kernelsize, M, f_c);
+    if (!kernel) {
+        return;
     }
     filter->M = M;
     filter->f_c = f_c;
     filter->parity = 0;
-    // M + 1 rounded up to the next multiple of 16
-    filter->kernelsize = (M + 1) + 16 - ((M + 1) % 16);
-    filter->memory = (float*) Q_calloc(filter->kernelsize, sizeof(float));
-    filter->kernel = S_MakeWindowedKernel(filter->kernelsize, M, f_c);
+    filter->taps = kernelsize / 4;
+    for (i32 parity = 0; parity < 4; parity++) {
+        float* phase = filter->phases + parity * 2 * filter->taps;
+        const i32 first = (4 - parity) % 4;
+        for (i32 k = 0; k < filter->taps; k++) {
+            // 4.0 factor is to increase volume by 12 dB; this is to make up
+            // the volume drop caused by the zero-filling this filter does.
+            phase[2 * k] = phase[2 * k + 1] = kernel[first + 4 * k] * 4.0f;
+        }
+    }
+    Q_memset(filter->history, 0, 2 * FILTER_HISTORY * sizeof(float));
+    Q_free(kernel);
+}
+
+/*
+==============
+S_FilterDot
+
+Inner product of count floats, interleaved left and right, count a
+multiple of 8. The kernel must be SIMD aligned, the input need not be.
+==============
+*/
+static void S_FilterDot(const float* input, const float* kernel, i32 count,
+                        float* left, float* right) {
+#if defined(SND_AVX)
+    __m256 acc = _mm256_setzero_ps();
+    for (i32 i = 0; i < count; i += 8) {
+        acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(input + i),
+                                               _mm256_load_ps(kernel + i)));
+    }
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    *left = _mm_cvtss_f32(sum);
+    *right = _mm_cvtss_f32(_mm_shuffle_ps(sum, sum, 1));
+#elif defined(SND_SSE)
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    for (i32 i = 0; i < count; i += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(input + i),
+                                           _mm_load_ps(kernel + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(input + i + 4),
+                                           _mm_load_ps(kernel + i + 4)));
+    }
+    __m128 sum = _mm_add_ps(acc0, acc1);
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    *left = _mm_cvtss_f32(sum);
+    *right = _mm_cvtss_f32(_mm_shuffle_ps(sum, sum, 1));
+#elif defined(SND_NEON)
+    float32x4_t acc0 = vdupq_n_f32(0);
+    float32x4_t acc1 = vdupq_n_f32(0);
+    for (i32 i = 0; i < count; i += 8) {
+        acc0 = vmlaq_f32(acc0, vld1q_f32(input + i), vld1q_f32(kernel + i));
+        acc1 = vmlaq_f32(acc1, vld1q_f32(input + i + 4), vld1q_f32(kernel + i + 4));
+    }
+    const float32x4_t acc = vaddq_f32(acc0, acc1);
+    const float32x2_t sum = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+    *left = vget_lane_f32(sum, 0);
+    *right = vget_lane_f32(sum, 1);
+#else
+    float val[4] = {0, 0, 0, 0};
+    for (i32 i = 0; i < count; i += 4) {
+        val[0] += input[i] * kernel[i];
+        val[1] += input[i + 1] * kernel[i + 1];
+        val[2] += input[i + 2] * kernel[i + 2];
+        val[3] += input[i + 3] * kernel[i + 3];
+    }
+    *left = val[0] + val[2];
+    *right = val[1] + val[3];
+#endif
 }
 
 /*
@@ -243,59 +342,51 @@ As an optimization, it decimates the audio to 11025Hz (setting every sample
 position that's not a multiple of 4 to 0), then convoluting with the filter
 kernel is 4x faster, because we can skip 3/4 of the input samples that are
 known to be 0 and skip 3/4 of the filter kernel.
+
+Only the samples that survive decimation are kept in the history, so each
+output is one contiguous inner product with the subkernel for its parity.
 ==============
 */
-static void S_ApplyFilter(filter_t* filter, i32* data, i32 stride, i32 count) {
-    // Set up the input buffer.
-    // Memory holds the previous filter->kernelsize samples of input.
-    float* input =
-        (float*) Q_malloc(sizeof(float) * (filter->kernelsize + count));
-    if (!input) {
-        return;
-    }
-    Q_memcpy(input, filter->memory, filter->kernelsize * sizeof(float));
-    for (i32 i = 0; i < count; i++) {
-        input[filter->kernelsize + i] =
-            (float) data[i * stride] / (32768.0f * 256.0f);
+static void S_ApplyFilter(filter_t* filter, portable_samplepair_t* data,
+                          i32 count) {
+    const i32 taps = filter->taps;
+    const i32 parity = filter->parity;
+    float* history = filter->history;
+
+    // Append the new samples at 11025Hz after the old ones.
+    float* input = history + 2 * taps;
+    i32 fresh = 0;
+    for (i32 i = (4 - parity) % 4; i < count; i += 4) {
+        input[2 * fresh] = (float) data[i].left;
+        input[2 * fresh + 1] = (float) data[i].right;
+        fresh++;
     }
 
-    // Copy out the last filter->kernelsize samples to 'memory' for next time.
-    Q_memcpy(filter->memory, input + count, filter->kernelsize * sizeof(float));
-
-    // Apply the filter
-    i32 parity = filter->parity;
-    const i32 kernelsize = filter->kernelsize;
-    const float* kernel = filter->kernel;
+    // Each output sees the taps samples before it, so outputs after a
+    // nonzero parity start counting from the first fresh one.
+    const i32 first = parity > 0;
     for (i32 i = 0; i < count; i++) {
-        const float* input_plus_i = input + i;
-        float val[4] = {0, 0, 0, 0};
-        for (i32 j = (4 - parity) % 4; j < kernelsize; j += 16) {
-            val[0] += kernel[j] * input_plus_i[j];
-            val[1] += kernel[j + 4] * input_plus_i[j + 4];
-            val[2] += kernel[j + 8] * input_plus_i[j + 8];
-            val[3] += kernel[j + 12] * input_plus_i[j + 12];
-        }
-        // 4.0 factor is to increase volume by 12 dB; this is to make up the
-        // volume drop caused by the zero-filling this filter does.
-        float valf =
-            (val[0] + val[1] + val[2] + val[3]) * (32768.0f * 256.0f * 4.0f);
-        data[i * stride] = (i32) valf;
-
-        parity = (parity + 1) % 4;
+        const i32 position = parity + i;
+        const float* start = history + 2 * (((position + 3) >> 2) - first);
+        const float* kernel = filter->phases + (position & 3) * 2 * taps;
+        float left, right;
+        S_FilterDot(start, kernel, 2 * taps, &left, &right);
+        data[i].left = (i32) left;
+        data[i].right = (i32) right;
     }
-    filter->parity = parity;
 
-    Q_free(input);
+    // Keep the last taps samples for next time.
+    Q_memmove(history, history + 2 * fresh, 2 * taps * sizeof(float));
+    filter->parity = (parity + count) & 3;
 }
 
-static void S_GetLowPassFilterInfo(i32* M, float* bw, float* fc) {
-    i32 filter_quality = (i32) snd_filterquality.value;
-    if (filter_quality < 1 || filter_quality > 5) {
+static void S_GetLowPassFilterInfo(i32 quality, i32* M, float* bw, float* fc) {
+    if (quality < 1 || quality > FILTER_MAXQUALITY) {
         // If invalid quality, set it to max quality.
-        filter_quality = 5;
+        quality = FILTER_MAXQUALITY;
     }
-    *M = 102 + (filter_quality * 24);
-    *bw = 0.885f + ((float) filter_quality * 0.015f);
+    *M = 102 + (quality * 24);
+    *bw = 0.885f + ((float) quality * 0.015f);
     *fc = (*bw * 11025 / 2.0f) / 44100.0f;
 }
 
@@ -305,18 +396,65 @@ S_LowpassFilter
 
 lowpass filters 24-bit integer samples in 'data' (stored in 32-bit ints).
 assumes 44100Hz sample rate, and lowpasses at around 5kHz
-memory should be a zero-filled filter_t struct
 ==============
 */
-static void S_LowPassFilter(i32* data, i32 stride, i32 count,
-                            filter_t* memory) {
+static void S_LowPassFilter(portable_samplepair_t* data, i32 count,
+                            i32 quality, filter_t* filter) {
     i32 M;
     float bw;
     float fc;
-    S_GetLowPassFilterInfo(&M, &bw, &fc);
+    S_GetLowPassFilterInfo(quality, &M, &bw, &fc);
 
-    S_UpdateFilter(memory, M, fc);
-    S_ApplyFilter(memory, data, stride, count);
+    S_UpdateFilter(filter, M, fc);
+    S_ApplyFilter(filter, data, count);
+}
+
+/*
+==============
+S_FilterBench_f
+
+snd_filterbench [seconds]
+Filters a loud, busy scene at every snd_filterquality and prints the cost.
+==============
+*/
+static void S_FilterBench_f(void) {
+    static portable_samplepair_t scene[PAINTBUFFER_SIZE];
+    filter_t filter;
+
+    const double seconds = Cmd_Argc() > 1 ? Q_atof(Cmd_Argv(1)) : 10;
+    const i32 total = (i32) (seconds * 44100);
+    if (total <= 0) {
+        Con_Printf("usage: snd_filterbench [seconds]\n");
+        return;
+    }
+    if (!S_AllocFilter(&filter)) {
+        Con_Printf("snd_filterbench: out of memory\n");
+        return;
+    }
+
+    Con_Printf("%i samples through the %s filter\n", total, SND_KernelName());
+    for (i32 quality = 1; quality <= FILTER_MAXQUALITY; quality++) {
+        u32 seed = 1;
+        double elapsed = 0;
+        filter.M = 0;
+        for (i32 done = 0; done < total; done += PAINTBUFFER_SIZE) {
+            const i32 count = SDL_min(total - done, PAINTBUFFER_SIZE);
+            // Many loud channels summed and clipped, as S_ClipSamples
+            // leaves them.
+            for (i32 i = 0; i < count; i++) {
+                seed = seed * 1664525 + 1013904223;
+                scene[i].left = (i32) (seed >> 8) - (1 << 23);
+                seed = seed * 1664525 + 1013904223;
+                scene[i].right = (i32) (seed >> 8) - (1 << 23);
+            }
+            const double start = Sys_FloatTime();
+            S_LowPassFilter(scene, count, quality, &filter);
+            elapsed += Sys_FloatTime() - start;
+        }
+        Con_Printf("quality %i: %3i taps, %7.2f us per 1024 samples\n",
+                   quality, filter.taps, elapsed * 1e6 * 1024 / total);
+    }
+    S_FreeFilter(&filter);
 }
 
 /*
@@ -327,54 +465,40 @@ CHANNEL MIXING
 ===============================================================================
 */
 
-static void SND_PaintChannelFrom8(channel_t* ch, sfxcache_t* sc, i32 count,
-                                  i32 paintbufferstart);
-static void SND_PaintChannelFrom16(channel_t* ch, sfxcache_t* sc, i32 count,
+static void SND_PaintChannelFrom8(voice_t* ch, i32 count, i32 paintbufferstart);
+static void SND_PaintChannelFrom16(voice_t* ch, i32 count,
                                    i32 paintbufferstart);
+static void SND_PaintChannelFromStream(voice_t* ch, i32 count,
+                                       i32 paintbufferstart);
 
 static void S_PaintMusic(i32 end) {
     // Copy from the streaming sound source.
-    i32 stop = SDL_min(end, s_rawend);
-    for (i32 i = paintedtime; i < stop; i++) {
+    i32 stop = SDL_min(end, rawend);
+    for (i32 i = paintedtime; i < stop;) {
         i32 s = i & (MAX_RAW_SAMPLES - 1);
-        const portable_samplepair_t* raw_sample = &s_rawsamples[s];
-        portable_samplepair_t* sample = &paintbuffer[i - paintedtime];
-        // Lower music by 6db to match sfx.
-        sample->left += (raw_sample->left / 2);
-        sample->right += (raw_sample->right / 2);
+        i32 count = SDL_min(stop - i, MAX_RAW_SAMPLES - s);
+        SND_AddMusic(&paintbuffer[i - paintedtime], &s_rawsamples[s], count);
+        i += count;
     }
 }
 
 static void S_ApplyLowPassFilter(i32 end) {
-    static filter_t memory_l;
-    static filter_t memory_r;
-
-    i32* data = (i32*) paintbuffer;
-    i32 stride = 2;
-    i32 count = end - paintedtime;
-    S_LowPassFilter(data, stride, count, &memory_l);
-    S_LowPassFilter(data + 1, stride, count, &memory_r);
+    if (!lowpass.history) {
+        return;
+    }
+    const i32 quality = snd_mixsettings.filterquality;
+    S_LowPassFilter(paintbuffer, end - paintedtime, quality, &lowpass);
 }
 
-//
-// Clip each sample to 0dB, then reduce by 6dB (to leave some
-// headroom for the lowpass filter and the music). The lowpass
-// will smooth out the clipping.
-//
 static void S_ClipSamples(i32 end) {
-    i32 min = -32768 * 256;
-    i32 max = 32767 * 256;
-    for (i32 i = 0; i < end - paintedtime; i++) {
-        portable_samplepair_t* sample = &paintbuffer[i];
-        sample->left = SDL_clamp(sample->left, min, max) / 2;
-        sample->right = SDL_clamp(sample->right, min, max) / 2;
-    }
+    SND_ClipSamples(paintbuffer, end - paintedtime);
 }
 
 //
-// Paint channel up to end.
+// Paint channel up to end. A virtual channel only moves along.
 //
-static void S_PaintSfxChannel(channel_t* ch, sfxcache_t* sc, i32 end) {
+static void S_PaintSfxChannel(voice_t* ch, i32 end, qboolean audible) {
+    const sfxcache_t* sc = ch->sc;
     i32 ltime = paintedtime;
 
     // paint up to end
@@ -385,10 +509,14 @@ static void S_PaintSfxChannel(channel_t* ch, sfxcache_t* sc, i32 end) {
             // the last param to SND_PaintChannelFrom is the index
             // to start painting to in the paintbuffer, usually 0.
             i32 start = ltime - paintedtime;
-            if (sc->width == 1) {
-                SND_PaintChannelFrom8(ch, sc, count, start);
+            if (ch->stream) {
+                SND_PaintChannelFromStream(ch, count, start);
+            } else if (!audible) {
+                ch->pos += count;
+            } else if (sc->width == 1) {
+                SND_PaintChannelFrom8(ch, count, start);
             } else {
-                SND_PaintChannelFrom16(ch, sc, count, start);
+                SND_PaintChannelFrom16(ch, count, start);
             }
             ltime += count;
         }
@@ -400,7 +528,7 @@ static void S_PaintSfxChannel(channel_t* ch, sfxcache_t* sc, i32 end) {
                 ch->end = ltime + sc->length - ch->pos;
             } else {
                 // channel just stopped
-                ch->sfx = NULL;
+                S_StopVoice(ch);
                 break;
             }
         }
@@ -408,19 +536,25 @@ static void S_PaintSfxChannel(channel_t* ch, sfxcache_t* sc, i32 end) {
 }
 
 static void S_PaintSfx(i32 end) {
-    for (i32 i = 0; i < total_channels; i++) {
-        channel_t* ch = &snd_channels[i];
-        if (!ch->sfx) {
-            continue;
-        }
-        if (!ch->leftvol && !ch->rightvol) {
+    i32 painted = 0;
+    i32 virtual = 0;
+
+    for (i32 i = 0; i < MAX_CHANNELS; i++) {
+        voice_t* ch = &snd_voices[i];
+        if (!ch->sc) {
             continue;
         }
-        sfxcache_t* sc = S_LoadSound(ch->sfx);
-        if (sc) {
-            S_PaintSfxChannel(ch, sc, end);
+        const qboolean audible = ch->leftvol || ch->rightvol;
+        if (audible) {
+            painted++;
+        } else {
+            virtual++;
         }
+        S_PaintSfxChannel(ch, end, audible);
     }
+
+    snd_paintedvoices = painted;
+    snd_virtualvoices = virtual;
 }
 
 static void S_ClearPaintBuffer(i32 end) {
@@ -428,8 +562,19 @@ static void S_ClearPaintBuffer(i32 end) {
     Q_memset(paintbuffer, 0, size);
 }
 
+/*
+==============
+S_PaintChannels
+
+Called on the mixer's thread, see S_MixerUpdate.
+==============
+*/
 void S_PaintChannels(i32 endtime) {
-    snd_vol = (i32) (sfxvolume.value * 256);
+    snd_vol = (i32) (snd_mixsettings.volume * 256);
+
+    // The game thread publishes s_rawend after the samples below it.
+    rawend = s_rawend;
+    SDL_MemoryBarrierAcquire();
 
     while (paintedtime < endtime) {
         // If paintbuffer is smaller than DMA buffer.
@@ -437,11 +582,18 @@ void S_PaintChannels(i32 endtime) {
 
         S_ClearPaintBuffer(end);
         S_PaintSfx(end);
+        const qboolean lowpass = snd_mixsettings.lowpass;
+        if (!lowpass && shm->samplebits == 16 && shm->channels == 2) {
+            // Clip, add music and transfer in one pass.
+            S_TransferStereo16(end, true);
+            paintedtime = end;
+            continue;
+        }
         S_ClipSamples(end);
-        if (sndspeed.value == 11025 && shm->speed == 44100) {
+        if (lowpass) {
             S_ApplyLowPassFilter(end);
         }
-        if (s_rawend >= paintedtime) {
+        if (rawend >= paintedtime) {
             S_PaintMusic(end);
         }
         // Transfer out according to DMA format.
@@ -451,12 +603,27 @@ void S_PaintChannels(i32 endtime) {
     }
 }
 
+/*
+================
+S_InitPaintChannels
+
+The filter state lives as long as the mixer, sized for the best quality.
+================
+*/
+void S_InitPaintChannels(void) {
+    if (!lowpass.history && !S_AllocFilter(&lowpass)) {
+        Con_Printf("Not enough memory for the lowpass filter\n");
+    }
+    Cmd_AddCommand("snd_filterbench", S_FilterBench_f);
+    Cmd_AddCommand("snd_kernelcheck", SND_KernelCheck_f);
+}
+
 void SND_InitScaletable(void) {
     i32 i, j;
     i32 scale;
 
     for (i = 0; i < 32; i++) {
-        scale = (i32) ((float) i * 8.0f * 256.0f * sfxvolume.value);
+        scale = (i32) ((float) i * 8.0f * 256.0f * snd_mixsettings.volume);
         for (j = 0; j < 256; j++) {
             snd_scaletable[i][j] = ((i8) j) * scale;
         }
@@ -464,56 +631,57 @@ void SND_InitScaletable(void) {
 }
 
 
-static void SND_PaintChannelFrom8(channel_t* ch, sfxcache_t* sc, i32 count,
-                                  i32 paintbufferstart) {
-    i32 data;
-    i32 *lscale, *rscale;
-    byte* sfx;
-    i32 i;
-
+static void SND_PaintChannelFrom8(voice_t* ch, i32 count, i32 paintbufferstart) {
     if (ch->leftvol > 255)
         ch->leftvol = 255;
     if (ch->rightvol > 255)
         ch->rightvol = 255;
 
-    lscale = snd_scaletable[ch->leftvol >> 3];
-    rscale = snd_scaletable[ch->rightvol >> 3];
-    sfx = (byte*) sc->data + ch->pos;
-
-    for (i = 0; i < count; i++) {
-        data = sfx[i];
-        paintbuffer[paintbufferstart + i].left += lscale[data];
-        paintbuffer[paintbufferstart + i].right += rscale[data];
-    }
+    // snd_scaletable[v][j] is (i8) j times snd_scaletable[v][1]
+    const i32 lscale = snd_scaletable[ch->leftvol >> 3][1];
+    const i32 rscale = snd_scaletable[ch->rightvol >> 3][1];
+    const byte* sfx = (byte*) ch->sc->data + ch->pos;
+    SND_PaintStereo8(paintbuffer + paintbufferstart, sfx, count, lscale, rscale);
 
     ch->pos += count;
 }
 
-static void SND_PaintChannelFrom16(channel_t* ch, sfxcache_t* sc, i32 count,
+static void SND_PaintChannelFrom16(voice_t* ch, i32 count,
                                    i32 paintbufferstart) {
-    i32 data;
-    i32 left, right;
     i32 leftvol, rightvol;
-    i16* sfx;
-    i32 i;
 
+    // this was causing integer overflow as observed in quakespasm
+    // with the warpspasm mod moved >>8 to left/right volume here.
     leftvol = ch->leftvol * snd_vol;
     rightvol = ch->rightvol * snd_vol;
     leftvol /= 256;
     rightvol /= 256;
-    sfx = (i16*) sc->data + ch->pos;
-
-    for (i = 0; i < count; i++) {
-        data = sfx[i];
-        // this was causing integer overflow as observed in quakespasm
-        // with the warpspasm mod moved >>8 to left/right volume above.
-        //	left = (data * leftvol) >> 8;
-        //	right = (data * rightvol) >> 8;
-        left = data * leftvol;
-        right = data * rightvol;
-        paintbuffer[paintbufferstart + i].left += left;
-        paintbuffer[paintbufferstart + i].right += right;
+    const i16* sfx = (i16*) ch->sc->data + ch->pos;
+    SND_PaintStereo16(paintbuffer + paintbufferstart, sfx, count, leftvol, rightvol);
+
+    ch->pos += count;
+}
+
+//
+// A streamed voice takes its samples in order from the ring, whatever its
+// pos says, since the stream loops by itself. A virtual one only skips.
+//
+static void SND_PaintChannelFromStream(voice_t* ch, i32 count,
+                                       i32 paintbufferstart) {
+    static i16 samples[PAINTBUFFER_SIZE];
+
+    if (!ch->leftvol && !ch->rightvol) {
+        S_ReadSfxStream(ch->stream, NULL, count);
+        ch->pos += count;
+        return;
     }
 
+    const i32 leftvol = ch->leftvol * snd_vol / 256;
+    const i32 rightvol = ch->rightvol * snd_vol / 256;
+    const i32 got = S_ReadSfxStream(ch->stream, samples, count);
+    // an empty ring leaves silence, the voice keeps time
+    SND_PaintStereo16(paintbuffer + paintbufferstart, samples, got, leftvol,
+                      rightvol);
+
     ch->pos += count;
 }
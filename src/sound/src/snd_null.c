@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) 1996-1997 Id Software, Inc.
+ * Copyright (C) Henrique Barateli, <henriquejb194@gmail.com>, et al.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+// snd_null.c -- offline DMA, mixing to memory or a wav file
+
+
+#include "snd_null.h"
+#include "common.h"
+#include "console.h"
+#include "crc.h"
+#include "host.h"
+#include "sys.h"
+#include <SDL_stdinc.h>
+
+
+#define NULL_BUFFER_SAMPLES (1 << 16) // mono samples, 0.74s at 44.1kHz
+
+qboolean snd_offline = false;
+
+static double null_clock;     // in sample pairs, where the device should be
+static i32 null_played;       // sample pairs played so far
+static i32 null_frame = -1;   // host frame the clock last moved in
+
+static i32 null_wav = -1;     // file handle, -1 when discarding
+static char null_wavname[MAX_OSPATH];
+static u16 null_crc;          // of everything played
+
+
+static byte* SNDDMA_PutLong(byte* p, i32 v) {
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+    p[2] = (v >> 16) & 0xff;
+    p[3] = (v >> 24) & 0xff;
+    return p + 4;
+}
+
+static byte* SNDDMA_PutShort(byte* p, i32 v) {
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+    return p + 2;
+}
+
+static byte* SNDDMA_PutTag(byte* p, const char* tag) {
+    Q_memcpy(p, tag, 4);
+    return p + 4;
+}
+
+static void SNDDMA_WriteWavHeader(void) {
+    const i32 width = shm->samplebits / 8;
+    const i32 bytes = null_played * shm->channels * width;
+    byte header[44];
+    byte* p = header;
+
+    p = SNDDMA_PutTag(p, "RIFF");
+    p = SNDDMA_PutLong(p, 36 + bytes);
+    p = SNDDMA_PutTag(p, "WAVE");
+    p = SNDDMA_PutTag(p, "fmt ");
+    p = SNDDMA_PutLong(p, 16);
+    p = SNDDMA_PutShort(p, WAV_FORMAT_PCM);
+    p = SNDDMA_PutShort(p, shm->channels);
+    p = SNDDMA_PutLong(p, shm->speed);
+    p = SNDDMA_PutLong(p, shm->speed * shm->channels * width);
+    p = SNDDMA_PutShort(p, shm->channels * width);
+    p = SNDDMA_PutShort(p, shm->samplebits);
+    p = SNDDMA_PutTag(p, "data");
+    SNDDMA_PutLong(p, bytes);
+
+    Sys_FileSeek(null_wav, 0);
+    Sys_FileWrite(null_wav, header, sizeof(header));
+}
+
+qboolean SNDDMA_NullInit(dma_t* dma) {
+    Q_memset((void*) dma, 0, sizeof(dma_t));
+    shm = dma;
+
+    shm->samplebits = (loadas8bit.value != 0) ? 8 : 16;
+    shm->signed8 = 0;
+    shm->speed = (i32) snd_mixspeed.value;
+    shm->channels = 2;
+    shm->samplepos = 0;
+    shm->submission_chunk = 1;
+    shm->samples = NULL_BUFFER_SAMPLES;
+    shm->buffer = (byte*) Q_calloc(1, shm->samples * (shm->samplebits / 8));
+    if (!shm->buffer) {
+        shm = NULL;
+        Con_Printf("Failed allocating memory for offline audio\n");
+        return false;
+    }
+
+    snd_offline = true;
+    null_clock = 0;
+    null_played = 0;
+    null_frame = -1;
+    CRC_Init(&null_crc);
+
+    i32 i = COM_CheckParm("-sndwav");
+    if (i && i < com_argc - 1) {
+        snprintf(null_wavname, sizeof(null_wavname), "%s/%s", com_gamedir,
+                 com_argv[i + 1]);
+        null_wav = Sys_FileOpenWrite(null_wavname);
+        SNDDMA_WriteWavHeader();
+        Con_Printf("Audio: offline, writing %s\n", null_wavname);
+    } else {
+        Con_Printf("Audio: offline, discarding output\n");
+    }
+    return true;
+}
+
+/*
+==============
+SNDDMA_NullPlay
+
+Hands count sample pairs from the ring to whoever listens.
+==============
+*/
+void SNDDMA_NullPlay(i32 count) {
+    const i32 width = shm->samplebits / 8;
+    const i32 frames = shm->samples / shm->channels;
+    i16 swapped[1024];
+
+    while (count > 0) {
+        const i32 pos = null_played & (frames - 1);
+        const i32 n = SDL_min(count, SDL_min(frames - pos, 512));
+        byte* data = shm->buffer + pos * shm->channels * width;
+        const i32 bytes = n * shm->channels * width;
+
+        for (i32 i = 0; i < bytes; i++) {
+            CRC_ProcessByte(&null_crc, data[i]);
+        }
+        if (null_wav != -1) {
+            if (width == 2) {
+                // wav is little endian
+                for (i32 i = 0; i < n * shm->channels; i++) {
+                    swapped[i] = LittleShort(((i16*) data)[i]);
+                }
+                data = (byte*) swapped;
+            }
+            Sys_FileWrite(null_wav, data, bytes);
+        }
+
+        null_played += n;
+        count -= n;
+    }
+
+    shm->samplepos = (null_played & (frames - 1)) * shm->channels;
+}
+
+/*
+==============
+SNDDMA_NullGetDMAPos
+
+Moves the clock on once a frame. Nothing is played until the mixer has
+painted it, see S_MixerUpdateOffline.
+==============
+*/
+i32 SNDDMA_NullGetDMAPos(void) {
+    const i32 frames = shm->samples / shm->channels;
+
+    if (host_framecount != null_frame) {
+        null_frame = host_framecount;
+        null_clock += host_frametime * shm->speed;
+    }
+
+    shm->samplepos = (null_played & (frames - 1)) * shm->channels;
+    return shm->samplepos;
+}
+
+/*
+==============
+SNDDMA_NullPending
+
+Sample pairs the clock is ahead of what was played. Never more than half
+the ring at once, so the mixer sees it wrap.
+==============
+*/
+i32 SNDDMA_NullPending(void) {
+    const i32 frames = shm->samples / shm->channels;
+    const i32 count = (i32) null_clock - null_played;
+    return SDL_min(count, frames / 2);
+}
+
+void SNDDMA_NullInfo(void) {
+    Con_Printf("offline: %i samples, %.1f seconds, crc %04x\n", null_played,
+               (double) null_played / shm->speed, CRC_Value(null_crc));
+}
+
+void SNDDMA_NullShutdown(void) {
+    SNDDMA_NullInfo();
+    if (null_wav != -1) {
+        SNDDMA_WriteWavHeader();
+        Sys_FileClose(null_wav);
+        null_wav = -1;
+    }
+    Q_free(shm->buffer);
+    shm->buffer = NULL;
+    shm = NULL;
+    snd_offline = false;
+}
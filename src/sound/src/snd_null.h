@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 1996-1997 Id Software, Inc.
+ * Copyright (C) Henrique Barateli, <henriquejb194@gmail.com>, et al.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+// snd_null.h -- offline DMA, mixing to memory or a wav file
+
+#ifndef _SND_NULL_H_
+#define _SND_NULL_H_
+
+
+#include "sound.h"
+
+//
+// With -sndnull or -sndwav <file> no audio device is opened. The mix goes
+// to memory, and with -sndwav on to a wav file in the game directory. The
+// offline device plays host_frametime worth of samples each frame, so
+// with host_framerate set a demo renders the same audio every run, as fast
+// as frames can be run. Mixing stays on the main thread, and paints
+// exactly up to the device's clock whatever _snd_mixahead is.
+//
+
+extern qboolean snd_offline;
+
+qboolean SNDDMA_NullInit(dma_t* dma);
+i32 SNDDMA_NullGetDMAPos(void);
+i32 SNDDMA_NullPending(void);
+// Sample pairs the device should play before the mixer paints more.
+
+void SNDDMA_NullPlay(i32 count);
+// Plays count painted sample pairs from the ring.
+
+void SNDDMA_NullShutdown(void);
+
+void SNDDMA_NullInfo(void);
+// Prints how much was rendered, and its crc to compare runs with.
+
+#endif
@@ -21,6 +21,7 @@
 
 #include "sound.h"
 #include "console.h"
+#include "snd_null.h"
 #include <SDL.h>
 
 
@@ -164,6 +165,9 @@ static qboolean SNDDMA_OpenDevice(SDL_AudioSpec* device) {
 
 qboolean SNDDMA_Init(dma_t* dma) {
     SDL_AudioSpec desired;
+    if (COM_CheckParm("-sndnull") || COM_CheckParm("-sndwav")) {
+        return SNDDMA_NullInit(dma);
+    }
     if (SDL_InitSubSystem(SDL_INIT_AUDIO) < 0) {
         Con_Printf("Couldn't init SDL audio: %s\n", SDL_GetError());
         return false;
@@ -182,6 +186,9 @@ qboolean SNDDMA_Init(dma_t* dma) {
 }
 
 i32 SNDDMA_GetDMAPos(void) {
+    if (snd_offline) {
+        return SNDDMA_NullGetDMAPos();
+    }
     return shm->samplepos;
 }
 
@@ -189,6 +196,10 @@ void SNDDMA_Shutdown(void) {
     if (!shm) {
         return;
     }
+    if (snd_offline) {
+        SNDDMA_NullShutdown();
+        return;
+    }
     Con_Printf("Shutting down SDL sound\n");
     SDL_CloseAudio();
     SDL_QuitSubSystem(SDL_INIT_AUDIO);
@@ -200,17 +211,25 @@ void SNDDMA_Shutdown(void) {
 }
 
 void SNDDMA_LockBuffer(void) {
-    SDL_LockAudio();
+    if (!snd_offline) {
+        SDL_LockAudio();
+    }
 }
 
 void SNDDMA_Submit(void) {
-    SDL_UnlockAudio();
+    if (!snd_offline) {
+        SDL_UnlockAudio();
+    }
 }
 
 void SNDDMA_BlockSound(void) {
-    SDL_PauseAudio(1);
+    if (!snd_offline) {
+        SDL_PauseAudio(1);
+    }
 }
 
 void SNDDMA_UnblockSound(void) {
-    SDL_PauseAudio(0);
+    if (!snd_offline) {
+        SDL_PauseAudio(0);
+    }
 }
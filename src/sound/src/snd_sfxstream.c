@@ -0,0 +1,335 @@
+/*
+ * Copyright (C) 1996-1997 Id Software, Inc.
+ * Copyright (C) Henrique Barateli, <henriquejb194@gmail.com>, et al.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+// snd_sfxstream.c -- long sound effects played from disk
+
+
+#include "snd_sfxstream.h"
+#include "console.h"
+#include "snd_codec.h"
+#include <SDL_atomic.h>
+
+
+#define SFXSTREAM_SIZE   (1 << 15) // samples, must be a power of two
+#define SFXSTREAM_DECODE 4096      // file samples read at a time
+#define SFXSTREAM_PRIME  8192      // samples ready when a stream opens
+
+struct sfxstream_s {
+    i16 ring[SFXSTREAM_SIZE];
+    SDL_atomic_t written; // samples ever written, by the game thread
+    SDL_atomic_t read;    // samples ever read, by the mixer
+    SDL_atomic_t ended;   // the game thread wrote the last sample
+    SDL_atomic_t released; // the mixer no longer uses the stream
+
+    // The rest belongs to the game thread.
+    qboolean inuse;
+    sfx_t* sfx;
+    snd_stream_t* file;
+    qboolean finished;
+    i32 skip;     // resampled samples to drop, for a late start
+    i32 filepos;  // file samples read since the start of the file
+    i32 discard;  // file samples to drop, after a rewind to the loop
+    double step;  // file samples per resampled sample
+    double frac;  // position between a and b
+    i32 a, b;
+    i16 decoded[SFXSTREAM_DECODE];
+    i32 decodedpos;
+    i32 decodedcount;
+};
+
+cvar_t snd_streamsize = {"snd_streamsize", "1024", true}; // KB, 0 = never
+
+static sfxstream_t* sfx_streams[MAX_SFX_STREAMS];
+
+volatile i32 snd_streamunderruns;
+
+
+void S_InitSfxStreams(void) {
+    Cvar_RegisterVariable(&snd_streamsize);
+}
+
+/*
+================
+S_SfxStreamInfo
+
+The header of a streamed sound as if it had been resampled, which is what
+the channels and voices go by.
+================
+*/
+void S_SfxStreamInfo(const sfx_t* sfx, sfxcache_t* sc) {
+    const float stepscale = (float) sfx->streaminfo.speed / shm->speed;
+
+    sc->length = sfx->streaminfo.length / stepscale;
+    sc->loopstart = sfx->streaminfo.loopstart;
+    if (sc->loopstart != -1)
+        sc->loopstart = sc->loopstart / stepscale;
+    sc->speed = shm->speed;
+    sc->width = 2;
+    sc->stereo = 0;
+}
+
+/*
+================
+S_DecodeSfxStream
+
+Reads the next block of the file as 16 bit samples, going back to the loop
+start at the end of the file.
+================
+*/
+static qboolean S_DecodeSfxStream(sfxstream_t* s) {
+    byte raw[SFXSTREAM_DECODE * 2];
+    const sfxcache_t* info = &s->sfx->streaminfo;
+    const i32 width = s->file->info.width;
+    qboolean rewound = false;
+
+    while (1) {
+        // a looped sound ends at its loop marker, not the end of the data
+        const i32 left = SDL_min(info->length - s->filepos, SFXSTREAM_DECODE);
+        i32 bytes = 0;
+        if (left > 0) {
+            bytes = S_CodecReadStream(s->file, left * width, raw);
+        }
+        if (bytes <= 0) {
+            // a second rewind in a row means there is nothing to loop
+            if (info->loopstart < 0 || rewound
+                || S_CodecRewindStream(s->file) < 0) {
+                return false;
+            }
+            s->filepos = 0;
+            s->discard = info->loopstart;
+            rewound = true;
+            continue;
+        }
+
+        const i32 count = bytes / width;
+        if (width == 1) {
+            for (i32 i = 0; i < count; i++) {
+                s->decoded[i] = (i16) ((raw[i] - 128) << 8);
+            }
+        } else {
+            // S_WAV_CodecReadStream has already swapped these to host order
+            Q_memcpy(s->decoded, raw, count * 2);
+        }
+        s->filepos += count;
+        s->decodedcount = count;
+        s->decodedpos = SDL_min(s->discard, count);
+        s->discard -= s->decodedpos;
+        if (s->decodedpos < count) {
+            return true;
+        }
+    }
+}
+
+/*
+================
+S_NextSfxSample
+
+Linear interpolation from the file's rate to the device's. The sinc used
+for cached sounds wants the whole sound at hand.
+================
+*/
+static qboolean S_NextSfxSample(sfxstream_t* s, i16* out) {
+    while (s->frac >= 1.0) {
+        if (s->decodedpos == s->decodedcount && !S_DecodeSfxStream(s)) {
+            return false;
+        }
+        s->a = s->b;
+        s->b = s->decoded[s->decodedpos++];
+        s->frac -= 1.0;
+    }
+    *out = (i16) (s->a + (s->b - s->a) * s->frac);
+    s->frac += s->step;
+    return true;
+}
+
+/*
+================
+S_FillSfxStream
+
+Resamples until the ring holds limit samples the mixer hasn't read.
+================
+*/
+static void S_FillSfxStream(sfxstream_t* s, const u32 limit) {
+    const u32 read = (u32) SDL_AtomicGet(&s->read);
+    u32 written = (u32) SDL_AtomicGet(&s->written);
+    i16 sample;
+
+    // the mixer is done with everything below read
+    SDL_MemoryBarrierAcquire();
+
+    while (!s->finished && written - read < limit) {
+        if (!S_NextSfxSample(s, &sample)) {
+            s->finished = true;
+            break;
+        }
+        if (s->skip > 0) {
+            s->skip--;
+            continue;
+        }
+        s->ring[written & (SFXSTREAM_SIZE - 1)] = sample;
+        written++;
+    }
+
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&s->written, (i32) written);
+    if (s->finished) {
+        SDL_AtomicSet(&s->ended, 1);
+    }
+}
+
+static void S_CloseSfxStream(sfxstream_t* s) {
+    S_CodecCloseStream(s->file);
+    s->file = NULL;
+    s->sfx = NULL;
+    s->inuse = false;
+}
+
+/*
+================
+S_OpenSfxStream
+================
+*/
+sfxstream_t* S_OpenSfxStream(sfx_t* sfx, i32 pos) {
+    char namebuffer[256];
+    sfxstream_t* s = NULL;
+    i32 i;
+
+    for (i = 0; i < MAX_SFX_STREAMS; i++) {
+        if (!sfx_streams[i]) {
+            sfx_streams[i] = Q_malloc(sizeof(sfxstream_t));
+            if (!sfx_streams[i]) {
+                break;
+            }
+            sfx_streams[i]->inuse = false;
+        }
+        if (!sfx_streams[i]->inuse) {
+            s = sfx_streams[i];
+            break;
+        }
+    }
+    if (!s) {
+        Con_DPrintf("No free stream for %s\n", sfx->name);
+        return NULL;
+    }
+
+    Q_strcpy(namebuffer, "sound/");
+    Q_strcat(namebuffer, sfx->name);
+    s->file = S_CodecOpenSoundType(namebuffer, CODECTYPE_WAV, false);
+    if (!s->file) {
+        return NULL;
+    }
+    if (s->file->info.channels != 1) {
+        Con_Printf("%s is a stereo sample\n", sfx->name);
+        S_CodecCloseStream(s->file);
+        s->file = NULL;
+        return NULL;
+    }
+
+    s->inuse = true;
+    s->sfx = sfx;
+    s->finished = false;
+    s->skip = pos;
+    s->filepos = 0;
+    s->discard = 0;
+    s->step = (double) s->file->info.rate / shm->speed;
+    s->frac = 2.0; // reads the first two samples
+    s->a = 0;
+    s->b = 0;
+    s->decodedpos = 0;
+    s->decodedcount = 0;
+    SDL_AtomicSet(&s->written, 0);
+    SDL_AtomicSet(&s->read, 0);
+    SDL_AtomicSet(&s->ended, 0);
+    SDL_AtomicSet(&s->released, 0);
+
+    // enough for the mixer to start on, S_UpdateSfxStreams does the rest
+    S_FillSfxStream(s, SFXSTREAM_PRIME);
+
+    return s;
+}
+
+void S_UpdateSfxStreams(void) {
+    for (i32 i = 0; i < MAX_SFX_STREAMS; i++) {
+        sfxstream_t* s = sfx_streams[i];
+        if (!s || !s->inuse) {
+            continue;
+        }
+        if (SDL_AtomicGet(&s->released)) {
+            S_CloseSfxStream(s);
+            continue;
+        }
+        S_FillSfxStream(s, SFXSTREAM_SIZE);
+    }
+}
+
+void S_CloseSfxStreams(void) {
+    for (i32 i = 0; i < MAX_SFX_STREAMS; i++) {
+        if (sfx_streams[i] && sfx_streams[i]->inuse) {
+            S_CloseSfxStream(sfx_streams[i]);
+        }
+    }
+}
+
+i32 S_NumSfxStreams(void) {
+    i32 count = 0;
+    for (i32 i = 0; i < MAX_SFX_STREAMS; i++) {
+        if (sfx_streams[i] && sfx_streams[i]->inuse) {
+            count++;
+        }
+    }
+    return count;
+}
+
+/*
+================
+S_ReadSfxStream
+
+Called on the mixer's thread.
+================
+*/
+i32 S_ReadSfxStream(sfxstream_t* s, i16* out, i32 count) {
+    const u32 written = (u32) SDL_AtomicGet(&s->written);
+    const u32 read = (u32) SDL_AtomicGet(&s->read);
+
+    // the game thread filled everything below written
+    SDL_MemoryBarrierAcquire();
+
+    const i32 avail = (i32) (written - read);
+    if (count > avail) {
+        if (!SDL_AtomicGet(&s->ended)) {
+            snd_streamunderruns += count - avail;
+        }
+        count = avail;
+    }
+
+    if (out) {
+        const i32 start = read & (SFXSTREAM_SIZE - 1);
+        const i32 first = SDL_min(count, SFXSTREAM_SIZE - start);
+        Q_memcpy(out, &s->ring[start], first * sizeof(*out));
+        Q_memcpy(out + first, s->ring, (count - first) * sizeof(*out));
+    }
+
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&s->read, (i32) (read + count));
+    return count;
+}
+
+void S_ReleaseSfxStream(sfxstream_t* s) {
+    SDL_AtomicSet(&s->released, 1);
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 1996-1997 Id Software, Inc.
+ * Copyright (C) Henrique Barateli, <henriquejb194@gmail.com>, et al.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+// snd_sfxstream.h -- long sound effects played from disk
+
+#ifndef _SND_SFXSTREAM_H_
+#define _SND_SFXSTREAM_H_
+
+
+#include "sound.h"
+
+//
+// A sound whose resampled data is bigger than snd_streamsize KB is not put
+// in the cache. Every voice that plays it gets a stream instead: the game
+// thread opens the file through the codec layer and keeps a small ring of
+// resampled samples full, the mixer reads the ring and hands the stream
+// back once its voice stops. Only the ring's counters are shared.
+//
+
+typedef struct sfxstream_s sfxstream_t;
+
+#define MAX_SFX_STREAMS 16
+
+void S_InitSfxStreams(void);
+
+void S_SfxStreamInfo(const sfx_t* sfx, sfxcache_t* sc);
+// The header the voices see, at the device rate and always 16 bit.
+
+sfxstream_t* S_OpenSfxStream(sfx_t* sfx, i32 pos);
+// Starts reading sfx pos samples in, NULL if no stream is free.
+
+void S_UpdateSfxStreams(void);
+// Refills the rings and closes the streams the mixer gave back.
+
+void S_CloseSfxStreams(void);
+// Closes every stream, only once the mixer has stopped.
+
+i32 S_NumSfxStreams(void);
+
+// On the mixer's thread
+
+i32 S_ReadSfxStream(sfxstream_t* stream, i16* out, i32 count);
+// Takes up to count samples from the ring, or skips them with a NULL out.
+
+void S_ReleaseSfxStream(sfxstream_t* stream);
+
+// Statistic Counters
+extern volatile i32 snd_streamunderruns; // samples the ring didn't have
+
+#endif
@@ -0,0 +1,376 @@
+/*
+ * Copyright (C) 1996-1997 Id Software, Inc.
+ * Copyright (C) Henrique Barateli, <henriquejb194@gmail.com>, et al.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+// snd_thread.c -- the mixer and the queue feeding it
+
+
+#include "snd_thread.h"
+#include "console.h"
+#include "snd_null.h"
+#include <SDL_atomic.h>
+#include <SDL_mutex.h>
+#include <SDL_thread.h>
+#include <SDL_timer.h>
+
+
+#define MIXQUEUE_SIZE 1024 // must be a power of two
+#define MIXER_PERIOD  5    // ms the thread sleeps when nobody wakes it
+
+voice_t snd_voices[MAX_CHANNELS];
+mixsettings_t snd_mixsettings;
+
+static i32 soundtime;       // sample PAIRS
+volatile i32 paintedtime;   // sample PAIRS
+
+// Single producer (the game thread), single consumer (the mixer).
+// The producer only writes queue_head, the consumer only queue_tail.
+static mixcmd_t queue[MIXQUEUE_SIZE];
+static SDL_atomic_t queue_head; // next slot to be written
+static SDL_atomic_t queue_tail; // next slot to be run
+
+static SDL_Thread* mixer_thread;
+static SDL_sem* mixer_wake;
+static SDL_atomic_t mixer_quit;
+static SDL_atomic_t mixer_wrapped;
+
+// Statistic Counters
+static i32 mixer_stalls;     // commands that waited for room in the queue
+static u64 mixer_ticks;      // spent in S_PaintChannels
+static double mixer_samples; // sample pairs it painted
+
+
+void S_StopVoice(voice_t* v) {
+    if (v->stream) {
+        S_ReleaseSfxStream(v->stream);
+        v->stream = NULL;
+    }
+    v->sc = NULL;
+}
+
+static void S_StopAllVoices(void) {
+    for (i32 i = 0; i < MAX_CHANNELS; i++) {
+        S_StopVoice(&snd_voices[i]);
+    }
+    Q_memset(snd_voices, 0, sizeof(snd_voices));
+}
+
+static void GetSoundtime(void) {
+    static i32 buffers;
+    static i32 oldsamplepos;
+
+    i32 fullsamples = shm->samples / shm->channels;
+
+    // It is possible to miscount buffers if it has
+    // wrapped twice between calls to S_MixerUpdate.
+    i32 samplepos = SNDDMA_GetDMAPos();
+
+    if (samplepos < oldsamplepos) {
+        // Buffer wrapped.
+        buffers++;
+        if (paintedtime > 0x40000000) {
+            // Time to chop things off to avoid 32 bit limits.
+            // The game thread drops its channels when it sees the flag.
+            buffers = 0;
+            paintedtime = fullsamples;
+            S_StopAllVoices();
+            SDL_AtomicSet(&mixer_wrapped, 1);
+        }
+    }
+    oldsamplepos = samplepos;
+
+    soundtime = buffers * fullsamples + samplepos / shm->channels;
+}
+
+static void S_MixerClearBuffer(void) {
+    SNDDMA_LockBuffer();
+    if (!shm->buffer) {
+        SNDDMA_Submit();
+        return;
+    }
+
+    int clear;
+    if (shm->samplebits == 8 && !shm->signed8) {
+        clear = 0x80;
+    } else {
+        clear = 0;
+    }
+
+    Q_memset(shm->buffer, clear, shm->samples * shm->samplebits / 8);
+
+    SNDDMA_Submit();
+}
+
+static void S_MixerRun(const mixcmd_t* cmd) {
+    voice_t* v = &snd_voices[cmd->voice];
+
+    switch (cmd->type) {
+        case MIX_START:
+            S_StopVoice(v);
+            *v = cmd->data;
+            v->end += paintedtime;
+            break;
+        case MIX_STOP:
+            S_StopVoice(v);
+            break;
+        case MIX_VOLUME:
+            v->leftvol = cmd->data.leftvol;
+            v->rightvol = cmd->data.rightvol;
+            break;
+        case MIX_STOPALL:
+            S_StopAllVoices();
+            break;
+        case MIX_CLEARBUFFER:
+            S_MixerClearBuffer();
+            break;
+        case MIX_FREE:
+            Q_free(cmd->data.sc);
+            break;
+        case MIX_SETTINGS: {
+            const qboolean rescale =
+                cmd->settings.volume != snd_mixsettings.volume;
+            snd_mixsettings = cmd->settings;
+            if (rescale) {
+                SND_InitScaletable();
+            }
+            break;
+        }
+    }
+}
+
+/*
+================
+S_MixerDrain
+
+Runs every command published so far, on the mixer's thread.
+================
+*/
+static void S_MixerDrain(void) {
+    i32 tail = SDL_AtomicGet(&queue_tail);
+    const i32 head = SDL_AtomicGet(&queue_head);
+    SDL_MemoryBarrierAcquire();
+
+    while (tail != head) {
+        S_MixerRun(&queue[tail]);
+        tail = (tail + 1) & (MIXQUEUE_SIZE - 1);
+    }
+    SDL_AtomicSet(&queue_tail, tail);
+}
+
+/*
+================
+S_MixerCommand
+================
+*/
+void S_MixerCommand(const mixcmd_t* cmd) {
+    const i32 head = SDL_AtomicGet(&queue_head);
+    const i32 next = (head + 1) & (MIXQUEUE_SIZE - 1);
+
+    while (next == SDL_AtomicGet(&queue_tail)) {
+        mixer_stalls++;
+        if (!mixer_thread) {
+            // We are the mixer.
+            S_MixerDrain();
+            break;
+        }
+        SDL_SemPost(mixer_wake);
+        SDL_Delay(1);
+    }
+
+    queue[head] = *cmd;
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&queue_head, next);
+}
+
+void S_MixerFlush(void) {
+    if (mixer_thread) {
+        SDL_SemPost(mixer_wake);
+    }
+}
+
+static void S_MixerPaint(i32 endtime) {
+    const i32 start = paintedtime;
+    const u64 ticks = SDL_GetPerformanceCounter();
+    S_PaintChannels(endtime);
+    mixer_ticks += SDL_GetPerformanceCounter() - ticks;
+    mixer_samples += paintedtime - start;
+}
+
+/*
+================
+S_MixerUpdateOffline
+
+The offline device plays only what has been painted for it. Each step
+paints up to its clock and hands that over, so a long frame is caught up
+with before the next one.
+================
+*/
+static void S_MixerUpdateOffline(void) {
+    GetSoundtime();
+    for (i32 count = SNDDMA_NullPending(); count > 0;
+         count = SNDDMA_NullPending()) {
+        if (paintedtime < soundtime) {
+            paintedtime = soundtime;
+        }
+        S_MixerPaint(soundtime + count);
+        const i32 painted = paintedtime - soundtime;
+        if (painted <= 0) {
+            break;
+        }
+        SNDDMA_NullPlay(SDL_min(count, painted));
+        GetSoundtime();
+    }
+}
+
+/*
+================
+S_MixerUpdate
+
+Mixes ahead of the DMA position by snd_mixsettings.mixahead.
+================
+*/
+void S_MixerUpdate(void) {
+    S_MixerDrain();
+
+    SNDDMA_LockBuffer();
+    if (!shm->buffer) {
+        SNDDMA_Submit();
+        return;
+    }
+
+    if (snd_offline) {
+        S_MixerUpdateOffline();
+        SNDDMA_Submit();
+        return;
+    }
+
+    // Updates DMA time.
+    GetSoundtime();
+
+    // Check to make sure that we haven't overshot.
+    if (paintedtime < soundtime) {
+        //Con_Printf("S_MixerUpdate : overflow\n");
+        paintedtime = soundtime;
+    }
+
+    // mix ahead of current position
+    u32 endtime = soundtime + snd_mixsettings.mixahead * shm->speed;
+    i32 samps = shm->samples >> (shm->channels - 1);
+    if (endtime - soundtime > samps)
+        endtime = soundtime + samps;
+
+    S_MixerPaint((i32) endtime);
+
+    SNDDMA_Submit();
+}
+
+static int S_MixerThread(void* unused) {
+    SDL_SetThreadPriority(SDL_THREAD_PRIORITY_HIGH);
+
+    while (!SDL_AtomicGet(&mixer_quit)) {
+        S_MixerUpdate();
+        SDL_SemWaitTimeout(mixer_wake, MIXER_PERIOD);
+    }
+    return 0;
+}
+
+/*
+================
+S_MixerInit
+
+Called once the DMA buffer is up, before any command is queued.
+================
+*/
+void S_MixerInit(void) {
+    SDL_AtomicSet(&queue_head, 0);
+    SDL_AtomicSet(&queue_tail, 0);
+    SDL_AtomicSet(&mixer_wrapped, 0);
+    Q_memset(snd_voices, 0, sizeof(snd_voices));
+    Q_memset(&snd_mixsettings, 0, sizeof(snd_mixsettings));
+    mixer_stalls = 0;
+    mixer_ticks = 0;
+    mixer_samples = 0;
+
+    GetSoundtime();
+    paintedtime = soundtime;
+
+    if (COM_CheckParm("-nosoundthread") || snd_offline) {
+        return;
+    }
+    mixer_wake = SDL_CreateSemaphore(0);
+    if (!mixer_wake) {
+        Con_Printf("Mixing on the main thread: %s\n", SDL_GetError());
+        return;
+    }
+    SDL_AtomicSet(&mixer_quit, 0);
+    mixer_thread = SDL_CreateThread(S_MixerThread, "mixer", NULL);
+    if (!mixer_thread) {
+        Con_Printf("Mixing on the main thread: %s\n", SDL_GetError());
+        SDL_DestroySemaphore(mixer_wake);
+        mixer_wake = NULL;
+    }
+}
+
+/*
+================
+S_MixerShutdown
+
+Stops the thread and runs whatever it left queued, so freed copies are
+given back. The streams go last, nothing reads them after that.
+================
+*/
+void S_MixerShutdown(void) {
+    if (mixer_thread) {
+        SDL_AtomicSet(&mixer_quit, 1);
+        SDL_SemPost(mixer_wake);
+        SDL_WaitThread(mixer_thread, NULL);
+        mixer_thread = NULL;
+        SDL_DestroySemaphore(mixer_wake);
+        mixer_wake = NULL;
+    }
+    S_MixerDrain();
+    S_CloseSfxStreams();
+}
+
+qboolean S_MixerThreaded(void) {
+    return mixer_thread != NULL;
+}
+
+qboolean S_MixerWrapped(void) {
+    return SDL_AtomicCAS(&mixer_wrapped, 1, 0) ? true : false;
+}
+
+/*
+================
+S_MixerPrintStats
+================
+*/
+void S_MixerPrintStats(void) {
+    const double seconds = (double) mixer_ticks / SDL_GetPerformanceFrequency();
+    const double audio = mixer_samples / shm->speed;
+
+    Con_Printf("%5d mixer queue stalls\n", mixer_stalls);
+    Con_Printf("%.1f s of audio mixed in %.1f ms", audio, seconds * 1000);
+    if (seconds > 0) {
+        Con_Printf(", %.0fx real time", audio / seconds);
+    }
+    Con_Printf("\n");
+    if (snd_offline) {
+        SNDDMA_NullInfo();
+    }
+}
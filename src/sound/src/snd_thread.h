@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 1996-1997 Id Software, Inc.
+ * Copyright (C) Henrique Barateli, <henriquejb194@gmail.com>, et al.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+// snd_thread.h -- the mixer and the queue feeding it
+
+#ifndef _SND_THREAD_H_
+#define _SND_THREAD_H_
+
+
+#include "sound.h"
+#include "snd_sfxstream.h"
+
+//
+// The mixer owns its voices and paints ahead into the DMA ring, on its own
+// thread unless -nosoundthread is given. The game thread never touches a
+// voice; it picks and spatializes channel_t's as before and S_Update turns
+// the difference since the last frame into commands.
+//
+// Voices play from copies of the sfxcache the mixer owns, since the zone
+// cache moves and evicts blocks under the game thread. A copy is handed
+// over in MIX_START and given back with MIX_FREE once nothing can use it.
+// A streamed sound's copy is only a header, its voice reads from a stream
+// that goes back with S_ReleaseSfxStream when the voice stops.
+//
+
+typedef struct {
+    sfxcache_t* sc;
+    sfxstream_t* stream; // NULL unless the sound is streamed
+    i32 leftvol;  // 0-255 volume
+    i32 rightvol; // 0-255 volume
+    i32 pos;      // sample position in sfx
+    i32 end;      // end time in global paintsamples
+} voice_t;
+
+typedef struct {
+    float volume;
+    float mixahead;     // seconds
+    i32 filterquality;
+    qboolean lowpass;
+} mixsettings_t;
+
+typedef enum {
+    MIX_START,       // voice plays data.sc from data.pos
+    MIX_STOP,
+    MIX_VOLUME,      // data.leftvol, data.rightvol
+    MIX_STOPALL,
+    MIX_CLEARBUFFER, // silences the DMA ring
+    MIX_FREE,        // data.sc is no longer used by the game thread
+    MIX_SETTINGS
+} mixcmdtype_t;
+
+typedef struct {
+    mixcmdtype_t type;
+    i32 voice;
+    voice_t data; // for MIX_START, end is relative to paintedtime
+    mixsettings_t settings;
+} mixcmd_t;
+
+extern voice_t snd_voices[MAX_CHANNELS];
+extern mixsettings_t snd_mixsettings;
+
+// Statistic Counters, as of the last paint
+extern volatile i32 snd_paintedvoices;
+extern volatile i32 snd_virtualvoices; // playing, but not audible
+
+void S_StopVoice(voice_t* v);
+// Drops the voice and its stream, on the mixer's thread.
+
+void S_MixerInit(void);
+void S_MixerShutdown(void);
+
+qboolean S_MixerThreaded(void);
+// Whether a mixer thread is running, or S_MixerUpdate has to be called.
+
+void S_MixerCommand(const mixcmd_t* cmd);
+// Queues a command, waiting for room if the mixer is behind.
+
+void S_MixerFlush(void);
+// Wakes the mixer thread for the commands queued this frame.
+
+void S_MixerUpdate(void);
+// Runs the queued commands and paints ahead, on the mixer's thread.
+
+qboolean S_MixerWrapped(void);
+// True once after the mixer had to reset time and drop its voices.
+
+void S_MixerPrintStats(void);
+
+#endif